@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 ImpactX contributors
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# Compare the accuracy and runtime of a mixed-precision build of ImpactX
+# (-DImpactX_PARTICLE_PRECISION=SINGLE) to a double-precision build.
+#
+# Both executables track the same examples. The deviations of the reduced beam
+# characteristics of the mixed-precision run from the double-precision run are
+# reported over all steps, together with the evolve times of both runs.
+#
+# Example:
+#   python3 compare_precision.py \
+#       --double build/bin/impactx.NOMPI.OMP.DP.OPMD \
+#       --single build_psp/bin/impactx.NOMPI.OMP.DP.PSP.OPMD \
+#       --npart 1000000 --output precision.json
+#
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+# example name: input file, relative to the examples/ directory
+EXAMPLES = {
+    "fodo": "fodo/input_fodo.in",
+    "iota_lattice": "iota_lattice/input_iotalattice.in",
+}
+
+# reduced beam characteristics: compared relative to the double-precision value
+RELATIVE = [
+    "sig_x",
+    "sig_y",
+    "sig_t",
+    "sig_px",
+    "sig_py",
+    "sig_pt",
+    "emittance_x",
+    "emittance_y",
+    "emittance_t",
+    "beta_x",
+    "beta_y",
+    "beta_t",
+]
+
+# first moments: compared relative to the beam size of the double-precision run
+MEANS = {
+    "x_mean": "sig_x",
+    "y_mean": "sig_y",
+    "t_mean": "sig_t",
+    "px_mean": "sig_px",
+    "py_mean": "sig_py",
+    "pt_mean": "sig_pt",
+}
+
+# dimensionless values that cross zero: compared as absolute difference
+ABSOLUTE = ["alpha_x", "alpha_y", "alpha_t"]
+
+EVOLVE = re.compile(r"Evolve time \(s\): (\S+)")
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Compare a mixed-precision build of ImpactX to a double-precision build."
+    )
+    parser.add_argument(
+        "--double", required=True, help="ImpactX executable in double precision"
+    )
+    parser.add_argument(
+        "--single",
+        required=True,
+        help="ImpactX executable with single-precision particles (.PSP)",
+    )
+    parser.add_argument(
+        "--output", default="precision.json", help="JSON file for the results"
+    )
+    parser.add_argument(
+        "--npart",
+        type=int,
+        default=None,
+        help="number of particles, instead of the one of each example",
+    )
+    parser.add_argument(
+        "--mpiexec", default=None, help="MPI launcher, e.g., mpiexec or srun"
+    )
+    parser.add_argument(
+        "--nranks", type=int, default=1, help="number of MPI ranks with --mpiexec"
+    )
+    parser.add_argument(
+        "--only",
+        nargs="*",
+        default=None,
+        choices=EXAMPLES.keys(),
+        help="compare only these examples",
+    )
+    return parser.parse_args()
+
+
+def read_reduced(file_name):
+    """Columns of an ASCII reduced diagnostics file, by name"""
+    with open(file_name) as f:
+        columns = f.readline().split()
+        values = {c: [] for c in columns}
+        for line in f:
+            for column, value in zip(columns, line.split()):
+                values[column].append(float(value))
+    return values
+
+
+def run_example(args, name, precision, executable):
+    """Run one example with one executable"""
+    here = os.path.dirname(os.path.abspath(__file__))
+    input_file = os.path.join(here, "..", "examples", EXAMPLES[name])
+
+    cmd = []
+    if args.mpiexec:
+        cmd += [args.mpiexec, "-n", str(args.nranks)]
+    cmd += [
+        executable,
+        input_file,
+        "diag.enable=1",
+        "diag.reduced_format=ascii",
+    ]
+    if args.npart is not None:
+        cmd.append(f"beam.npart={args.npart}")
+
+    run_dir = os.path.join(os.getcwd(), name, precision)
+    os.makedirs(run_dir, exist_ok=True)
+
+    print(f"Example {name} ({precision}): {' '.join(cmd)}", flush=True)
+    proc = subprocess.run(
+        cmd, cwd=run_dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True
+    )
+    with open(os.path.join(run_dir, "output.txt"), "w") as f:
+        f.write(proc.stdout)
+
+    if proc.returncode != 0:
+        print(proc.stdout[-4000:], file=sys.stderr)
+        return None, None
+
+    found = EVOLVE.search(proc.stdout)
+    evolve_time = float(found.group(1)) if found else None
+    rbc = read_reduced(os.path.join(run_dir, "diags", "reduced_beam_characteristics"))
+    return rbc, evolve_time
+
+
+def compare(double, single):
+    """Largest deviation over all steps of each reduced beam characteristic"""
+    deviations = {}
+    for column in RELATIVE:
+        deviations[column] = max(
+            abs(s - d) / abs(d) if d != 0.0 else abs(s)
+            for d, s in zip(double[column], single[column])
+        )
+    for column, sigma in MEANS.items():
+        deviations[column] = max(
+            abs(s - d) / sig if sig != 0.0 else abs(s - d)
+            for d, s, sig in zip(double[column], single[column], double[sigma])
+        )
+    for column in ABSOLUTE:
+        deviations[column] = max(
+            abs(s - d) for d, s in zip(double[column], single[column])
+        )
+    return deviations
+
+
+def main():
+    args = parse_args()
+    names = args.only if args.only else EXAMPLES
+
+    results = []
+    for name in names:
+        result = {"name": name}
+        rbc_double, result["evolve_time_double_s"] = run_example(
+            args, name, "double", args.double
+        )
+        rbc_single, result["evolve_time_single_s"] = run_example(
+            args, name, "single", args.single
+        )
+        if rbc_double is None or rbc_single is None:
+            result["failed"] = True
+        elif len(rbc_double["step"]) != len(rbc_single["step"]):
+            print(f"{name}: the runs wrote a different number of steps", file=sys.stderr)
+            result["failed"] = True
+        else:
+            result["steps"] = len(rbc_double["step"])
+            result["max_deviation"] = compare(rbc_double, rbc_single)
+        results.append(result)
+
+    report = {
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "npart": args.npart,
+        "examples": results,
+    }
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+    print(f"Precision comparison written to {args.output}")
+
+    for r in results:
+        if r.get("failed"):
+            print(f"  {r['name']:16s} failed")
+            continue
+        dev = r["max_deviation"]
+        print(f"  {r['name']:16s} max. deviation over {r['steps']} steps:")
+        print(
+            "  {:16s} emittance x/y/t (rel.): {:.2e} {:.2e} {:.2e}".format(
+                "", dev["emittance_x"], dev["emittance_y"], dev["emittance_t"]
+            )
+        )
+        print(
+            "  {:16s} sigma x/y/t (rel.):     {:.2e} {:.2e} {:.2e}".format(
+                "", dev["sig_x"], dev["sig_y"], dev["sig_t"]
+            )
+        )
+        print(
+            "  {:16s} mean x/y/t (/sigma):    {:.2e} {:.2e} {:.2e}".format(
+                "", dev["x_mean"], dev["y_mean"], dev["t_mean"]
+            )
+        )
+        print(
+            "  {:16s} alpha x/y/t (abs.):     {:.2e} {:.2e} {:.2e}".format(
+                "", dev["alpha_x"], dev["alpha_y"], dev["alpha_t"]
+            )
+        )
+        t_double = r.get("evolve_time_double_s")
+        t_single = r.get("evolve_time_single_s")
+        if t_double and t_single:
+            print(
+                f"  {'':16s} evolve time (s): double {t_double:.3e}, "
+                f"mixed {t_single:.3e}, speedup {t_double / t_single:.2f}x"
+            )
+
+    return 0 if not any(r.get("failed") for r in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
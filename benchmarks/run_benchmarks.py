@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 ImpactX contributors
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# Run the ImpactX performance benchmarks and write their results as JSON.
+#
+# Example:
+#   python3 run_benchmarks.py --impactx build/bin/impactx --output benchmarks.json
+#
+# Compare the SIMD speedups of reports from several hosts, e.g., with AVX-512 and Neon:
+#   python3 run_benchmarks.py --summarize avx512.json neon.json
+#
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+# benchmark name: input file in this directory and additional options
+BENCHMARKS = {
+    "fodo": ("fodo", []),
+    "fodo_scalar": ("fodo", ["algo.simd=0"]),
+    "expanding_beam": ("expanding_beam", []),
+    "kurth_10nC_periodic": ("kurth_10nC_periodic", ["diag.element_profile=1"]),
+    "kurth_10nC_periodic_sorted": (
+        "kurth_10nC_periodic",
+        ["diag.element_profile=1", "algo.sort_interval=10"],
+    ),
+    "kurth_10nC_periodic_hysteresis": (
+        "kurth_10nC_periodic",
+        ["diag.element_profile=1", "geometry.dynamic_size_hysteresis=0.1"],
+    ),
+    "iota_lattice": ("iota_lattice", []),
+    "rfcavity_linac": ("rfcavity_linac", []),
+    "rfcavity_linac_scalar": ("rfcavity_linac", ["algo.simd=0"]),
+}
+
+# benchmark name: its baseline, for the speedup of the space charge deposition and gather
+SPEEDUP_BASELINES = {
+    "kurth_10nC_periodic_sorted": "kurth_10nC_periodic",
+}
+
+# benchmark name: its baseline with scalar pushes, for the speedup of SIMD pushes
+SIMD_BASELINES = {
+    "fodo": "fodo_scalar",
+    "rfcavity_linac": "rfcavity_linac_scalar",
+}
+
+# patterns in the ImpactX output
+PATTERNS = {
+    "evolve": re.compile(
+        r"Evolve time \(s\): (\S+), particle pushes: (\d+), per second: (\S+)"
+    ),
+    "memory": re.compile(
+        r"Memory high-water mark per MPI rank \(MB\): host (\S+), device (\S+)"
+    ),
+    "poisson": re.compile(
+        r"Poisson solves: (\d+), MLMG iterations: (\d+), operator builds: (\d+), solve time \(s\): (\S+)"
+    ),
+    "sort": re.compile(r"Particle sorts: (\d+), sort time \(s\): (\S+)"),
+    "mpi_ranks": re.compile(r"MPI initialized with (\d+) MPI processes"),
+    "omp_threads": re.compile(r"OMP initialized with (\d+) OMP threads"),
+    "gpu": re.compile(r"(CUDA|HIP|SYCL) initialized with (\d+) (?:device|GPU)"),
+    "amrex_version": re.compile(r"AMReX \((\S+)\) initialized"),
+    "simd_width": re.compile(r"SIMD width of the particle pushes: (\d+)"),
+}
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Run the ImpactX performance benchmarks."
+    )
+    parser.add_argument("--impactx", help="ImpactX executable")
+    parser.add_argument(
+        "--output", default="benchmarks.json", help="JSON file for the results"
+    )
+    parser.add_argument(
+        "--scale",
+        type=float,
+        default=1.0,
+        help="multiply the number of particles of each benchmark",
+    )
+    parser.add_argument(
+        "--mpiexec", default=None, help="MPI launcher, e.g., mpiexec or srun"
+    )
+    parser.add_argument(
+        "--nranks", type=int, default=1, help="number of MPI ranks with --mpiexec"
+    )
+    parser.add_argument(
+        "--only",
+        nargs="*",
+        default=None,
+        choices=BENCHMARKS.keys(),
+        help="run only these benchmarks",
+    )
+    parser.add_argument(
+        "--summarize",
+        nargs="+",
+        default=None,
+        metavar="REPORT",
+        help="print the SIMD speedups of existing JSON reports instead of running",
+    )
+    args = parser.parse_args()
+    if args.summarize is None and args.impactx is None:
+        parser.error("--impactx is required to run the benchmarks")
+    return args
+
+
+def cpu_vector_isa():
+    """Widest vector instruction set of the host CPU, from /proc/cpuinfo on Linux"""
+    try:
+        with open("/proc/cpuinfo") as f:
+            flags = set()
+            for line in f:
+                if line.lower().startswith(("flags", "features")):
+                    flags.update(line.split(":", 1)[1].split())
+    except OSError:
+        return None
+    for flag, isa in (
+        ("avx512f", "AVX-512"),
+        ("avx2", "AVX2"),
+        ("sve", "SVE"),
+        ("asimd", "Neon"),
+        ("neon", "Neon"),
+    ):
+        if flag in flags:
+            return isa
+    return None
+
+
+def read_npart(input_file):
+    """Number of particles in an input file"""
+    with open(input_file) as f:
+        for line in f:
+            m = re.match(r"\s*beam\.npart\s*=\s*(\d+)", line)
+            if m:
+                return int(m.group(1))
+    raise RuntimeError(f"No beam.npart in {input_file}")
+
+
+def read_element_profile(profile_file):
+    """Wall time per phase, summed over all elements of diags/element_profile.txt"""
+    with open(profile_file) as f:
+        columns = f.readline().split()
+        times = {c[len("time_") :]: 0.0 for c in columns if c.startswith("time_")}
+        for line in f:
+            for column, value in zip(columns, line.split()):
+                if column.startswith("time_"):
+                    times[column[len("time_") :]] += float(value)
+    return times
+
+
+def run_benchmark(args, name):
+    """Run a single benchmark and parse its performance summary"""
+    here = os.path.dirname(os.path.abspath(__file__))
+    input_name, options = BENCHMARKS[name]
+    input_file = os.path.join(here, f"{input_name}.in")
+    npart = max(1, int(read_npart(input_file) * args.scale))
+
+    cmd = []
+    if args.mpiexec:
+        cmd += [args.mpiexec, "-n", str(args.nranks)]
+    cmd += [
+        args.impactx,
+        input_file,
+        f"beam.npart={npart}",
+        "diag.performance_counters=1",
+    ] + options
+
+    run_dir = os.path.join(os.getcwd(), name)
+    os.makedirs(run_dir, exist_ok=True)
+
+    print(f"Benchmark {name}: {' '.join(cmd)}", flush=True)
+    start = time.perf_counter()
+    proc = subprocess.run(
+        cmd, cwd=run_dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True
+    )
+    wall_time = time.perf_counter() - start
+
+    with open(os.path.join(run_dir, "output.txt"), "w") as f:
+        f.write(proc.stdout)
+
+    result = {
+        "name": name,
+        "npart": npart,
+        "returncode": proc.returncode,
+        "wall_time_s": wall_time,
+    }
+    if proc.returncode != 0:
+        print(proc.stdout[-4000:], file=sys.stderr)
+        return result
+
+    found = {key: pattern.search(proc.stdout) for key, pattern in PATTERNS.items()}
+
+    if found["evolve"]:
+        result["evolve_time_s"] = float(found["evolve"].group(1))
+        result["particle_pushes"] = int(found["evolve"].group(2))
+        result["particle_pushes_per_s"] = float(found["evolve"].group(3))
+    if found["memory"]:
+        result["host_memory_high_water_mark_MB"] = float(found["memory"].group(1))
+        result["device_memory_high_water_mark_MB"] = float(found["memory"].group(2))
+    if found["poisson"]:
+        num_solves = int(found["poisson"].group(1))
+        solve_time = float(found["poisson"].group(4))
+        result["poisson_solves"] = num_solves
+        result["mlmg_iterations"] = int(found["poisson"].group(2))
+        result["operator_builds"] = int(found["poisson"].group(3))
+        result["poisson_solve_time_s"] = solve_time
+        result["time_per_poisson_solve_s"] = (
+            solve_time / num_solves if num_solves > 0 else None
+        )
+    if found["sort"]:
+        result["particle_sorts"] = int(found["sort"].group(1))
+        result["sort_time_s"] = float(found["sort"].group(2))
+
+    profile_file = os.path.join(run_dir, "diags", "element_profile.txt")
+    if os.path.exists(profile_file):
+        result["phase_time_s"] = read_element_profile(profile_file)
+
+    # parallelization of this run
+    result["mpi_ranks"] = int(found["mpi_ranks"].group(1)) if found["mpi_ranks"] else 1
+    result["omp_threads"] = (
+        int(found["omp_threads"].group(1)) if found["omp_threads"] else 1
+    )
+    result["gpu_backend"] = found["gpu"].group(1) if found["gpu"] else None
+    result["amrex_version"] = (
+        found["amrex_version"].group(1) if found["amrex_version"] else None
+    )
+    result["simd_width"] = (
+        int(found["simd_width"].group(1)) if found["simd_width"] else None
+    )
+
+    return result
+
+
+def summarize(report_files):
+    """Table of the SIMD speedups in reports of one or several hosts"""
+    print(
+        f"{'report':24s} {'machine':8s} {'ISA':8s} {'benchmark':16s} "
+        f"{'width':>5s} {'speedup':>7s} {'pushes/s':>10s}"
+    )
+    for report_file in report_files:
+        with open(report_file) as f:
+            report = json.load(f)
+        for r in report["benchmarks"]:
+            if r["name"] not in SIMD_BASELINES:
+                continue
+            speedup = r.get("simd_speedup")
+            rate = r.get("particle_pushes_per_s")
+            print(
+                f"{os.path.basename(report_file):24s} {report.get('machine') or '-':8s} "
+                f"{report.get('cpu_vector_isa') or '-':8s} {r['name']:16s} "
+                f"{str(r.get('simd_width') or '-'):>5s} "
+                + (f"{speedup:7.2f}" if speedup else f"{'-':>7s}")
+                + (f" {rate:10.3e}" if rate else f" {'-':>10s}")
+            )
+    return 0
+
+
+def main():
+    args = parse_args()
+    if args.summarize:
+        return summarize(args.summarize)
+
+    names = args.only if args.only else BENCHMARKS
+
+    results = [run_benchmark(args, name) for name in names]
+
+    # speedup of the charge deposition and field gather, e.g., by sorting
+    by_name = {r["name"]: r for r in results}
+    for name, baseline in SPEEDUP_BASELINES.items():
+        if name not in by_name or baseline not in by_name:
+            continue
+        phases = ["space_charge_deposit", "space_charge_gather"]
+        times = [
+            by_name[n].get("phase_time_s", {}).get(p) for n in (baseline, name) for p in phases
+        ]
+        if None in times or sum(times[2:]) <= 0.0:
+            continue
+        by_name[name]["deposit_gather_speedup"] = sum(times[:2]) / sum(times[2:])
+
+    # speedup of the particle pushes in SIMD vectors over scalar pushes
+    for name, baseline in SIMD_BASELINES.items():
+        if name not in by_name or baseline not in by_name:
+            continue
+        rates = [by_name[n].get("particle_pushes_per_s") for n in (baseline, name)]
+        if None in rates or rates[0] <= 0.0:
+            continue
+        by_name[name]["simd_speedup"] = rates[1] / rates[0]
+
+    report = {
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "cpu_vector_isa": cpu_vector_isa(),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "scale": args.scale,
+        "benchmarks": results,
+    }
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+    print(f"Benchmark results written to {args.output}")
+
+    for r in results:
+        rate = r.get("particle_pushes_per_s")
+        print(f"  {r['name']:28s} " + (f"{rate:.3e} pushes/s" if rate else "failed"))
+        if "poisson_solves" in r:
+            print(
+                f"  {'':28s} Poisson solves: {r['poisson_solves']}, "
+                f"operator builds: {r['operator_builds']}, "
+                f"MLMG iterations: {r['mlmg_iterations']}"
+            )
+        if "deposit_gather_speedup" in r:
+            print(
+                f"  {'':28s} deposit+gather speedup: {r['deposit_gather_speedup']:.2f}x, "
+                f"sort time: {r.get('sort_time_s', 0.0):.3e} s"
+            )
+        if "simd_speedup" in r:
+            print(
+                f"  {'':28s} SIMD speedup: {r['simd_speedup']:.2f}x, "
+                f"SIMD width: {r.get('simd_width')}"
+            )
+
+    return 0 if all(r["returncode"] == 0 for r in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -276,6 +276,14 @@ function(impactx_set_binary_name)
             set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".SP")
         endif()
 
+        if(NOT ImpactX_PARTICLE_PRECISION STREQUAL ImpactX_PRECISION)
+            if(ImpactX_PARTICLE_PRECISION STREQUAL "DOUBLE")
+                set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".PDP")
+            else()
+                set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".PSP")
+            endif()
+        endif()
+
         #if(ImpactX_ASCENT)
         #    set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".ASCENT")
         #endif()
@@ -284,6 +292,14 @@ function(impactx_set_binary_name)
             set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".OPMD")
         endif()
 
+        if(ImpactX_FFT)
+            set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".FFT")
+        endif()
+
+        if(ImpactX_SIMD)
+            set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".SIMD")
+        endif()
+
         #if(ImpactX_SENSEI)
         #    set_property(TARGET ${tgt} APPEND_STRING PROPERTY OUTPUT_NAME ".SENSEI")
         #endif()
@@ -400,6 +416,7 @@ function(impactx_print_summary)
     message("    APP: ${ImpactX_APP}")
     #message("    ASCENT: ${ImpactX_ASCENT}")
     message("    COMPUTE: ${ImpactX_COMPUTE}")
+    message("    FFT: ${ImpactX_FFT}")
     message("    IPO/LTO: ${ImpactX_IPO}")
     message("    LIB: ${LIB_TYPE}")
     message("    MPI: ${ImpactX_MPI}")
@@ -407,8 +424,10 @@ function(impactx_print_summary)
         message("    MPI (thread multiple): ${ImpactX_MPI_THREAD_MULTIPLE}")
     endif()
     message("    PRECISION: ${ImpactX_PRECISION}")
+    message("    PARTICLE PRECISION: ${ImpactX_PARTICLE_PRECISION}")
     message("    PYTHON: ${ImpactX_PYTHON}")
     message("    OPENPMD: ${ImpactX_OPENPMD}")
+    message("    SIMD: ${ImpactX_SIMD}")
     #message("    SENSEI: ${ImpactX_SENSEI}")
     message("")
 endfunction()
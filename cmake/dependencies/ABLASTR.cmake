@@ -66,7 +66,10 @@ macro(find_ablastr)
         set(WarpX_DIMS 3 CACHE INTERNAL "" FORCE)
         set(WarpX_COMPUTE ${ImpactX_COMPUTE} CACHE INTERNAL "" FORCE)
         set(WarpX_OPENPMD ${ImpactX_OPENPMD} CACHE INTERNAL "" FORCE)
+        # FFT wrappers (FFTW, cuFFT, rocFFT) in ablastr::math::anyfft
+        set(WarpX_PSATD ${ImpactX_FFT} CACHE INTERNAL "" FORCE)
         set(WarpX_PRECISION ${ImpactX_PRECISION} CACHE INTERNAL "" FORCE)
+        set(WarpX_PARTICLE_PRECISION ${ImpactX_PARTICLE_PRECISION} CACHE INTERNAL "" FORCE)
         set(WarpX_MPI ${ImpactX_MPI} CACHE INTERNAL "" FORCE)
         set(WarpX_MPI_THREAD_MULTIPLE ${ImpactX_MPI_THREAD_MULTIPLE} CACHE INTERNAL "" FORCE)
         set(WarpX_IPO ${ImpactX_IPO} CACHE INTERNAL "" FORCE)
@@ -142,9 +145,9 @@ macro(find_ablastr)
         message(FATAL_ERROR "Not yet supported!")
         # TODO: MPI control
         set(COMPONENT_DIM 3D)
-        set(COMPONENT_PRECISION ${ImpactX_PRECISION} P${ImpactX_PRECISION})
+        set(COMPONENT_PRECISION ${ImpactX_PRECISION} P${ImpactX_PARTICLE_PRECISION})
 
-        find_package(ABLASTR 23.11 CONFIG REQUIRED COMPONENTS ${COMPONENT_DIM})
+        find_package(ABLASTR 24.01 CONFIG REQUIRED COMPONENTS ${COMPONENT_DIM})
         message(STATUS "ABLASTR: Found version '${ABLASTR_VERSION}'")
     endif()
 
@@ -178,7 +181,7 @@ set(ImpactX_openpmd_src ""
 set(ImpactX_ablastr_repo "https://github.com/ECP-WarpX/WarpX.git"
     CACHE STRING
     "Repository URI to pull and build ABLASTR from if(ImpactX_ablastr_internal)")
-set(ImpactX_ablastr_branch "23.11"
+set(ImpactX_ablastr_branch "24.01"
     CACHE STRING
     "Repository branch for ImpactX_ablastr_repo if(ImpactX_ablastr_internal)")
 
@@ -186,7 +189,7 @@ set(ImpactX_ablastr_branch "23.11"
 set(ImpactX_amrex_repo "https://github.com/AMReX-Codes/amrex.git"
     CACHE STRING
     "Repository URI to pull and build AMReX from if(ImpactX_amrex_internal)")
-set(ImpactX_amrex_branch "175b99d913dc2748e43c53192737170c770fe0e8"
+set(ImpactX_amrex_branch "24.01"
     CACHE STRING
     "Repository branch for ImpactX_amrex_repo if(ImpactX_amrex_internal)")
 
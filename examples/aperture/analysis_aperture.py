@@ -7,6 +7,7 @@
 
 import numpy as np
 import openpmd_api as io
+import pandas as pd
 from scipy.stats import moment
 
 
@@ -45,8 +46,12 @@ last_step = list(series.iterations)[-1]
 initial = series.iterations[1].particles["beam"].to_df()
 final = series.iterations[last_step].particles["beam"].to_df()
 
+# lost particles might be written in several batches, see diag.lost_spill_threshold
 series_lost = io.Series("diags/openPMD/particles_lost.h5", io.Access.read_only)
-particles_lost = series_lost.iterations[0].particles["beam"].to_df()
+particles_lost = pd.concat(
+    [it.particles["beam"].to_df() for _, it in series_lost.iterations.items()],
+    ignore_index=True,
+)
 
 # compare number of particles
 num_particles = 10000
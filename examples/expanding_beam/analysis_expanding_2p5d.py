@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 ImpactX contributors
+# Authors: Axel Huebl, Ji Qiang
+# License: BSD-3-Clause-LBNL
+#
+
+import numpy as np
+import openpmd_api as io
+from scipy.constants import c, e, epsilon_0, m_e
+from scipy.integrate import solve_ivp
+from scipy.stats import moment
+
+
+def get_moments(beam):
+    """Calculate standard deviations of beam position & momenta
+    and emittance values
+
+    Returns
+    -------
+    sigx, sigy, sigt, sigpt, emittance_x, emittance_y
+    """
+    sigx = moment(beam["position_x"], moment=2) ** 0.5  # variance -> std dev.
+    sigpx = moment(beam["momentum_x"], moment=2) ** 0.5
+    sigy = moment(beam["position_y"], moment=2) ** 0.5
+    sigpy = moment(beam["momentum_y"], moment=2) ** 0.5
+    sigt = moment(beam["position_t"], moment=2) ** 0.5
+    sigpt = moment(beam["momentum_t"], moment=2) ** 0.5
+
+    epstrms = beam.cov(ddof=0)
+    emittance_x = (
+        sigx**2 * sigpx**2 - epstrms["position_x"]["momentum_x"] ** 2
+    ) ** 0.5
+    emittance_y = (
+        sigy**2 * sigpy**2 - epstrms["position_y"]["momentum_y"] ** 2
+    ) ** 0.5
+
+    return (sigx, sigy, sigt, sigpt, emittance_x, emittance_y)
+
+
+# initial/final beam
+series = io.Series("diags/openPMD/monitor.h5", io.Access.read_only)
+last_step = list(series.iterations)[-1]
+initial = series.iterations[1].particles["beam"].to_df()
+final = series.iterations[last_step].particles["beam"].to_df()
+
+# compare number of particles
+num_particles = 10000
+assert num_particles == len(initial)
+assert num_particles == len(final)
+
+# long, cold beam of uniform density: the rms envelope in a drift follows
+#   sigma'' = K / (4 sigma)
+# with the generalized perveance K of the line density lambda
+kin_energy = 1.0e6 * e  # J
+charge = 3.0e-12  # C
+sigma0 = 4.472135955e-4  # m
+sigma_t = 3.0e-2  # m
+length = 6.0  # m
+
+gamma = 1.0 + kin_energy / (m_e * c**2)
+beta = np.sqrt(1.0 - gamma**-2)
+line_density = charge / (2.0 * np.sqrt(3.0) * sigma_t * beta)
+perveance = (
+    e * line_density / (2.0 * np.pi * epsilon_0 * m_e * c**2 * beta**2 * gamma**3)
+)
+
+envelope = solve_ivp(
+    lambda s, y: [y[1], perveance / (4.0 * y[0])],
+    [0.0, length],
+    [sigma0, 0.0],
+    rtol=1.0e-10,
+    atol=1.0e-14,
+)
+sigma_final = envelope.y[0, -1]
+
+print("Initial Beam:")
+sigx, sigy, sigt, sigpt, emittance_x, emittance_y = get_moments(initial)
+print(f"  sigx={sigx:e} sigy={sigy:e} sigt={sigt:e} sigpt={sigpt:e}")
+print(f"  emittance_x={emittance_x:e} emittance_y={emittance_y:e}")
+
+atol = 0.0  # ignored
+rtol = num_particles**-0.5  # from random sampling of a smooth distribution
+print(f"  rtol={rtol} (ignored: atol~={atol})")
+
+assert np.allclose(
+    [sigx, sigy, sigt],
+    [sigma0, sigma0, sigma_t],
+    rtol=rtol,
+    atol=atol,
+)
+
+
+print("")
+print("Final Beam:")
+sigx, sigy, sigt, sigpt, emittance_x, emittance_y = get_moments(final)
+print(f"  sigx={sigx:e} sigy={sigy:e} sigt={sigt:e} sigpt={sigpt:e}")
+print(f"  emittance_x={emittance_x:e} emittance_y={emittance_y:e}")
+print(f"  envelope: sigma={sigma_final:e}")
+
+atol = 0.0  # ignored
+rtol = 2.0 * num_particles**-0.5  # from random sampling of a smooth distribution
+print(f"  rtol={rtol} (ignored: atol~={atol})")
+
+assert np.allclose(
+    [sigx, sigy, sigt],
+    [sigma_final, sigma_final, sigma_t],
+    rtol=rtol,
+    atol=atol,
+)
+
+atol = 1.0e-8
+rtol = 0.0  # ignored
+assert np.allclose(
+    [emittance_x, emittance_y],
+    [0.0, 0.0],
+    rtol=rtol,
+    atol=atol,
+)
+
+# no longitudinal self-field in the 2.5D model: the energy spread is only of
+# second order in the transverse momenta
+atol = 1.0e-6
+rtol = 0.0  # ignored
+assert np.allclose(
+    [sigpt],
+    [0.0],
+    rtol=rtol,
+    atol=atol,
+)
@@ -95,9 +95,10 @@ class CMakeBuild(build_ext):
             "-DPython_EXECUTABLE=" + sys.executable,
             ## variants
             "-DImpactX_COMPUTE=" + ImpactX_COMPUTE,
+            "-DImpactX_FFT:BOOL=" + ImpactX_FFT,
             "-DImpactX_MPI:BOOL=" + ImpactX_MPI,
             "-DImpactX_PRECISION=" + ImpactX_PRECISION,
-            #'-DImpactX_PARTICLES_PRECISION=' + ImpactX_PARTICLES_PRECISION,
+            "-DImpactX_PARTICLE_PRECISION=" + ImpactX_PARTICLE_PRECISION,
             "-DImpactX_PYTHON:BOOL=ON",
             ## dependency control (developers & package managers)
             #'-DImpactX_pyamrex_internal=' + ImpactX_pyamrex_internal,
@@ -175,8 +176,12 @@ PYIMPACTX_libdir = os.environ.get("PYIMPACTX_LIBDIR")
 # ... build ImpactX libraries with CMake
 #   note: changed default for SHARED, MPI, TESTING and EXAMPLES
 ImpactX_COMPUTE = os.environ.get("IMPACTX_COMPUTE", "OMP")
+ImpactX_FFT = os.environ.get("IMPACTX_FFT", "OFF")
 ImpactX_MPI = os.environ.get("IMPACTX_MPI", "OFF")
 ImpactX_PRECISION = os.environ.get("IMPACTX_PRECISION", "DOUBLE")
+ImpactX_PARTICLE_PRECISION = os.environ.get(
+    "IMPACTX_PARTICLE_PRECISION", ImpactX_PRECISION
+)
 #   already prepared as a list 1;2;3
 ImpactX_SPACEDIM = os.environ.get("IMPACTX_SPACEDIM", "3")
 BUILD_SHARED_LIBS = os.environ.get("IMPACTX_BUILD_SHARED_LIBS", "OFF")
@@ -206,6 +211,11 @@ for k, v in os.environ.items():
         )
 
 # https://cmake.org/cmake/help/v3.0/command/if.html
+if ImpactX_FFT.upper() in ["1", "ON", "TRUE", "YES"]:
+    ImpactX_FFT = "ON"
+else:
+    ImpactX_FFT = "OFF"
+
 if ImpactX_MPI.upper() in ["1", "ON", "TRUE", "YES"]:
     ImpactX_MPI = "ON"
 else:
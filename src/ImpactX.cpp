@@ -10,12 +10,18 @@
 #include "ImpactX.H"
 #include "initialization/InitAmrCore.H"
 #include "particles/CollectLost.H"
+#include "particles/FuseLinear.H"
 #include "particles/ImpactXParticleContainer.H"
 #include "particles/Push.H"
+#include "particles/RefPartCache.H"
+#include "particles/TrackParticleMajor.H"
+#include "particles/diagnostics/Checkpoint.H"
 #include "particles/diagnostics/DiagnosticOutput.H"
 #include "particles/spacecharge/ForceFromSelfFields.H"
+#include "particles/spacecharge/FusedSpaceCharge.H"
 #include "particles/spacecharge/GatherAndPush.H"
 #include "particles/spacecharge/PoissonSolve.H"
+#include "particles/spacecharge/SpaceChargeAlgo.H"
 #include "particles/transformation/CoordinateTransformation.H"
 
 #include <ablastr/warn_manager/WarnManager.H>
@@ -23,15 +29,121 @@
 #include <AMReX.H>
 #include <AMReX_AmrParGDB.H>
 #include <AMReX_BLProfiler.H>
+#include <AMReX_CArena.H>
+#include <AMReX_GpuDevice.H>
+#include <AMReX_ParallelReduce.H>
+#include <AMReX_ParallelDescriptor.H>
 #include <AMReX_ParmParse.H>
 #include <AMReX_Print.H>
+#include <AMReX_RealBox.H>
+#include <AMReX_RealVect.H>
 #include <AMReX_Utility.H>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <list>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
 
 
 namespace impactx
 {
+namespace
+{
+    /** Memory currently allocated from the default AMReX arena of this MPI rank
+     *
+     * On GPUs, this is device memory. The arena keeps freed memory in a pool,
+     * so this reports the allocations of ImpactX, not the size of the pool.
+     *
+     * @return bytes, or zero if the arena does not track its allocations
+     */
+    std::size_t
+    device_memory_used ()
+    {
+        if (auto const * arena = dynamic_cast<amrex::CArena const *>(amrex::The_Arena())) {
+            return arena->heap_space_actually_used();
+        }
+        return 0;
+    }
+
+    /** Maximum resident host memory of this MPI rank so far
+     *
+     * @return bytes, or zero if unknown on this platform
+     */
+    std::size_t
+    host_memory_high_water_mark ()
+    {
+#if defined(__linux__) || defined(__APPLE__)
+        struct rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#   if defined(__APPLE__)
+        return std::size_t(usage.ru_maxrss);           // bytes
+#   else
+        return std::size_t(usage.ru_maxrss) * 1024u;   // kilobytes
+#   endif
+#else
+        return 0;
+#endif
+    }
+
+    /** Slicing of a lattice element, looked up once before tracking */
+    struct ElementSchedule
+    {
+        int nslice = 1;                   //!< number of slices used for the application of space charge
+        amrex::Real slice_ds = 0.0;       //!< length of a slice in meters
+        std::string name;                 //!< element type
+        int lattice_index = 0;            //!< index of the (first) element in the lattice before fusion
+        int num_lattice_elements = 1;     //!< number of lattice elements fused into this one
+        bool may_lose_particles = false;  //!< the element marks particles as lost, counted on the device
+        bool user_defined = false;        //!< a Programmable element, which can change the particles arbitrarily
+    };
+
+    /** Slicing of all elements of a lattice, in order
+     *
+     * FusedLinear elements count for all lattice elements fused into them, so
+     * that lattice_index refers to the lattice before fusion.
+     *
+     * @param lattice the lattice elements, possibly fused
+     * @return one entry per element
+     */
+    std::vector<ElementSchedule>
+    make_schedule (std::list<KnownElements> & lattice)
+    {
+        std::vector<ElementSchedule> schedule;
+        schedule.reserve(lattice.size());
+        int lattice_index = 0;
+        for (auto & element_variant : lattice) {
+            std::visit([&schedule, &lattice_index](auto & element) {
+                using T_Element = std::decay_t<decltype(element)>;
+                ElementSchedule entry;
+                entry.nslice = element.nslice();
+                entry.slice_ds = element.ds() / entry.nslice;
+                entry.name = T_Element::name;
+                entry.may_lose_particles = elements::is_lossy_v<T_Element>;
+                entry.user_defined = std::is_same_v<T_Element, Programmable>;
+                entry.lattice_index = lattice_index;
+                if constexpr (std::is_same_v<T_Element, FusedLinear>) {
+                    entry.num_lattice_elements = element.size();
+                }
+                lattice_index += entry.num_lattice_elements;
+                schedule.push_back(std::move(entry));
+            }, element_variant);
+        }
+        return schedule;
+    }
+} // namespace
+
     ImpactX::ImpactX ()
         : AmrCore(initialization::init_amr_core()),
           m_particle_container(std::make_unique<ImpactXParticleContainer>(this)),
@@ -44,9 +156,6 @@ namespace impactx
 
         // query input for warning logger variables and set up warning logger accordingly
         init_warning_logger();
-
-        // move old diagnostics out of the way
-        amrex::UtilCreateCleanDirectory("diags", true);
     }
 
     void ImpactX::initGrids ()
@@ -74,12 +183,28 @@ namespace impactx
             }
         }
 
+        // move old diagnostics out of the way, unless the tracking continues from a checkpoint
+        std::string restart_file;
+        amrex::ParmParse("checkpoint").query("restart", restart_file);
+        if (restart_file.empty()) {
+            amrex::UtilCreateCleanDirectory("diags", true);
+        } else {
+            if (amrex::ParallelDescriptor::IOProcessor()) {
+                amrex::UtilCreateDirectory("diags", 0755);
+            }
+            amrex::ParallelDescriptor::Barrier();
+        }
+
         // the particle container has been set to track the same Geometry as ImpactX
 
         // this is the earliest point that we need to know the particle shape,
         // so that we can initialize the guard size of our MultiFabs
         m_particle_container->SetParticleShape();
 
+        // options set after the construction of the particle containers, e.g., in Python
+        m_particle_container->SetDynamicScheduling();
+        m_particles_lost->SetDynamicScheduling();
+
         // init blocks / grids & MultiFabs
         AmrCore::InitFromScratch(0.0);
         amrex::Print() << "boxArray(0) " << boxArray(0) << std::endl;
@@ -106,20 +231,29 @@ namespace impactx
 
         validate();
 
+        // continue the tracking after the slice of a checkpoint, see restart
+        std::optional<diagnostics::TrackingPosition> const resume = m_restart_position;
+        m_restart_position.reset();
+
         // a global step for diagnostics including space charge slice steps in elements
         //   before we start the evolve loop, we are in "step 0" (initial state)
-        int global_step = 0;
+        int global_step = resume ? resume->global_step : 0;
 
         // check typos in inputs after step 1
         bool early_params_checked = false;
 
+        // particles might have been marked as lost before the evolve, e.g., from Python
+        m_particle_container->MayHaveLostParticles(false);
+
         amrex::ParmParse pp_diag("diag");
         bool diag_enable = true;
         pp_diag.queryAdd("enable", diag_enable);
         amrex::Print() << " Diagnostics: " << diag_enable << "\n";
+        if (diag_enable) { diagnostics::InitDiagnosticOutput(); }
 
+        // the initial state was written by the run that wrote the checkpoint
         int file_min_digits = 6;
-        if (diag_enable)
+        if (diag_enable && !resume)
         {
             pp_diag.queryAdd("file_min_digits", file_min_digits);
 
@@ -140,127 +274,648 @@ namespace impactx
                                           diagnostics::OutputType::PrintReducedBeamCharacteristics,
                                           "diags/reduced_beam_characteristics");
 
+            // ... and of each ensemble member
+            if (m_particle_container->EnsembleSize() > 1) {
+                diagnostics::DiagnosticOutput(*m_particle_container,
+                                              diagnostics::OutputType::PrintEnsembleReducedBeamCharacteristics,
+                                              "diags/ensemble_reduced_beam_characteristics",
+                                              global_step);
+            }
+
         }
 
         amrex::ParmParse pp_algo("algo");
-        bool space_charge = true;
-        pp_algo.queryAdd("space_charge", space_charge);
-        amrex::Print() << " Space Charge effects: " << space_charge << "\n";
+        spacecharge::SpaceChargeAlgo const space_charge_algo = spacecharge::get_space_charge_algo();
+        bool const space_charge = space_charge_algo != spacecharge::SpaceChargeAlgo::False;
+        //   2.5D: longitudinal self-fields are neglected
+        bool const longitudinal_field = space_charge_algo != spacecharge::SpaceChargeAlgo::True_2p5D;
+        amrex::Print() << " Space Charge effects: " << space_charge
+                       << (longitudinal_field ? "" : " (2.5D)") << "\n";
+
+        // independent beams, tracked together
+        int const ensemble_size = m_particle_container->EnsembleSize();
+        bool const ensemble = ensemble_size > 1;
+        if (ensemble) {
+            amrex::Print() << " Ensemble members: " << ensemble_size << "\n";
+            if (space_charge)
+                throw std::runtime_error("The members of an ensemble are tracked without space charge. "
+                                         "Set algo.space_charge = false.");
+        }
+
+        // reads the algo.mlmg_* options, which might have changed since the last evolve
+        if (space_charge) { m_poisson_solver = std::make_unique<spacecharge::PoissonSolver>(); }
+        m_num_mesh_resizes = 0;
+        m_num_mesh_regrids = 0;
+
+        // space charge on particles at fixed s, without coordinate transformation passes
+        //   particles are not redistributed at fixed t: needs a single box
+        bool fused_space_charge = false;
+        pp_algo.queryAdd("fused_space_charge", fused_space_charge);
+        if (fused_space_charge && space_charge && (boxArray(0).size() > 1 || maxLevel() > 0)) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.fused_space_charge is ignored because the mesh has more "
+                "than one box or mesh-refinement levels. Increase amr.max_grid_size "
+                "or set amr.max_level = 0 to use it.",
+                ablastr::warn_manager::WarnPriority::low);
+            fused_space_charge = false;
+        }
+
+        // recompute the space charge field only every N slices or if the beam changed
+        //   in between, the cached field is rescaled to the current mesh
+        int space_charge_interval = 1;
+        pp_algo.queryAdd("space_charge_interval", space_charge_interval);
+        amrex::Real space_charge_rtol = 0.0;
+        pp_algo.queryAdd("space_charge_rtol", space_charge_rtol);
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(space_charge_interval >= 1,
+                                         "algo.space_charge_interval must be >= 1");
+
+        bool have_space_charge_field = false;
+        int slices_since_solve = 0;
+        amrex::RealVect solved_beam_width;
+        amrex::Real solved_gamma = 0.0;
+        amrex::RealBox field_domain;
+        long num_skipped_solves = 0;
+
+        // decide if the space charge field needs to be recomputed for this beam extent
+        auto const need_solve = [&](amrex::RealVect const & beam_min, amrex::RealVect const & beam_max)
+        {
+            amrex::RealVect const beam_width = beam_max - beam_min;
+            amrex::Real const gamma = m_particle_container->GetRefParticle().gamma();
+
+            bool solve = !have_space_charge_field || ++slices_since_solve >= space_charge_interval;
+            if (space_charge_rtol > 0.0) {
+                for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                    solve = solve || std::abs(beam_width[d] - solved_beam_width[d]) > space_charge_rtol * solved_beam_width[d];
+                }
+                solve = solve || std::abs(gamma - solved_gamma) > space_charge_rtol * solved_gamma;
+            }
+
+            if (solve) {
+                have_space_charge_field = true;
+                slices_since_solve = 0;
+                solved_beam_width = beam_width;
+                solved_gamma = gamma;
+                field_domain = Geom(0).ProbDomain();
+            } else {
+                ++num_skipped_solves;
+            }
+            return solve;
+        };
+
+        // the space charge force is either stored on the mesh or calculated
+        //   from the gradient of phi in the gather
+        bool store_space_charge_field = true;
+        pp_algo.queryAdd("store_space_charge_field", store_space_charge_field);
+        amrex::GpuArray<amrex::Real, 3> phi_gradient_scale{1.0, 1.0, 1.0};
+
+        // calculate the space charge force from phi
+        auto const calculate_field = [&]()
+        {
+            if (store_space_charge_field) {
+                spacecharge::ForceFromSelfFields(m_space_charge_field,
+                                                 m_phi,
+                                                 this->geom,
+                                                 longitudinal_field);
+            } else {
+                phi_gradient_scale = {1.0, 1.0, amrex::Real(longitudinal_field ? 1.0 : 0.0)};
+            }
+        };
+
+        // reuse the cached space charge field on the current mesh
+        auto const rescale_field = [&]()
+        {
+            amrex::RealBox const & domain = Geom(0).ProbDomain();
+            if (store_space_charge_field) {
+                spacecharge::RescaleSelfFields(m_space_charge_field, field_domain, domain);
+            } else {
+                spacecharge::RescaleSelfFields(phi_gradient_scale, field_domain, domain);
+            }
+            field_domain = domain;
+        };
 
         // periods through the lattice
         int periods = 1;
         amrex::ParmParse("lattice").queryAdd("periods", periods);
 
-        for (int cycle=0; cycle < periods; ++cycle) {
-            // loop over all beamline elements
-            for (auto &element_variant: m_lattice) {
-                // update element edge of the reference particle
-                m_particle_container->SetRefParticleEdge();
-
-                // number of slices used for the application of space charge
-                int nslice = 1;
-                amrex::ParticleReal slice_ds; // in meters
-                std::visit([&nslice, &slice_ds](auto &&element) {
-                    nslice = element.nslice();
-                    slice_ds = element.ds() / nslice;
-                }, element_variant);
+        // combine consecutive linear elements into single transfer maps
+        //   only possible if nothing acts on the beam between two slices
+        bool fuse_linear = false;
+        pp_algo.queryAdd("fuse_linear_elements", fuse_linear);
+        bool slice_step_diagnostics = false;
+        pp_diag.queryAdd("slice_step_diagnostics", slice_step_diagnostics);
+        if (ensemble && (fuse_linear || (diag_enable && slice_step_diagnostics))) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.fuse_linear_elements and diag.slice_step_diagnostics are ignored "
+                "for ensembles, which are tracked particle-major.",
+                ablastr::warn_manager::WarnPriority::low);
+            fuse_linear = false;
+            slice_step_diagnostics = false;
+        }
+        if (fuse_linear && (space_charge || (diag_enable && slice_step_diagnostics))) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.fuse_linear_elements is ignored because space charge or "
+                "slice step diagnostics are enabled.",
+                ablastr::warn_manager::WarnPriority::low);
+            fuse_linear = false;
+        }
 
-                // sub-steps for space charge within the element
-                for (int slice_step = 0; slice_step < nslice; ++slice_step) {
-                    BL_PROFILE("ImpactX::evolve::slice_step");
-                    global_step++;
-                    amrex::Print() << " ++++ Starting global_step=" << global_step
-                                   << " slice_step=" << slice_step << "\n";
-
-                    // Space-charge calculation: turn off if there is only 1 particle
-                    if (space_charge &&
-                        m_particle_container->TotalNumberOfParticles(false, false) > 1) {
-
-                        // transform from x',y',t to x,y,z
-                        transformation::CoordinateTransformation(
-                                *m_particle_container,
-                                transformation::Direction::to_fixed_t);
-
-                        // Note: The following operation assume that
-                        // the particles are in x, y, z coordinates.
-
-                        // Resize the mesh, based on `m_particle_container` extent
-                        ResizeMesh();
-
-                        // Redistribute particles in the new mesh in x, y, z
-                        m_particle_container->Redistribute();
-
-                        // charge deposition
-                        m_particle_container->DepositCharge(m_rho, this->refRatio());
-
-                        // poisson solve in x,y,z
-                        spacecharge::PoissonSolve(*m_particle_container, m_rho, m_phi);
-
-                        // calculate force in x,y,z
-                        spacecharge::ForceFromSelfFields(m_space_charge_field,
-                                                         m_phi,
-                                                         this->geom);
-
-                        // gather and space-charge push in x,y,z , assuming the space-charge
-                        // field is the same before/after transformation
-                        // TODO: This is currently using linear order.
-                        spacecharge::GatherAndPush(*m_particle_container,
-                                                   m_space_charge_field,
-                                                   this->geom,
-                                                   slice_ds);
-
-                        // transform from x,y,z to x',y',t
-                        transformation::CoordinateTransformation(*m_particle_container,
-                                                                 transformation::Direction::to_fixed_s);
-                    }
+        // stream lost particles to disk in batches, which frees their device memory
+        int lost_spill_threshold = 0;
+        pp_diag.queryAdd("lost_spill_threshold", lost_spill_threshold);
+        std::string lost_openpmd_backend = "default";
+        pp_diag.queryAdd("backend", lost_openpmd_backend);
+        int lost_batch = resume ? resume->lost_batch : 0;
+        if (lost_spill_threshold > 0 && !diag_enable) {
+            throw std::runtime_error("diag.lost_spill_threshold writes the lost particles to diagnostics "
+                                     "and requires diag.enable.");
+        }
+
+        // lost particles held on this MPI rank, counted when they are collected
+        amrex::Long num_lost_local = lost_spill_threshold > 0 ? m_particles_lost->TotalNumberOfParticles(false, true) : 0;
+
+        // write lost particles if any MPI rank holds at least threshold of them,
+        // or unconditionally at the end of the simulation
+        auto const write_lost = [&](bool final)
+        {
+            if (!diag_enable) { return; }
+
+            amrex::Long num_lost = final ? m_particles_lost->TotalNumberOfParticles(false, true) : num_lost_local;
+            amrex::ParallelAllReduce::Max(num_lost, amrex::ParallelDescriptor::Communicator());
+            if (num_lost == 0 || (!final && num_lost < lost_spill_threshold)) { return; }
+
+            diagnostics::BeamMonitor output_lost("particles_lost", lost_openpmd_backend, "g");
+            output_lost(*m_particles_lost, lost_batch++);
+
+            // the particles were staged on the host
+            if (lost_spill_threshold > 0) {
+                m_particles_lost->clearParticles();
+                num_lost_local = 0;
+            }
+        };
+
+        // redistribute the mesh boxes over the MPI ranks every few slices, by their number of particles
+        int load_balance_interval = 0;
+        pp_algo.queryAdd("load_balance_interval", load_balance_interval);
+        if (load_balance_interval > 0 && (!space_charge || fused_space_charge)) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.load_balance_interval is ignored because space charge is disabled "
+                "or calculated with algo.fused_space_charge on a single box.",
+                ablastr::warn_manager::WarnPriority::low);
+        }
+
+        // sort the particles by their mesh cell every few slices, for the locality of deposition and gather
+        int sort_interval = 0;
+        pp_algo.queryAdd("sort_interval", sort_interval);
+        amrex::Vector<int> sort_bin_size_v{1, 1, 1};
+        pp_algo.queryarr("sort_bin_size", sort_bin_size_v);
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(sort_bin_size_v.size() == AMREX_SPACEDIM,
+                                         "algo.sort_bin_size must have three entries");
+        amrex::IntVect const sort_bin_size(sort_bin_size_v);
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(sort_bin_size.allGT(0),
+                                         "algo.sort_bin_size must be positive");
+        if (sort_interval > 0 && (!space_charge || fused_space_charge)) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.sort_interval is ignored because space charge is disabled "
+                "or calculated with algo.fused_space_charge at fixed s.",
+                ablastr::warn_manager::WarnPriority::low);
+        }
+        amrex::Long num_sorts = 0;
+        double sort_time = 0.0;
+
+        // replay the reference particle pushes of the first period in later periods
+        bool cache_ref_particle = false;
+        pp_algo.queryAdd("cache_ref_particle", cache_ref_particle);
+        RefPartCache & ref_part_cache = m_particle_container->GetRefParticleCache();
+        ref_part_cache.enable(cache_ref_particle && periods > 1 && !ensemble);
+
+        std::list<KnownElements> fused_lattice;
+        if (fuse_linear) { fused_lattice = fuse_linear_elements(m_lattice); }
+        std::list<KnownElements> & lattice = fuse_linear ? fused_lattice : m_lattice;
+        std::vector<ElementSchedule> const schedule = make_schedule(lattice);
+        //   checkpoints store their position in the lattice before fusion
+        std::vector<ElementSchedule> const lattice_schedule = fuse_linear ? make_schedule(m_lattice) : schedule;
+
+        // push each particle through all elements and periods in one kernel
+        //   ensembles are always tracked this way, all members in the same kernel
+        bool particle_major = false;
+        pp_algo.queryAdd("particle_major", particle_major);
+        particle_major = particle_major || ensemble;
+
+        // push SIMD vectors of particles through vectorized elements, in builds with ImpactX_SIMD
+        bool simd = true;
+        pp_algo.queryAdd("simd", simd);
+        m_particle_container->SetSIMD(simd);
+#ifdef ImpactX_USE_SIMD
+        if (simd) {
+            amrex::Print() << " SIMD width of the particle pushes: " << elements::RealVec::size() << "\n";
+        }
+#endif
+        if (particle_major && (space_charge || (diag_enable && slice_step_diagnostics))) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "algo.particle_major is ignored because space charge or "
+                "slice step diagnostics are enabled.",
+                ablastr::warn_manager::WarnPriority::low);
+            particle_major = false;
+        }
+
+        // wall time per lattice element and phase, synchronizes the device after each phase
+        bool element_profile = false;
+        pp_diag.queryAdd("element_profile", element_profile);
+        if (element_profile && particle_major) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "diag.element_profile is ignored with algo.particle_major, "
+                "which pushes through all elements in one kernel.",
+                ablastr::warn_manager::WarnPriority::low);
+            element_profile = false;
+        }
+        m_element_profile.reset(element_profile);
+
+        // print a line per slice step
+        int verbose = 1;
+        amrex::ParmParse("impactx").queryAdd("verbose", verbose);
+
+        // write checkpoints every N slices and/or every N seconds of wall time
+        amrex::ParmParse pp_checkpoint("checkpoint");
+        int checkpoint_step_interval = 0;
+        pp_checkpoint.queryAdd("step_interval", checkpoint_step_interval);
+        double checkpoint_walltime_interval = 0.0;
+        pp_checkpoint.queryAdd("walltime_interval", checkpoint_walltime_interval);
+        bool const write_checkpoints = checkpoint_step_interval > 0 || checkpoint_walltime_interval > 0.0;
+        if (write_checkpoints && particle_major) {
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::evolve",
+                "checkpoint.step_interval and checkpoint.walltime_interval are ignored "
+                "with algo.particle_major, which pushes through all elements in one kernel.",
+                ablastr::warn_manager::WarnPriority::low);
+        }
+        if (resume && particle_major) {
+            throw std::runtime_error("A restart from a checkpoint cannot be tracked with algo.particle_major "
+                                     "or ensembles, which push through all elements in one kernel.");
+        }
+        double last_checkpoint_time = amrex::second();
+        int num_checkpoints = 0;
+
+        // element and first slice to continue with after a restart, in the possibly fused lattice
+        int resume_element = 0;
+        int resume_first_slice_step = 0;
+        if (resume) {
+            int const index = resume->element_index;
+            if (index < 0 || index >= int(lattice_schedule.size()) ||
+                resume->slice_step < 0 || resume->slice_step >= lattice_schedule[index].nslice) {
+                throw std::runtime_error("The position of the checkpoint (element " + std::to_string(index) +
+                                         ", slice " + std::to_string(resume->slice_step) +
+                                         ") is not in the lattice: it must be the same as in the run that wrote the checkpoint.");
+            }
+            auto const fused = std::find_if(schedule.begin(), schedule.end(), [index](ElementSchedule const & entry) {
+                return index < entry.lattice_index + entry.num_lattice_elements;
+            });
+            resume_element = int(fused - schedule.begin());
+            bool const last_slice = index == fused->lattice_index + fused->num_lattice_elements - 1 &&
+                                    resume->slice_step == lattice_schedule[index].nslice - 1;
+            if (fused->num_lattice_elements == 1) {
+                resume_first_slice_step = resume->slice_step + 1;
+            } else if (last_slice) {
+                resume_first_slice_step = fused->nslice;
+            } else {
+                throw std::runtime_error("The checkpoint was written inside lattice elements that "
+                                         "algo.fuse_linear_elements fuses into one element "
+                                         "(element " + std::to_string(index) + ", slice " + std::to_string(resume->slice_step) +
+                                         "): restart with algo.fuse_linear_elements = 0.");
+            }
+        }
 
-                    // for later: original Impact implementation as an option
-                    // Redistribute particles in x',y',t
-                    //   TODO: only needed if we want to gather and push space charge
-                    //         in x',y',t
-                    //   TODO: change geometry beforehand according to transformation
-                    //m_particle_container->Redistribute();
-                    //
-                    // in original Impact, we gather and space-charge push in x',y',t ,
-                    // assuming that the distribution did not change
-
-                    // push all particles with external maps
-                    Push(*m_particle_container, element_variant, global_step);
-
-                    // move "lost" particles to another particle container
-                    collect_lost_particles(*m_particle_container);
-
-                    // just prints an empty newline at the end of the slice_step
-                    amrex::Print() << "\n";
-
-                    // slice-step diagnostics
-                    bool slice_step_diagnostics = false;
-                    pp_diag.queryAdd("slice_step_diagnostics", slice_step_diagnostics);
-
-                    if (diag_enable && slice_step_diagnostics) {
-                        // print slice step reference particle to file
-                        diagnostics::DiagnosticOutput(*m_particle_container,
-                                                      diagnostics::OutputType::PrintRefParticle,
-                                                      "diags/ref_particle",
-                                                      global_step,
-                                                      true);
-
-                        // print slice step reduced beam characteristics to file
-                        diagnostics::DiagnosticOutput(*m_particle_container,
-                                                      diagnostics::OutputType::PrintReducedBeamCharacteristics,
-                                                      "diags/reduced_beam_characteristics",
-                                                      global_step,
-                                                      true);
+        // write a checkpoint after a slice, if one of the intervals has passed
+        auto const checkpoint = [&](int period, int element_index, int slice_step)
+        {
+            bool write = checkpoint_step_interval > 0 && global_step % checkpoint_step_interval == 0;
+            if (checkpoint_walltime_interval > 0.0) {
+                // all MPI ranks decide on the clock of the IO rank
+                double elapsed = amrex::second() - last_checkpoint_time;
+                amrex::ParallelDescriptor::Bcast(&elapsed, 1, amrex::ParallelDescriptor::IOProcessorNumber());
+                write = write || elapsed >= checkpoint_walltime_interval;
+            }
+            if (!write) { return; }
+
+            // after a fused element, all lattice elements fused into it are tracked
+            ElementSchedule const & entry = schedule[element_index];
+            int const lattice_index = entry.lattice_index + entry.num_lattice_elements - 1;
+            int const lattice_slice_step = entry.num_lattice_elements > 1 ?
+                lattice_schedule[lattice_index].nslice - 1 : slice_step;
+
+            diagnostics::TrackingPosition const position{global_step, period, lattice_index, lattice_slice_step, lost_batch};
+            std::string const file_name = diagnostics::WriteCheckpoint(*m_particle_container, *m_particles_lost, position);
+            amrex::Print() << " Checkpoint written to " << file_name << "\n";
+            last_checkpoint_time = amrex::second();
+            num_checkpoints++;
+        };
+
+        // particle data read and written by a push
+        std::size_t const bytes_per_particle = 2u * (
+            std::size_t(m_particle_container->NumRealComps()) * sizeof(amrex::ParticleReal) +
+            std::size_t(m_particle_container->NumIntComps()) * sizeof(int) +
+            sizeof(uint64_t));
+
+        // performance counters of the tracking loop
+        //   counting the particles and sampling the device memory in every
+        //   slice costs a loop over the tiles each, so this is opt-in
+        bool performance_counters = false;
+        pp_diag.queryAdd("performance_counters", performance_counters);
+        double const evolve_start_time = amrex::second();
+        amrex::Long num_particle_pushes = 0;
+        std::size_t max_device_memory = device_memory_used();
+
+        if (particle_major) {
+            amrex::Print() << " ++++ Particle-major tracking through " << periods << " periods\n";
+            amrex::Long const num_particles = m_particle_container->TotalNumberOfParticles(false, true);
+            int const first_step = global_step;
+            std::vector<std::list<KnownElements> *> lattices{&lattice};
+            for (auto & member_lattice : m_ensemble_lattices) { lattices.push_back(&member_lattice); }
+            track_particle_major(*m_particle_container, lattices, periods, global_step);
+
+            // approximately: particles lost on the way are counted as pushed
+            num_particle_pushes = num_particles * (global_step - first_step);
+            max_device_memory = std::max(max_device_memory, device_memory_used());
+
+            // inputs: unused parameters (e.g. typos) check
+            early_params_checked = early_param_check();
+        } else {
+            // global number of beam particles, for the space charge decision
+            //   only elements that can lose particles change it, so it is
+            //   reduced over the MPI ranks only after those
+            amrex::Long num_particles = space_charge ? m_particle_container->TotalNumberOfParticles(false, false) : 0;
+            amrex::Long num_lost_unreduced = 0;
+            bool num_particles_outdated = false;
+
+            for (int cycle = resume ? resume->period : 0; cycle < periods; ++cycle) {
+                ref_part_cache.start_period();
 
+                // loop over all beamline elements
+                int element_index = 0;
+                for (auto &element_variant: lattice) {
+                    // skip the elements before the checkpoint, then continue after its slice
+                    int first_slice_step = 0;
+                    if (resume && cycle == resume->period) {
+                        if (element_index < resume_element) {
+                            element_index++;
+                            continue;
+                        }
+                        if (element_index == resume_element) {
+                            first_slice_step = resume_first_slice_step;
+                        }
                     }
 
-                    // inputs: unused parameters (e.g. typos) check after step 1 has finished
-                    if (!early_params_checked) { early_params_checked = early_param_check(); }
+                    // update element edge of the reference particle
+                    //   in the element of the checkpoint, it was restored
+                    if (first_slice_step == 0) {
+                        m_particle_container->SetRefParticleEdge();
+                    }
+
+                    // number of slices used for the application of space charge
+                    ElementSchedule const & element_schedule = schedule[element_index];
+                    int const nslice = element_schedule.nslice;
+                    amrex::Real const slice_ds = element_schedule.slice_ds; // in meters
+
+                    // sub-steps for space charge within the element
+                    for (int slice_step = first_slice_step; slice_step < nslice; ++slice_step) {
+                        BL_PROFILE("ImpactX::evolve::slice_step");
+                        global_step++;
+                        if (verbose > 0) {
+                            amrex::Print() << " ++++ Starting global_step=" << global_step
+                                           << " slice_step=" << slice_step << "\n";
+                        }
+                        m_element_profile.start_slice(element_schedule.lattice_index,
+                                                      element_schedule.num_lattice_elements,
+                                                      element_schedule.name);
+
+                        // Space-charge calculation: turn off if there is only 1 particle
+                        if (space_charge && num_particles_outdated) {
+                            amrex::ParallelDescriptor::ReduceLongSum(num_lost_unreduced);
+                            num_particles -= num_lost_unreduced;
+                            num_lost_unreduced = 0;
+                            num_particles_outdated = false;
+                        }
+                        bool const do_space_charge = space_charge && num_particles > 1;
+                        if (do_space_charge && fused_space_charge) {
+                            // Resize the mesh, based on the x, y, z extent of `m_particle_container`
+                            auto const [x_min, y_min, z_min, x_max, y_max, z_max] =
+                                spacecharge::MinAndMaxPositionsFixedT(*m_particle_container);
+                            amrex::RealVect const beam_min{x_min, y_min, z_min};
+                            amrex::RealVect const beam_max{x_max, y_max, z_max};
+                            ResizeMesh(beam_min, beam_max);
+
+                            if (need_solve(beam_min, beam_max)) {
+                                // charge deposition in x,y,z
+                                spacecharge::DepositChargeFixedS(*m_particle_container, m_rho);
+                                m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeDeposit);
+
+                                // poisson solve in x,y,z
+                                m_poisson_solver->solve(*m_particle_container, m_rho, m_phi);
+
+                                // calculate force in x,y,z
+                                calculate_field();
+                            } else {
+                                m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeDeposit);
+                                rescale_field();
+                            }
+
+                            m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeSolve);
+
+                            // gather and space-charge push in x,y,z, then back to x',y',t
+                            if (store_space_charge_field) {
+                                spacecharge::GatherAndPushFixedS(*m_particle_container,
+                                                                 m_space_charge_field,
+                                                                 this->geom,
+                                                                 slice_ds);
+                            } else {
+                                spacecharge::GatherAndPushFixedS(*m_particle_container,
+                                                                 m_phi,
+                                                                 phi_gradient_scale,
+                                                                 this->geom,
+                                                                 slice_ds);
+                            }
+                            m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeGather);
+                        } else if (do_space_charge) {
+
+                            // transform from x',y',t to x,y,z
+                            transformation::CoordinateTransformation(
+                                    *m_particle_container,
+                                    transformation::Direction::to_fixed_t);
+
+                            // Note: The following operation assume that
+                            // the particles are in x, y, z coordinates.
+
+                            // Resize the mesh, based on `m_particle_container` extent
+                            auto const [x_min, y_min, z_min, x_max, y_max, z_max] =
+                                m_particle_container->MinAndMaxPositions();
+                            amrex::RealVect const beam_min{x_min, y_min, z_min};
+                            amrex::RealVect const beam_max{x_max, y_max, z_max};
+                            bool const regrid = ResizeMesh(beam_min, beam_max);
+
+                            // Redistribute particles in the new mesh in x, y, z
+                            //   if the mesh did not change and no particle moved
+                            //   more than one cell out of its box since the last
+                            //   slice: local redistribution
+                            if (regrid || m_particle_container->MaxCellsOutsideGrid() > 1.0) {
+                                m_particle_container->Redistribute();
+                            } else {
+                                int const lev_min = 0, lev_max = -1, nGrow = 0, local = 1;
+                                m_particle_container->Redistribute(lev_min, lev_max, nGrow, local);
+                            }
+
+                            // balance the boxes by their number of particles, then move the particles with their boxes
+                            if (load_balance_interval > 0 && global_step % load_balance_interval == 0) {
+                                if (LoadBalance()) { m_particle_container->Redistribute(); }
+                            }
+
+                            // sort the particles of each box by cell, in place
+                            if (sort_interval > 0 && global_step % sort_interval == 0) {
+                                m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeDeposit);
+                                double const sort_start = amrex::second();
+                                m_particle_container->SortParticlesByBin(sort_bin_size);
+                                amrex::Gpu::streamSynchronize();
+                                sort_time += amrex::second() - sort_start;
+                                num_sorts++;
+                                m_element_profile.lap(diagnostics::ProfilePhase::Sort);
+                            }
+
+                            if (need_solve(beam_min, beam_max)) {
+                                // charge deposition
+                                m_particle_container->DepositCharge(m_rho, this->refRatio());
+
+                                // mesh-refinement: refine where the charge density is high
+                                //   each regrid adds at most one level
+                                for (int i = 0; i < maxLevel() && Regrid(); ++i) {
+                                    m_particle_container->Redistribute();
+                                    m_particle_container->DepositCharge(m_rho, this->refRatio());
+                                }
+                                m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeDeposit);
+
+                                // poisson solve in x,y,z
+                                m_poisson_solver->solve(*m_particle_container, m_rho, m_phi);
+
+                                // calculate force in x,y,z
+                                calculate_field();
+                            } else {
+                                m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeDeposit);
+                                rescale_field();
+                            }
+
+                            m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeSolve);
+
+                            // gather and space-charge push in x,y,z , assuming the space-charge
+                            // field is the same before/after transformation
+                            // TODO: This is currently using linear order.
+                            if (store_space_charge_field) {
+                                spacecharge::GatherAndPush(*m_particle_container,
+                                                           m_space_charge_field,
+                                                           this->geom,
+                                                           slice_ds);
+                            } else {
+                                spacecharge::GatherAndPush(*m_particle_container,
+                                                           m_phi,
+                                                           phi_gradient_scale,
+                                                           this->geom,
+                                                           slice_ds);
+                            }
+
+                            // transform from x,y,z to x',y',t
+                            transformation::CoordinateTransformation(*m_particle_container,
+                                                                     transformation::Direction::to_fixed_s);
+                            m_element_profile.lap(diagnostics::ProfilePhase::SpaceChargeGather);
+                        }
+
+                        // for later: original Impact implementation as an option
+                        // Redistribute particles in x',y',t
+                        //   TODO: only needed if we want to gather and push space charge
+                        //         in x',y',t
+                        //   TODO: change geometry beforehand according to transformation
+                        //m_particle_container->Redistribute();
+                        //
+                        // in original Impact, we gather and space-charge push in x',y',t ,
+                        // assuming that the distribution did not change
+
+                        // push all particles with external maps
+                        if (performance_counters || m_element_profile.enabled()) {
+                            amrex::Long const num_pushed = m_particle_container->TotalNumberOfParticles(false, true);
+                            num_particle_pushes += num_pushed;
+                            m_element_profile.add_particles(num_pushed, bytes_per_particle);
+                        }
+                        Push(*m_particle_container, element_variant, global_step);
+                        if (performance_counters) {
+                            max_device_memory = std::max(max_device_memory, device_memory_used());
+                        }
+                        m_element_profile.lap(diagnostics::ProfilePhase::Push);
+
+                        // move "lost" particles to another particle container
+                        amrex::Long const num_lost = collect_lost_particles(*m_particle_container);
+                        num_lost_local += num_lost;
+                        if (element_schedule.user_defined) {
+                            // the push might also have added particles
+                            if (space_charge) { num_particles = m_particle_container->TotalNumberOfParticles(false, false); }
+                            num_lost_unreduced = 0;
+                            num_particles_outdated = false;
+                        } else if (element_schedule.may_lose_particles) {
+                            num_lost_unreduced += num_lost;
+                            num_particles_outdated = true;
+                        }
+                        m_element_profile.lap(diagnostics::ProfilePhase::CollectLost);
+
+                        // just prints an empty newline at the end of the slice_step
+                        if (verbose > 0) { amrex::Print() << "\n"; }
+
+                        // slice-step diagnostics
+                        if (diag_enable && slice_step_diagnostics) {
+                            // print slice step reference particle to file
+                            diagnostics::DiagnosticOutput(*m_particle_container,
+                                                          diagnostics::OutputType::PrintRefParticle,
+                                                          "diags/ref_particle",
+                                                          global_step,
+                                                          true);
+
+                            // print slice step reduced beam characteristics to file
+                            diagnostics::DiagnosticOutput(*m_particle_container,
+                                                          diagnostics::OutputType::PrintReducedBeamCharacteristics,
+                                                          "diags/reduced_beam_characteristics",
+                                                          global_step,
+                                                          true);
+
+                        }
+
+                        // inputs: unused parameters (e.g. typos) check after step 1 has finished
+                        if (!early_params_checked) { early_params_checked = early_param_check(); }
 
-                } // end in-element space-charge slice-step loop
+                        if (write_checkpoints) { checkpoint(cycle, element_index, slice_step); }
 
-            } // end beamline element loop
-        } // end periods though the lattice loop
+                        m_element_profile.lap(diagnostics::ProfilePhase::Other);
+                    } // end in-element space-charge slice-step loop
+
+                    // only elements that can lose particles add to the lost particles, so
+                    //   the MPI ranks decide on a spill only after those
+                    if (lost_spill_threshold > 0 && (element_schedule.may_lose_particles || element_schedule.user_defined)) {
+                        write_lost(false);
+                        m_element_profile.lap(diagnostics::ProfilePhase::Other);
+                    }
+
+                    element_index++;
+                } // end beamline element loop
+            } // end periods though the lattice loop
+        }
+        amrex::Gpu::streamSynchronize();
+        double const evolve_time = amrex::second() - evolve_start_time;
+
+        if (cache_ref_particle && periods > 1 && !ensemble) {
+            amrex::Print() << " ++++ Reference particle pushes replayed from the first period: "
+                           << ref_part_cache.num_hits() << " of "
+                           << ref_part_cache.num_hits() + ref_part_cache.num_misses() << " slices of cached elements\n";
+        }
+        ref_part_cache.enable(false);
 
         if (diag_enable)
         {
@@ -282,18 +937,83 @@ namespace impactx
                                           "diags/reduced_beam_characteristics_final",
                                           global_step);
 
+            // ... and of each ensemble member
+            if (ensemble) {
+                diagnostics::DiagnosticOutput(*m_particle_container,
+                                              diagnostics::OutputType::PrintEnsembleReducedBeamCharacteristics,
+                                              "diags/ensemble_reduced_beam_characteristics_final",
+                                              global_step);
+            }
+
+            // write diagnostics that are still in flight or buffered
+            diagnostics::FinishDiagnosticOutput();
+
             // output particles lost in apertures
-            if (m_particles_lost->TotalNumberOfParticles() > 0)
+            write_lost(true);
+            if (lost_batch > 0)
             {
-                std::string openpmd_backend = "default";
-                pp_diag.queryAdd("backend", openpmd_backend);
-
-                diagnostics::BeamMonitor output_lost("particles_lost", openpmd_backend, "g");
-                output_lost(*m_particles_lost, 0);
+                diagnostics::BeamMonitor output_lost("particles_lost", lost_openpmd_backend, "g");
                 output_lost.finalize();
             }
         }
 
+        // performance summary, e.g., for benchmarks
+        if (performance_counters)
+        {
+            amrex::ParallelDescriptor::ReduceLongSum(num_particle_pushes);
+            amrex::Long max_device_memory_all = amrex::Long(max_device_memory);
+            amrex::Long max_host_memory_all = amrex::Long(host_memory_high_water_mark());
+            amrex::ParallelDescriptor::ReduceLongMax(max_device_memory_all);
+            amrex::ParallelDescriptor::ReduceLongMax(max_host_memory_all);
+            amrex::Print() << " Evolve time (s): " << evolve_time
+                           << ", particle pushes: " << num_particle_pushes
+                           << ", per second: " << (evolve_time > 0.0 ? double(num_particle_pushes) / evolve_time : 0.0) << "\n";
+            amrex::Print() << " Memory high-water mark per MPI rank (MB): host " << double(max_host_memory_all) / 1.0e6
+                           << ", device " << double(max_device_memory_all) / 1.0e6 << "\n";
+        }
+        else
+        {
+            amrex::Print() << " Evolve time (s): " << evolve_time << "\n";
+        }
+
+        if (num_checkpoints > 0)
+        {
+            amrex::Print() << " Checkpoints written: " << num_checkpoints << "\n";
+        }
+
+        if (num_sorts > 0)
+        {
+            amrex::ParallelAllReduce::Max(sort_time, amrex::ParallelDescriptor::Communicator());
+            amrex::Print() << " Particle sorts: " << num_sorts
+                           << ", sort time (s): " << sort_time << "\n";
+        }
+
+        // wall time per lattice element
+        if (element_profile)
+        {
+            m_element_profile.reduce();
+            m_element_profile.write("diags/element_profile.txt");
+            amrex::Print() << " Element profile written to diags/element_profile.txt\n";
+        }
+
+        if (m_poisson_solver)
+        {
+            amrex::Print() << " Poisson solves: " << m_poisson_solver->num_solves()
+                           << ", MLMG iterations: " << m_poisson_solver->total_iters()
+                           << ", operator builds: " << m_poisson_solver->num_rebuilds();
+            if (performance_counters) {
+                amrex::Print() << ", solve time (s): " << m_poisson_solver->total_time();
+            }
+            amrex::Print() << "\n";
+
+            // release the MLMG operator and its multigrid hierarchy
+            m_poisson_solver.reset();
+
+            amrex::Print() << " Skipped space charge solves: " << num_skipped_solves << "\n";
+            amrex::Print() << " Mesh resizes: " << m_num_mesh_resizes
+                           << ", of which changed the mesh: " << m_num_mesh_regrids << "\n";
+        }
+
         // loop over all beamline elements & finalize them
         for (auto & element_variant : m_lattice)
         {
@@ -302,5 +1022,23 @@ namespace impactx
             }, element_variant);
         }
 
+        for (auto & member_lattice : m_ensemble_lattices)
+        {
+            for (auto & element_variant : member_lattice)
+            {
+                std::visit([](auto&& element){
+                    element.finalize();
+                }, element_variant);
+            }
+        }
+
+        // the other elements in the fused lattice are copies of the above
+        for (auto & element_variant : fused_lattice)
+        {
+            if (auto * fused = std::get_if<FusedLinear>(&element_variant)) {
+                fused->finalize();
+            }
+        }
+
     }
 } // namespace impactx
@@ -9,6 +9,7 @@
  */
 #include "ImpactX.H"
 #include "particles/ImpactXParticleContainer.H"
+#include "particles/diagnostics/Checkpoint.H"
 #include "particles/distribution/All.H"
 
 #include <ablastr/constant.H>
@@ -16,26 +17,124 @@
 
 #include <AMReX.H>
 #include <AMReX_BLProfiler.H>
+#include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_GpuLaunch.H>
+#include <AMReX_Particle.H>
 #include <AMReX_REAL.H>
 #include <AMReX_ParmParse.H>
 #include <AMReX_Print.H>
+#include <AMReX_Random.H>
 
+#include <cstdint>
+#include <list>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <variant>
 
 
 namespace impactx
 {
+namespace detail
+{
+    /** Sample a single particle from a distribution into the particle arrays
+     *
+     * Note: a C++ functor instead of a lambda, since nvcc does not allow
+     * extended device lambdas in the generic lambda used to std::visit the
+     * distribution, see elements::detail::PushSingleParticle.
+     *
+     * @tparam T_Distribution This can be a \see distribution::Gaussian, \see distribution::Waterbag, etc.
+     */
+    template <typename T_Distribution>
+    struct InitSingleParticleData
+    {
+        /** Constructor taking in pointers to the particle data of the new particles
+         *
+         * @param distribution the distribution to sample from
+         * @param part_x,part_y,part_t the arrays to the particle positions
+         * @param part_px,part_py,part_pt the arrays to the particle momenta
+         * @param part_qm the array to the particle charge over mass
+         * @param part_w the array to the particle weight
+         * @param part_idcpu the array to the particle id and cpu
+         * @param qm charge over mass in 1/eV
+         * @param w weight of each particle
+         * @param first_id particle id of the first particle
+         * @param cpu MPI rank that creates the particles
+         */
+        InitSingleParticleData (
+            T_Distribution distribution,
+            amrex::ParticleReal* AMREX_RESTRICT part_x,
+            amrex::ParticleReal* AMREX_RESTRICT part_y,
+            amrex::ParticleReal* AMREX_RESTRICT part_t,
+            amrex::ParticleReal* AMREX_RESTRICT part_px,
+            amrex::ParticleReal* AMREX_RESTRICT part_py,
+            amrex::ParticleReal* AMREX_RESTRICT part_pt,
+            amrex::ParticleReal* AMREX_RESTRICT part_qm,
+            amrex::ParticleReal* AMREX_RESTRICT part_w,
+            uint64_t* AMREX_RESTRICT part_idcpu,
+            amrex::ParticleReal qm,
+            amrex::ParticleReal w,
+            amrex::Long first_id,
+            int cpu
+        )
+        : m_distribution(std::move(distribution)),
+          m_part_x(part_x), m_part_y(part_y), m_part_t(part_t),
+          m_part_px(part_px), m_part_py(part_py), m_part_pt(part_pt),
+          m_part_qm(part_qm), m_part_w(part_w), m_part_idcpu(part_idcpu),
+          m_qm(qm), m_w(w), m_first_id(first_id), m_cpu(cpu)
+        {
+        }
+
+        /** Sample particle i
+         *
+         * @param i particle index relative to the first new particle
+         * @param engine a random number engine (with associated state)
+         */
+        AMREX_GPU_DEVICE AMREX_FORCE_INLINE
+        void
+        operator() (int i, amrex::RandomEngine const & engine) const
+        {
+            m_distribution(m_part_x[i], m_part_y[i], m_part_t[i],
+                           m_part_px[i], m_part_py[i], m_part_pt[i],
+                           engine);
+            m_part_qm[i] = m_qm;
+            m_part_w[i] = m_w;
+            m_part_idcpu[i] = amrex::SetParticleIDandCPU(m_first_id + i, m_cpu);
+        }
+
+    private:
+        T_Distribution const m_distribution;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_x;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_y;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_t;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_px;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_py;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_pt;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_qm;
+        amrex::ParticleReal* const AMREX_RESTRICT m_part_w;
+        uint64_t* const AMREX_RESTRICT m_part_idcpu;
+        amrex::ParticleReal const m_qm;
+        amrex::ParticleReal const m_w;
+        amrex::Long const m_first_id;
+        int const m_cpu;
+    };
+} // namespace detail
+
     void
     ImpactX::add_particles (
         amrex::ParticleReal bunch_charge,
         distribution::KnownDistributions distr,
-        int npart
+        int npart,
+        int ensemble_member
     )
     {
         BL_PROFILE("ImpactX::add_particles");
 
-        auto const & ref = m_particle_container->GetRefParticle();
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(
+            ensemble_member >= 0 && ensemble_member < m_particle_container->EnsembleSize(),
+            "add_particles: no such ensemble member. Add it first with add_ensemble_member.");
+
+        auto const & ref = m_particle_container->GetEnsembleRefParticle(ensemble_member);
         AMREX_ALWAYS_ASSERT_WITH_MESSAGE(ref.charge_qe() != 0.0,
             "add_particles: Reference particle charge not yet set!");
         AMREX_ALWAYS_ASSERT_WITH_MESSAGE(ref.mass_MeV() != 0.0,
@@ -56,11 +155,6 @@ namespace impactx
             );
         }
 
-        amrex::Vector<amrex::ParticleReal> x, y, t;
-        amrex::Vector<amrex::ParticleReal> px, py, pt;
-        amrex::ParticleReal ix, iy, it, ipx, ipy, ipt;
-        amrex::RandomEngine rng;
-
         // Logic: We initialize 1/Nth of particles, independent of their
         // position, per MPI rank. We then measure the distribution's spatial
         // extent, create a grid, resize it to fit the beam, and then
@@ -70,32 +164,40 @@ namespace impactx
         int const navg = npart / nprocs;
         int const nleft = npart - navg * nprocs;
         int npart_this_proc = (myproc < nleft) ? navg+1 : navg;
-        auto const rel_part_this_proc = amrex::ParticleReal(npart_this_proc) /
-                                        amrex::ParticleReal(npart);
+
+        // sample the particles in parallel, directly into the particle tile
+        //   the random engines are seeded per MPI rank on initialization of AMReX
+        int const lev = 0;
+        auto & particle_tile = m_particle_container->DefineAndReturnParticleTile(lev, 0, 0);
+        int const old_np = particle_tile.numParticles();
+        particle_tile.resize(old_np + npart_this_proc);
+
+        // reserve a contiguous range of particle ids
+        amrex::Long const first_id = ImpactXParticleContainer::ParticleType::NextID();
+        ImpactXParticleContainer::ParticleType::NextID(first_id + npart_this_proc);
+
+        // all particles carry the same share of the bunch charge
+        amrex::ParticleReal const w = bunch_charge / ablastr::constant::SI::q_e / npart;
 
         std::visit([&](auto&& distribution){
-            x.reserve(npart_this_proc);
-            y.reserve(npart_this_proc);
-            t.reserve(npart_this_proc);
-            px.reserve(npart_this_proc);
-            py.reserve(npart_this_proc);
-            pt.reserve(npart_this_proc);
-
-            for (amrex::Long i = 0; i < npart_this_proc; ++i) {
-                distribution(ix, iy, it, ipx, ipy, ipt, rng);
-                x.push_back(ix);
-                y.push_back(iy);
-                t.push_back(it);
-                px.push_back(ipx);
-                py.push_back(ipy);
-                pt.push_back(ipt);
-            }
+            using Distribution = std::decay_t<decltype(distribution)>;
+
+            auto & soa = particle_tile.GetStructOfArrays();
+            detail::InitSingleParticleData<Distribution> const init_single_particle(
+                distribution,
+                soa.GetRealData(RealSoA::x).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::y).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::t).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::px).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::py).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::pt).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::qm).dataPtr() + old_np,
+                soa.GetRealData(RealSoA::w).dataPtr() + old_np,
+                soa.GetIdCPUData().dataPtr() + old_np,
+                ref.qm_qeeV(), w, first_id, myproc);
+            amrex::ParallelForRNG(npart_this_proc, init_single_particle);
         }, distr);
-
-        int const lev = 0;
-        m_particle_container->AddNParticles(lev, x, y, t, px, py, pt,
-                                            ref.qm_qeeV(),
-                                            bunch_charge * rel_part_this_proc);
+        m_particle_container->SetEnsembleMember(particle_tile, old_np, npart_this_proc, ensemble_member);
 
         // Resize the mesh to fit the spatial extent of the beam and then
         // redistribute particles, so they reside on the MPI rank that is
@@ -104,26 +206,72 @@ namespace impactx
         m_particle_container->Redistribute();
     }
 
+    void
+    ImpactX::restart ()
+    {
+        BL_PROFILE("ImpactX::restart");
+
+        std::string restart_file;
+        amrex::ParmParse("checkpoint").get("restart", restart_file);
+
+        m_particle_container->clearParticles();
+        m_particles_lost->clearParticles();
+        m_restart_position = diagnostics::ReadCheckpoint(restart_file, *m_particle_container, *m_particles_lost);
+
+        // Resize the mesh to fit the spatial extent of the beam and then
+        // redistribute particles, see add_particles.
+        this->ResizeMesh();
+        m_particle_container->Redistribute();
+
+        amrex::Print() << "Restarted from checkpoint " << restart_file
+                       << " after global_step=" << m_restart_position->global_step << std::endl;
+        amrex::Print() << "# of particles: " << m_particle_container->TotalNumberOfParticles() << std::endl;
+    }
+
+    int
+    ImpactX::add_ensemble_member (
+        RefPart const & ref_part,
+        std::list<KnownElements> lattice
+    )
+    {
+        BL_PROFILE("ImpactX::add_ensemble_member");
+
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(ref_part.kin_energy_MeV() != 0.0,
+            "add_ensemble_member: Reference particle energy not yet set!");
+
+        int const member = m_particle_container->AddEnsembleMember(ref_part);
+        m_ensemble_lattices.push_back(std::move(lattice));
+        return member;
+    }
+
     void ImpactX::initBeamDistributionFromInputs ()
     {
         BL_PROFILE("ImpactX::initBeamDistributionFromInputs");
 
         using namespace amrex::literals;
 
+        // continue from a checkpoint instead
+        std::string restart_file;
+        amrex::ParmParse("checkpoint").query("restart", restart_file);
+        if (!restart_file.empty()) {
+            restart();
+            return;
+        }
+
         // Parse the beam distribution parameters
         amrex::ParmParse const pp_dist("beam");
 
-        amrex::ParticleReal kin_energy = 0.0;  // Beam kinetic energy (MeV)
+        amrex::Real kin_energy = 0.0;  // Beam kinetic energy (MeV)
         pp_dist.get("kin_energy", kin_energy);
 
-        amrex::ParticleReal bunch_charge = 0.0;  // Bunch charge (C)
+        amrex::Real bunch_charge = 0.0;  // Bunch charge (C)
         pp_dist.get("charge", bunch_charge);
 
         std::string particle_type;  // Particle type
         pp_dist.get("particle", particle_type);
 
-        amrex::ParticleReal qe;     // charge (elementary charge)
-        amrex::ParticleReal massE;  // MeV/c^2
+        amrex::Real qe;     // charge (elementary charge)
+        amrex::Real massE;  // MeV/c^2
         if (particle_type == "electron") {
             qe = -1.0;
             massE = ablastr::constant::SI::m_e / ablastr::constant::SI::MeV_invc2;
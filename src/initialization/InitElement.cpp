@@ -17,6 +17,7 @@
 #include <AMReX_Print.H>
 
 #include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,25 @@ namespace detail
         }
         return exist;
     }
+
+    /** Query a math expression, which might be split in several words
+     *
+     * @param[inout] pp the parameter parser on the element to query
+     * @param[in] name key name
+     * @param[inout] expr expression with the default value
+     * @return indicates if key existed previously
+     */
+    int queryAddExpression (amrex::ParmParse& pp, const char* name, std::string& expr) {
+        std::vector<std::string> words;
+        int const exist = pp.queryarr(name, words);
+        if (exist) {
+            expr.clear();
+            for (auto const & word : words) { expr += word + " "; }
+        } else {
+            pp.add(name, expr);
+        }
+        return exist;
+    }
 } // namespace detail
 
     /** Read a lattice element
@@ -142,8 +162,8 @@ namespace detail
             int nslice = nslice_default;
             int mapsteps = mapsteps_default;
             RF_field_data const ez;
-            std::vector<amrex::ParticleReal> cos_coef = ez.default_cos_coef;
-            std::vector<amrex::ParticleReal> sin_coef = ez.default_sin_coef;
+            std::vector<amrex::Real> cos_coef = ez.default_cos_coef;
+            std::vector<amrex::Real> sin_coef = ez.default_sin_coef;
             pp_element.get("ds", ds);
             pp_element.get("escale", escale);
             pp_element.get("freq", freq);
@@ -161,7 +181,7 @@ namespace detail
             pp_element.queryAdd("nslice", nslice);
             m_lattice.emplace_back( Sol(ds, ks, nslice) );
         } else if (element_type == "prot") {
-            amrex::ParticleReal phi_in, phi_out;
+            amrex::Real phi_in, phi_out;
             pp_element.get("phi_in", phi_in);
             pp_element.get("phi_out", phi_out);
             m_lattice.emplace_back( PRot(phi_in, phi_out) );
@@ -170,8 +190,8 @@ namespace detail
             int nslice = nslice_default;
             int mapsteps = mapsteps_default;
             Sol_field_data const bz;
-            std::vector<amrex::ParticleReal> cos_coef = bz.default_cos_coef;
-            std::vector<amrex::ParticleReal> sin_coef = bz.default_sin_coef;
+            std::vector<amrex::Real> cos_coef = bz.default_cos_coef;
+            std::vector<amrex::Real> sin_coef = bz.default_sin_coef;
             pp_element.get("ds", ds);
             pp_element.get("bscale", bscale);
             pp_element.queryAdd("mapsteps", mapsteps);
@@ -184,8 +204,8 @@ namespace detail
             int nslice = nslice_default;
             int mapsteps = mapsteps_default;
             Quad_field_data const gz;
-            std::vector<amrex::ParticleReal> cos_coef = gz.default_cos_coef;
-            std::vector<amrex::ParticleReal> sin_coef = gz.default_sin_coef;
+            std::vector<amrex::Real> cos_coef = gz.default_cos_coef;
+            std::vector<amrex::Real> sin_coef = gz.default_sin_coef;
             pp_element.get("ds", ds);
             pp_element.get("gscale", gscale);
             pp_element.queryAdd("mapsteps", mapsteps);
@@ -260,6 +280,22 @@ namespace detail
                                         Aperture::Shape::rectangular :
                                         Aperture::Shape::elliptical;
             m_lattice.emplace_back( Aperture(xmax, ymax, shape) );
+        } else if (element_type == "parser_map") {
+            std::string x_expr = "x", y_expr = "y", t_expr = "t";
+            std::string px_expr = "px", py_expr = "py", pt_expr = "pt";
+            detail::queryAddExpression(pp_element, "x", x_expr);
+            detail::queryAddExpression(pp_element, "y", y_expr);
+            detail::queryAddExpression(pp_element, "t", t_expr);
+            detail::queryAddExpression(pp_element, "px", px_expr);
+            detail::queryAddExpression(pp_element, "py", py_expr);
+            detail::queryAddExpression(pp_element, "pt", pt_expr);
+            std::vector<std::string> parameter_names;
+            pp_element.queryarr("parameters", parameter_names);
+            std::map<std::string, amrex::Real> parameters;
+            for (auto const & parameter : parameter_names) {
+                pp_element.get(parameter.c_str(), parameters[parameter]);
+            }
+            m_lattice.emplace_back( ParserMap(x_expr, y_expr, t_expr, px_expr, py_expr, pt_expr, parameters) );
         } else if (element_type == "beam_monitor") {
             std::string openpmd_name = element_name;
             pp_element.queryAdd("name", openpmd_name);
@@ -11,14 +11,28 @@
 #include "initialization/InitAmrCore.H"
 #include "particles/ImpactXParticleContainer.H"
 #include "particles/distribution/Waterbag.H"
+#include "particles/spacecharge/SpaceChargeAlgo.H"
 
 #include <ablastr/warn_manager/WarnManager.H>
 
 #include <AMReX.H>
 #include <AMReX_BLProfiler.H>
+#include <AMReX_DistributionMapping.H>
+#include <AMReX_GpuLaunch.H>
+#include <AMReX_Math.H>
+#include <AMReX_MFIter.H>
+#include <AMReX_MultiFab.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_ParallelReduce.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Print.H>
 #include <AMReX_REAL.H>
+#include <AMReX_TagBox.H>
 #include <AMReX_Utility.H>
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -28,17 +42,55 @@ namespace impactx
 {
     /** Tag cells for refinement.  TagBoxArray tags is built on level lev grids.
      *
-     * @todo this function is not (yet) implemented.
+     * A cell is tagged if the charge density on one of its nodes exceeds the
+     * fraction algo.mr_tag_rho_rtol of the maximum charge density on this
+     * level. This uses the charge deposited last, including the charge of
+     * the particles on finer levels.
      */
     void ImpactX::ErrorEst (int lev, amrex::TagBoxArray& tags, amrex::Real time, int ngrow)
     {
-        // todo
-        amrex::ignore_unused(lev, tags, time, ngrow);
+        BL_PROFILE("ImpactX::ErrorEst");
+
+        amrex::ignore_unused(time, ngrow);
+
+        amrex::Real rtol = 0.1;
+        amrex::ParmParse("algo").queryAdd("mr_tag_rho_rtol", rtol);
+        if (rtol <= 0.0 || rtol > 1.0)
+            throw std::runtime_error("algo.mr_tag_rho_rtol must be in (0.0, 1.0]");
+
+        // nothing to refine before the first charge deposition
+        amrex::MultiFab const & rho = m_rho.at(lev);
+        amrex::Real const rho_max = rho.norm0();
+        if (rho_max == 0.0) { return; }
+        amrex::Real const threshold = rtol * rho_max;
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+        for (amrex::MFIter mfi(tags, amrex::TilingIfNotGPU()); mfi.isValid(); ++mfi)
+        {
+            amrex::Box const bx = mfi.tilebox();
+            auto const rho_arr = rho.const_array(mfi);
+            auto const tag_arr = tags.array(mfi);
+
+            amrex::ParallelFor(bx, [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept {
+                // rho is nodal: check the 8 nodes of the cell
+                bool tag = false;
+                for (int kk = k; kk <= k + 1; ++kk) {
+                    for (int jj = j; jj <= j + 1; ++jj) {
+                        for (int ii = i; ii <= i + 1; ++ii) {
+                            tag = tag || amrex::Math::abs(rho_arr(ii, jj, kk)) >= threshold;
+                        }
+                    }
+                }
+                if (tag) { tag_arr(i, j, k) = amrex::TagBox::SET; }
+            });
+        }
     }
 
     /** Make a new level from scratch using provided BoxArray and DistributionMapping.
      *
-     * Only used during initialization.
+     * Used during initialization and for the refined levels of Regrid.
      */
     void ImpactX::MakeNewLevelFromScratch (int lev, amrex::Real time, const amrex::BoxArray& ba,
                                           const amrex::DistributionMapping& dm)
@@ -52,9 +104,8 @@ namespace impactx
         };
 
         // charge (rho) mesh
+        //   ba is given in the index space of level lev
         amrex::BoxArray const& cba = ba;
-        // for MR levels (TODO):
-        //cba.coarsen(refRatio(lev - 1));
 
         // staggering and number of charge components in the field
         auto const rho_nodal_flag = amrex::IntVect::TheNodeVector();
@@ -71,6 +122,8 @@ namespace impactx
         m_rho.emplace(
             lev,
             amrex::MultiFab{amrex::convert(cba, rho_nodal_flag), dm, num_components_rho, num_guards_rho, tag("rho")});
+        //   read by ErrorEst before the first charge deposition
+        m_rho.at(lev).setVal(0.);
 
         // scalar potential
         auto const phi_nodal_flag = rho_nodal_flag;
@@ -79,22 +132,30 @@ namespace impactx
         m_phi.emplace(
             lev,
             amrex::MultiFab{amrex::convert(cba, phi_nodal_flag), dm, num_components_phi, num_guards_phi, tag("phi")});
+        //   initial guess of a warm-started Poisson solve
+        m_phi.at(lev).setVal(0.);
 
         // space charge force
+        //   not stored if the gather calculates it from phi
+        bool store_space_charge_field = true;
+        amrex::ParmParse("algo").queryAdd("store_space_charge_field", store_space_charge_field);
         std::unordered_map<std::string, amrex::MultiFab> f_comp;
-        for (std::string const comp : {"x", "y", "z"})
+        if (store_space_charge_field)
         {
-            std::string const str_tag = "space_charge_field_" + comp;
-            f_comp.emplace(
-                comp,
-                amrex::MultiFab{
-                    amrex::convert(cba, rho_nodal_flag),
-                    dm,
-                    num_components_rho,
-                    num_guards_rho,
-                    tag(str_tag)
-                }
-            );
+            for (std::string const comp : {"x", "y", "z"})
+            {
+                std::string const str_tag = "space_charge_field_" + comp;
+                f_comp.emplace(
+                    comp,
+                    amrex::MultiFab{
+                        amrex::convert(cba, rho_nodal_flag),
+                        dm,
+                        num_components_rho,
+                        num_guards_rho,
+                        tag(str_tag)
+                    }
+                );
+            }
         }
         m_space_charge_field.emplace(lev, std::move(f_comp));
     }
@@ -102,25 +163,25 @@ namespace impactx
     /** Make a new level using provided BoxArray and DistributionMapping and fill
      *  with interpolated coarse level data.
      *
-     * @todo this function is not (yet) implemented.
+     * The fields are only allocated: charge is deposited and the potential is
+     * solved for on all levels, before the fields are used.
      */
     void ImpactX::MakeNewLevelFromCoarse (int lev, amrex::Real time, const amrex::BoxArray& ba,
                                          const amrex::DistributionMapping& dm)
     {
-        // todo
-        amrex::ignore_unused(lev, time, ba, dm);
+        MakeNewLevelFromScratch(lev, time, ba, dm);
     }
 
     /** Remake an existing level using provided BoxArray and DistributionMapping
      *  and fill with existing fine and coarse data.
      *
-     * @todo this function is not (yet) implemented.
+     * As in MakeNewLevelFromCoarse, the fields are only reallocated.
      */
     void ImpactX::RemakeLevel (int lev, amrex::Real time, const amrex::BoxArray& ba,
                               const amrex::DistributionMapping& dm)
     {
-        // todo
-        amrex::ignore_unused(lev, time, ba, dm);
+        ClearLevel(lev);
+        MakeNewLevelFromScratch(lev, time, ba, dm);
     }
 
     /** Delete level data
@@ -132,16 +193,23 @@ namespace impactx
         m_space_charge_field.erase(lev);
     }
 
-    void ImpactX::ResizeMesh ()
+    bool ImpactX::ResizeMesh ()
     {
         BL_PROFILE("ImpactX::ResizeMesh");
 
         // Extract the min and max of the particle positions
         auto const [x_min, y_min, z_min, x_max, y_max, z_max] = m_particle_container->MinAndMaxPositions();
 
+        return ResizeMesh({x_min, y_min, z_min}, {x_max, y_max, z_max});
+    }
+
+    bool ImpactX::ResizeMesh (amrex::RealVect const & beam_min, amrex::RealVect const & beam_max)
+    {
+        ++m_num_mesh_resizes;
+
         // guard for flat beams:
         //   https://github.com/ECP-WarpX/impactx/issues/44
-        if (x_min == x_max || y_min == y_max || z_min == z_max)
+        if (beam_min[0] == beam_max[0] || beam_min[1] == beam_max[1] || beam_min[2] == beam_max[2])
             throw std::runtime_error("Flat beam detected. This is not yet supported: https://github.com/ECP-WarpX/impactx/issues/44");
 
         amrex::ParmParse pp_geometry("geometry");
@@ -156,7 +224,13 @@ namespace impactx
             amrex::Real frac = 3.0;
             pp_geometry.query("prob_relative", frac);
 
-            if (frac < 3.0)
+            // open boundaries need no vacuum padding around the beam
+            std::string poisson_solver = "multigrid";
+            amrex::ParmParse("algo").queryAdd("poisson_solver", poisson_solver);
+            bool const open_boundaries = poisson_solver == "fft" ||
+                spacecharge::get_space_charge_algo() == spacecharge::SpaceChargeAlgo::True_2p5D;
+
+            if (frac < 3.0 && !open_boundaries)
                 ablastr::warn_manager::WMRecordWarning(
                     "ImpactX::ResizeMesh",
                     "Dynamic resizing of the mesh uses a geometry.prob_relative "
@@ -170,14 +244,37 @@ namespace impactx
             if (frac < 1.0)
                 throw std::runtime_error("geometry.prob_relative must be >= 1.0 (the beam size) on the coarsest level");
 
-            amrex::RealVect const beam_min(x_min, y_min, z_min);
-            amrex::RealVect const beam_max(x_max, y_max, z_max);
             amrex::RealVect const beam_width(beam_max - beam_min);
 
             amrex::RealVect const beam_padding = beam_width * (frac - 1.0) / 2.0;
             //                           added to the beam extent --^         ^-- box half above/below the beam
             rb.setLo(beam_min - beam_padding);
             rb.setHi(beam_max + beam_padding);
+
+            // Keep the current mesh as long as it covers the beam and its faces
+            // are within a fraction of the requested mesh width of the requested
+            // faces. This avoids re-binning all particles for small changes of
+            // the beam size.
+            amrex::Real hysteresis = 0.0;
+            pp_geometry.queryAdd("dynamic_size_hysteresis", hysteresis);
+            if (hysteresis < 0.0)
+                throw std::runtime_error("geometry.dynamic_size_hysteresis must be >= 0.0");
+
+            if (hysteresis > 0.0)
+            {
+                amrex::RealBox const & current = Geom(0).ProbDomain();
+                bool keep = true;
+                for (int d = 0; d < AMREX_SPACEDIM; ++d)
+                {
+                    amrex::Real const tolerance = hysteresis * rb.length(d);
+                    keep = keep &&
+                           current.lo(d) <= beam_min[d] && current.hi(d) >= beam_max[d] &&
+                           std::abs(current.lo(d) - rb.lo(d)) <= tolerance &&
+                           std::abs(current.hi(d) - rb.hi(d)) <= tolerance;
+                }
+                if (keep)
+                    return false;
+            }
         }
         else
         {
@@ -191,6 +288,15 @@ namespace impactx
             rb = {prob_lo.data(), prob_hi.data()};
         }
 
+        amrex::RealBox const & current = Geom(0).ProbDomain();
+        bool changed = false;
+        for (int d = 0; d < AMREX_SPACEDIM; ++d)
+            changed = changed || current.lo(d) != rb.lo(d) || current.hi(d) != rb.hi(d);
+        if (!changed)
+            return false;
+
+        ++m_num_mesh_regrids;
+
         // updating geometry.prob_lo/hi for consistency
         amrex::Vector<amrex::Real> const prob_lo = {rb.lo()[0], rb.lo()[1], rb.lo()[2]};
         amrex::Vector<amrex::Real> const prob_hi = {rb.hi()[0], rb.hi()[1], rb.hi()[2]};
@@ -204,5 +310,159 @@ namespace impactx
             g.ProbDomain(rb);
             amrex::AmrMesh::SetGeometry(lev, g);
         }
+
+        return true;
+    }
+
+    bool ImpactX::Regrid ()
+    {
+        BL_PROFILE("ImpactX::Regrid");
+
+        if (max_level == 0) { return false; }
+
+        // grids from the tags of ErrorEst, the coarsest level is kept
+        //   this adds at most one level above the current finest level
+        int new_finest = 0;
+        amrex::Vector<amrex::BoxArray> new_grids(max_level + 1);
+        new_grids[0] = boxArray(0);
+        MakeNewGrids(0, 0.0, new_finest, new_grids);
+
+        int const old_finest = finestLevel();
+        bool changed = new_finest != old_finest;
+        for (int lev = 1; lev <= std::min(new_finest, old_finest); ++lev)
+            changed = changed || new_grids[lev] != boxArray(lev);
+        if (!changed) { return false; }
+
+        // move the beam particles off the levels that change
+        //   lost particles are always kept on the coarsest level
+        int const lev_min = 0, lev_max = 0;
+        m_particle_container->Redistribute(lev_min, lev_max);
+
+        for (int lev = 1; lev <= new_finest; ++lev)
+        {
+            if (lev <= old_finest && new_grids[lev] == boxArray(lev)) { continue; }
+
+            amrex::DistributionMapping const dm = MakeDistributionMap(lev, new_grids[lev]);
+            if (lev <= old_finest) {
+                RemakeLevel(lev, 0.0, new_grids[lev], dm);
+            } else {
+                MakeNewLevelFromCoarse(lev, 0.0, new_grids[lev], dm);
+            }
+            SetBoxArray(lev, new_grids[lev]);
+            SetDistributionMap(lev, dm);
+        }
+        for (int lev = new_finest + 1; lev <= old_finest; ++lev)
+        {
+            ClearLevel(lev);
+            ClearBoxArray(lev);
+            ClearDistributionMap(lev);
+        }
+        SetFinestLevel(new_finest);
+
+        // particle iterators loop over the boxes of the new levels
+        m_particle_container->resizeData();
+        m_particles_lost->resizeData();
+
+        amrex::Print() << " ++++ Regrid: finest level " << new_finest;
+        for (int lev = 1; lev <= new_finest; ++lev) {
+            amrex::Print() << ", level " << lev << ": " << boxArray(lev).numPts() << " cells";
+        }
+        amrex::Print() << "\n";
+
+        return true;
+    }
+
+namespace
+{
+    /** Efficiency of a distribution of costs over MPI ranks
+     *
+     * @param costs cost per box
+     * @param dm distribution mapping of the boxes
+     * @return mean over maximum cost per MPI rank
+     */
+    amrex::Real
+    load_balance_efficiency (amrex::Vector<amrex::Real> const & costs, amrex::DistributionMapping const & dm)
+    {
+        amrex::Vector<amrex::Real> rank_costs(amrex::ParallelDescriptor::NProcs(), 0.0);
+        for (int i = 0; i < int(costs.size()); ++i) {
+            rank_costs[dm[i]] += costs[i];
+        }
+        amrex::Real const max_cost = *std::max_element(rank_costs.begin(), rank_costs.end());
+        amrex::Real const sum_cost = std::accumulate(rank_costs.begin(), rank_costs.end(), amrex::Real(0.0));
+        return max_cost > 0.0 ? sum_cost / rank_costs.size() / max_cost : amrex::Real(1.0);
+    }
+} // namespace
+
+    bool ImpactX::LoadBalance ()
+    {
+        BL_PROFILE("ImpactX::LoadBalance");
+
+        if (amrex::ParallelDescriptor::NProcs() == 1) { return false; }
+
+        amrex::ParmParse pp_algo("algo");
+        std::string strategy = "sfc";
+        pp_algo.queryAdd("load_balance_strategy", strategy);
+        if (strategy != "sfc" && strategy != "knapsack")
+            throw std::runtime_error("algo.load_balance_strategy must be sfc or knapsack");
+        amrex::Real threshold = 1.1;
+        pp_algo.queryAdd("load_balance_threshold", threshold);
+        amrex::Real cell_weight = 0.0;
+        pp_algo.queryAdd("load_balance_cell_weight", cell_weight);
+
+        bool changed = false;
+        for (int lev = 0; lev <= finestLevel(); ++lev)
+        {
+            amrex::BoxArray const & ba = boxArray(lev);
+
+            // cost per box, summed over all MPI ranks
+            amrex::Vector<amrex::Long> const num_particles = m_particle_container->NumberOfParticlesInGrid(lev);
+            amrex::Vector<amrex::Real> costs(ba.size());
+            for (int i = 0; i < int(ba.size()); ++i) {
+                costs[i] = amrex::Real(num_particles[i]) + cell_weight * amrex::Real(ba[i].numPts());
+            }
+
+            amrex::Real proposed_efficiency = 0.0;
+            amrex::DistributionMapping const new_dm = strategy == "knapsack" ?
+                amrex::DistributionMapping::makeKnapSack(costs, proposed_efficiency) :
+                amrex::DistributionMapping::makeSFC(costs, ba, proposed_efficiency);
+
+            // compare both with the same measure
+            amrex::Real const efficiency = load_balance_efficiency(costs, DistributionMap(lev));
+            proposed_efficiency = load_balance_efficiency(costs, new_dm);
+
+            // lost particles cannot be redistributed by position
+            //   they are kept on the coarsest level
+            bool can_keep_lost = lev > 0 || m_particles_lost->CanKeepLocalParticles(new_dm);
+            amrex::ParallelAllReduce::And(can_keep_lost, amrex::ParallelDescriptor::Communicator());
+
+            bool const adopt = proposed_efficiency > threshold * efficiency && can_keep_lost;
+
+            amrex::Print() << " ++++ Load balance level " << lev << ": efficiency "
+                           << efficiency << " -> " << proposed_efficiency
+                           << (adopt ? "" : " (not adopted)") << "\n";
+
+            if (!adopt) { continue; }
+
+            SetDistributionMap(lev, new_dm);
+            changed = true;
+
+            // copy the fields to the new distribution mapping
+            auto const remake = [&new_dm, lev](amrex::MultiFab & mf, std::string tagname) {
+                tagname.append("[l=").append(std::to_string(lev)).append("]");
+                amrex::MultiFab new_mf(mf.boxArray(), new_dm, mf.nComp(), mf.nGrowVect(),
+                                       amrex::MFInfo().SetTag(std::move(tagname)));
+                new_mf.ParallelCopy(mf, 0, 0, mf.nComp(), mf.nGrowVect(), mf.nGrowVect());
+                mf = std::move(new_mf);
+            };
+            remake(m_rho.at(lev), "rho");
+            remake(m_phi.at(lev), "phi");
+            for (auto & [comp, mf] : m_space_charge_field.at(lev)) {
+                remake(mf, "space_charge_field_" + comp);
+            }
+        }
+
+        if (changed) { m_particles_lost->KeepLocalParticles(); }
+
+        return changed;
     }
 } // namespace impactx
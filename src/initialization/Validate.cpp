@@ -13,7 +13,10 @@
 #include <AMReX_BLProfiler.H>
 #include <AMReX_INT.H>
 
+#include <cstddef>
 #include <stdexcept>
+#include <string>
+#include <variant>
 
 
 namespace impactx
@@ -45,5 +48,28 @@ namespace impactx
         // elements
         if (m_lattice.empty())
             throw std::runtime_error("Beamline lattice has zero elements. Not yet initialized?");
+
+        // ensemble members: lattices of the same layout
+        for (std::size_t m = 0; m < m_ensemble_lattices.size(); ++m)
+        {
+            auto const & lattice = m_ensemble_lattices[m];
+            std::string const member = "Ensemble member " + std::to_string(m + 1);
+            if (lattice.size() != m_lattice.size())
+                throw std::runtime_error(member + ": the lattice must have as many elements as the lattice of member 0.");
+
+            auto it = m_lattice.begin();
+            for (auto const & element_variant : lattice)
+            {
+                auto const & ref_variant = *it++;
+                auto const nslice = [](auto const & variant) {
+                    return std::visit([](auto const & element) { return element.nslice(); }, variant);
+                };
+                if (element_variant.index() != ref_variant.index() || nslice(element_variant) != nslice(ref_variant))
+                    throw std::runtime_error(member + ": the lattice must have the same element types and slices as the lattice of member 0.");
+            }
+
+            if (m_particle_container->GetEnsembleRefParticle(int(m + 1)).kin_energy_MeV() == 0.0)
+                throw std::runtime_error(member + ": the reference particle energy is zero. Not yet initialized?");
+        }
     }
 } // namespace impactx
@@ -13,10 +13,15 @@
 
 #include <AMReX.H>
 #include <AMReX_AmrParGDB.H>
+#include <AMReX_BoxArray.H>
+#include <AMReX_GpuLaunch.H>
+#include <AMReX_iMultiFab.H>
+#include <AMReX_MFIter.H>
 #include <AMReX_ParallelDescriptor.H>
 #include <AMReX_ParticleTile.H>
 
 #include <array>
+#include <cstdlib>
 
 
 namespace impactx
@@ -59,12 +64,8 @@ namespace impactx
                     amrex::Real const * const AMREX_RESTRICT xyzmin_ptr = grid_box.lo();
                     std::array<amrex::Real, 3> const xyzmin = {xyzmin_ptr[0], xyzmin_ptr[1], xyzmin_ptr[2]};
 
-                    // mesh-refinement: for when we do not deposit on the same level
-                    // note: would need to communicate the deposited-to boxes afterwards
-                    //int const depos_lev = lev;
-                    // mesh refinement ratio between lev and depos_lev
-                    //auto const rel_ref_ratio = ref_ratio.at(depos_lev) / ref_ratio.at(lev);
-                    amrex::ignore_unused(ref_ratio);
+                    // mesh-refinement: particles deposit on their own level, the
+                    // coarser levels are summed up from the finer levels below
 
                     // in SI [C]
                     amrex::ParticleReal const charge = m_refpart.charge;
@@ -95,5 +96,83 @@ namespace impactx
             amrex::MultiFab & rho_at_level = rho.at(lev);
             rho_at_level.SumBoundary_finish();
         }
+
+        // mesh-refinement: add the charge of the particles on finer levels,
+        // restricted to the nodes of the coarser level
+        //   with full weighting, the adjoint of linear interpolation, which
+        //   keeps the total charge
+        for (int lev = nLevel - 1; lev >= 0; --lev)
+        {
+            amrex::MultiFab const & rho_fine = rho.at(lev + 1);
+            amrex::IntVect const & rel_ref_ratio = ref_ratio.at(lev);
+            amrex::Geometry const & gm_fine = this->Geom(lev + 1);
+            amrex::IntVect const ng_fine = rho_fine.nGrowVect();
+
+            // fine nodes that hold charge, each counted once: valid nodes shared
+            // between boxes in one box, and guard nodes outside of the fine patches,
+            // where particles near the patch edges deposit with their shape
+            amrex::iMultiFab fine_mask(rho_fine.boxArray(), rho_fine.DistributionMap(), 1, ng_fine);
+            int const covered = 0, not_covered = 1, physical_boundary = 1, interior = 1;
+            fine_mask.BuildMask(amrex::convert(gm_fine.Domain(), rho_fine.ixType()), gm_fine.periodicity(),
+                                covered, not_covered, physical_boundary, interior);
+            auto const owner_mask = rho_fine.OwnerMask(gm_fine.periodicity());
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (amrex::MFIter mfi(fine_mask, amrex::TilingIfNotGPU()); mfi.isValid(); ++mfi)
+            {
+                amrex::Box const bx = mfi.tilebox();
+                auto const mask_arr = fine_mask.array(mfi);
+                auto const owner_arr = owner_mask->const_array(mfi);
+                amrex::ParallelFor(bx, [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept {
+                    mask_arr(i, j, k) = owner_arr(i, j, k);
+                });
+            }
+
+            // the coarse nodes of the fine boxes, including the coarse nodes
+            // that the fine guard nodes contribute to
+            amrex::BoxArray coarsened_fine_ba = rho_fine.boxArray();
+            coarsened_fine_ba.coarsen(rel_ref_ratio);
+            amrex::IntVect const ng_coarse = (ng_fine + rel_ref_ratio - 1) / rel_ref_ratio;
+            amrex::MultiFab coarsened_fine(coarsened_fine_ba, rho_fine.DistributionMap(), rho_fine.nComp(), ng_coarse);
+
+            int const rx = rel_ref_ratio[0];
+            int const ry = rel_ref_ratio[1];
+            int const rz = rel_ref_ratio[2];
+            // tent weights of the fine nodes times the fine-to-coarse cell volume ratio
+            amrex::Real const scale = 1.0 / amrex::Real(rx*rx * ry*ry * rz*rz);
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (amrex::MFIter mfi(coarsened_fine, amrex::TilingIfNotGPU()); mfi.isValid(); ++mfi)
+            {
+                amrex::Box const bx = mfi.growntilebox();
+                amrex::Box const fine_box = fine_mask[mfi].box();
+                auto const rho_arr = coarsened_fine.array(mfi);
+                auto const fine_arr = rho_fine.const_array(mfi);
+                auto const mask_arr = fine_mask.const_array(mfi);
+                amrex::ParallelFor(bx, rho_fine.nComp(), [=] AMREX_GPU_DEVICE (int i, int j, int k, int n) noexcept {
+                    amrex::Real sum = 0.0;
+                    for (int c = 1 - rz; c < rz; ++c) {
+                        for (int b = 1 - ry; b < ry; ++b) {
+                            for (int a = 1 - rx; a < rx; ++a) {
+                                amrex::IntVect const fine_node(i*rx + a, j*ry + b, k*rz + c);
+                                if (!fine_box.contains(fine_node) || !mask_arr(fine_node)) { continue; }
+                                amrex::Real const weight = amrex::Real(
+                                    (rx - std::abs(a)) * (ry - std::abs(b)) * (rz - std::abs(c)));
+                                sum += weight * fine_arr(fine_node, n);
+                            }
+                        }
+                    }
+                    rho_arr(i, j, k, n) = sum * scale;
+                });
+            }
+
+            // each fine node contributes through one box only: add all boxes,
+            // including their guard nodes, to the valid nodes of the coarser level
+            amrex::Geometry const & gm = this->Geom(lev);
+            rho.at(lev).ParallelAdd(coarsened_fine, 0, 0, rho_fine.nComp(),
+                                    ng_coarse, amrex::IntVect(0), gm.periodicity());
+        }
     }
 } // namespace impactx
@@ -12,9 +12,14 @@
 #include <AMReX_GpuLaunch.H>
 #include <AMReX_GpuQualifiers.H>
 #include <AMReX_Math.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Particle.H>
 #include <AMReX_ParticleTransformation.H>
 #include <AMReX_RandomEngine.H>
 
+#include <algorithm>
+#include <iterator>
+
 
 namespace impactx
 {
@@ -22,38 +27,51 @@ namespace impactx
     {
         static constexpr int s_index = 0; //!< index of runtime attribute in destination for position s where particle got lost
         amrex::ParticleReal s_lost; //!< position s in meters where particle got lost
+        amrex::ParticleReal const * s_lost_per_particle = nullptr; //!< optional: position s per source particle
 
         using SrcData = ImpactXParticleContainer::ParticleTileType::ConstParticleTileDataType;
         using DstData = ImpactXParticleContainer::ParticleTileType::ParticleTileDataType;
 
         AMREX_GPU_HOST_DEVICE
         void operator() (DstData const &dst, SrcData const &src, int src_ip, int dst_ip) const noexcept {
-            dst.m_aos[dst_ip] = src.m_aos[src_ip];
+            dst.m_idcpu[dst_ip] = src.m_idcpu[src_ip];
 
             for (int j = 0; j < SrcData::NAR; ++j)
                 dst.m_rdata[j][dst_ip] = src.m_rdata[j][src_ip];
             for (int j = 0; j < src.m_num_runtime_real; ++j)
                 dst.m_runtime_rdata[j][dst_ip] = src.m_runtime_rdata[j][src_ip];
 
-            // unused: integer compile-time or runtime attributes
+            // unused: integer compile-time attributes
             //for (int j = 0; j < SrcData::NAI; ++j)
             //    dst.m_idata[j][dst_ip] = src.m_idata[j][src_ip];
-            //for (int j = 0; j < src.m_num_runtime_int; ++j)
-            //    dst.m_runtime_idata[j][dst_ip] = src.m_runtime_idata[j][src_ip];
+
+            // integer runtime attributes, e.g., the ensemble member
+            for (int j = 0; j < src.m_num_runtime_int; ++j)
+                dst.m_runtime_idata[j][dst_ip] = src.m_runtime_idata[j][src_ip];
 
             // flip id to positive in destination
-            dst.id(dst_ip) = amrex::Math::abs(dst.id(dst_ip));
+            amrex::ParticleIDWrapper dst_id{dst.m_idcpu[dst_ip]};
+            amrex::Long const id = dst_id;
+            dst_id = amrex::Math::abs(id);
 
             // remember the current s of the ref particle when lost
-            dst.m_runtime_rdata[s_index][dst_ip] = s_lost;
+            dst.m_runtime_rdata[s_index][dst_ip] = s_lost_per_particle ? s_lost_per_particle[src_ip] : s_lost;
         }
     };
 
-    void collect_lost_particles (ImpactXParticleContainer& source)
+    amrex::Long collect_lost_particles (
+        ImpactXParticleContainer& source,
+        LostPositions const * s_lost_per_tile
+    )
     {
         BL_PROFILE("impactX::collect_lost_particles");
 
         using SrcData = ImpactXParticleContainer::ParticleTileType::ConstParticleTileDataType;
+        using ParticleTileType = ImpactXParticleContainer::ParticleTileType;
+
+        // skip if no particles were marked as lost on this MPI rank since the last collection
+        //   the particle-major push tracks on its own where particles got lost
+        if (s_lost_per_tile == nullptr && !source.HasLostParticles()) { return 0; }
 
         ImpactXParticleContainer& dest = *source.GetLostParticleContainer();
 
@@ -66,13 +84,16 @@ namespace impactx
         dest.resizeData();
 
         // copy all particles marked with a negative ID from source to destination
+        amrex::Long num_moved = 0;
         int const nLevel = source.finestLevel();
         for (int lev = 0; lev <= nLevel; ++lev) {
             // loop over all particle boxes
             using ParIt = ImpactXParticleContainer::iterator;
             auto& plevel = source.GetParticles(lev);
 
-            // TODO: is it safe to add OpenMP parallelism here?
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion()) reduction(+:num_moved)
+#endif
             for (ParIt pti(source, lev); pti.isValid(); ++pti) {
                 auto index = std::make_pair(pti.index(), pti.LocalTileIndex());
                 if (plevel.find(index) == plevel.end()) continue;
@@ -85,12 +106,9 @@ namespace impactx
                 auto const predicate = [] AMREX_GPU_HOST_DEVICE (const SrcData& src, int ip)
                 /* NVCC 11.3.109 chokes in C++17 on this: noexcept */
                 {
-                    return src.id(ip) < 0;
+                    return amrex::ConstParticleIDWrapper{src.m_idcpu[ip]} < 0;
                 };
 
-                auto& ptile_dest = dest.DefineAndReturnParticleTile(
-                        lev, pti.index(), pti.LocalTileIndex());
-
                 // count how many particles we will copy
                 amrex::ReduceOps<amrex::ReduceOpSum> reduce_op;
                 amrex::ReduceData<int> reduce_data(reduce_op);
@@ -104,15 +122,46 @@ namespace impactx
                 }
                 int const np_to_move = amrex::get<0>(reduce_data.value());
                 if (np_to_move == 0) continue;  // no particles to move from source tile
+                num_moved += np_to_move;
+
+                // adding tiles to the destination is not thread-safe
+                //   particles lost on refined levels are kept on the coarsest level,
+                //   which does not change when the mesh is regridded
+                ParticleTileType* ptile_dest_ptr = nullptr;
+#ifdef AMREX_USE_OMP
+#pragma omp critical (impactx_collect_lost_define_tile)
+#endif
+                {
+                    if (lev == 0) {
+                        ptile_dest_ptr = &dest.DefineAndReturnParticleTile(
+                                lev, pti.index(), pti.LocalTileIndex());
+                    } else {
+                        auto const & owned = dest.ParticleDistributionMap(0).ProcessorMap();
+                        auto const it = std::find(owned.begin(), owned.end(), amrex::ParallelDescriptor::MyProc());
+                        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(it != owned.end(),
+                            "collect_lost_particles: this MPI rank owns no box on the coarsest level!");
+                        int const grid = int(std::distance(owned.begin(), it));
+                        ptile_dest_ptr = &dest.DefineAndReturnParticleTile(0, grid, 0);
+                    }
+                }
+                auto& ptile_dest = *ptile_dest_ptr;
 
                 // allocate memory in destination
                 int const dst_index = ptile_dest.numParticles();
                 ptile_dest.resize(dst_index + np_to_move);
 
+                // position s where the particles got lost
+                amrex::ParticleReal const * s_lost_per_particle = nullptr;
+                if (s_lost_per_tile != nullptr) {
+                    auto const & s_lost_tile = s_lost_per_tile->at({lev, pti.index(), pti.LocalTileIndex()});
+                    AMREX_ALWAYS_ASSERT(s_lost_tile.size() == std::size_t(np));
+                    s_lost_per_particle = s_lost_tile.dataPtr();
+                }
+
                 // copy particles
-                //   skipped in loop below: integer compile-time or runtime attributes
+                //   skipped in loop below: integer compile-time attributes
                 AMREX_ALWAYS_ASSERT(SrcData::NAI == 0);
-                AMREX_ALWAYS_ASSERT(ptile_source.NumRuntimeIntComps() == 0);
+                AMREX_ALWAYS_ASSERT(ptile_source.NumRuntimeIntComps() == ptile_dest.NumRuntimeIntComps());
 
                 //   first runtime attribute in destination is s position where particle got lost
                 AMREX_ALWAYS_ASSERT(dest.NumRuntimeRealComps() > 0);
@@ -121,7 +170,7 @@ namespace impactx
                     ptile_dest,
                     ptile_source,
                     predicate,
-                    CopyAndMarkNegative{s_lost},
+                    CopyAndMarkNegative{s_lost, s_lost_per_particle},
                     0,
                     dst_index
                 );
@@ -132,7 +181,7 @@ namespace impactx
                     auto ptile_src_data = ptile_source.getParticleTileData();
                     for (int ip = 0; ip < np; ++ip)
                     {
-                        if (ptile_source.id(ip) < 0)
+                        if (amrex::ConstParticleIDWrapper{ptile_src_data.m_idcpu[ip]} < 0)
                             n_removed++;
                         else
                         {
@@ -141,18 +190,18 @@ namespace impactx
                                 // move down
                                 int const new_index = ip - n_removed;
 
-                                ptile_src_data.m_aos[new_index] = ptile_src_data.m_aos[ip];
+                                ptile_src_data.m_idcpu[new_index] = ptile_src_data.m_idcpu[ip];
 
                                 for (int j = 0; j < SrcData::NAR; ++j)
                                     ptile_src_data.m_rdata[j][new_index] = ptile_src_data.m_rdata[j][ip];
                                 for (int j = 0; j < ptile_src_data.m_num_runtime_real; ++j)
                                     ptile_src_data.m_runtime_rdata[j][new_index] = ptile_src_data.m_runtime_rdata[j][ip];
 
-                                // unused: integer compile-time or runtime attributes
+                                // unused: integer compile-time attributes
                                 //for (int j = 0; j < SrcData::NAI; ++j)
                                 //    dst.m_idata[j][new_index] = src.m_idata[j][ip];
-                                //for (int j = 0; j < ptile_src_data.m_num_runtime_int; ++j)
-                                //    dst.m_runtime_idata[j][new_index] = src.m_runtime_idata[j][ip];
+                                for (int j = 0; j < ptile_src_data.m_num_runtime_int; ++j)
+                                    ptile_src_data.m_runtime_idata[j][new_index] = ptile_src_data.m_runtime_idata[j][ip];
                             }
                         }
                     }
@@ -162,5 +211,9 @@ namespace impactx
 
             } // particle tile loop
         } // lev
+
+        source.ResetLostParticles();
+
+        return num_moved;
     }
 } // namespace impactx
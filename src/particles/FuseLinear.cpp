@@ -0,0 +1,83 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl, Chad Mitchell
+ * License: BSD-3-Clause-LBNL
+ */
+#include "FuseLinear.H"
+
+#include <AMReX_BLProfiler.H>
+#include <AMReX_Print.H>
+
+#include <optional>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+
+namespace impactx
+{
+namespace
+{
+    /** Return the element as a LinearElements, if it is one */
+    std::optional<LinearElements>
+    as_linear (KnownElements const & element_variant)
+    {
+        return std::visit([](auto const & element) -> std::optional<LinearElements>
+        {
+            using T = std::decay_t<decltype(element)>;
+            if constexpr (elements::is_alternative_of<T, LinearElements>::value)
+                return LinearElements{element};
+            else
+                return std::nullopt;
+        }, element_variant);
+    }
+} // namespace
+
+    std::list<KnownElements>
+    fuse_linear_elements (std::list<KnownElements> const & lattice)
+    {
+        BL_PROFILE("impactx::fuse_linear_elements");
+
+        std::list<KnownElements> fused_lattice;
+        std::vector<LinearElements> run;
+        std::vector<KnownElements> run_original;
+        int num_fused = 0;
+        int num_maps = 0;
+
+        auto flush_run = [&]()
+        {
+            if (run.size() > 1u) {
+                num_fused += int(run.size());
+                num_maps++;
+                fused_lattice.emplace_back(FusedLinear(std::move(run)));
+            } else {
+                fused_lattice.insert(fused_lattice.end(), run_original.begin(), run_original.end());
+            }
+            run.clear();
+            run_original.clear();
+        };
+
+        for (auto const & element_variant : lattice)
+        {
+            auto linear = as_linear(element_variant);
+            if (linear) {
+                run.push_back(*linear);
+                run_original.push_back(element_variant);
+            } else {
+                flush_run();
+                fused_lattice.push_back(element_variant);
+            }
+        }
+        flush_run();
+
+        amrex::Print() << " Fused " << num_fused << " linear lattice elements into "
+                       << num_maps << " transfer maps\n";
+
+        return fused_lattice;
+    }
+
+} // namespace impactx
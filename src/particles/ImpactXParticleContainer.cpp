@@ -10,51 +10,72 @@
 #include "ImpactXParticleContainer.H"
 
 #include <ablastr/constant.H>
-#include <ablastr/particles/ParticleMoments.H>
 
 #include <AMReX.H>
+#include <AMReX_Algorithm.H>
 #include <AMReX_AmrCore.H>
 #include <AMReX_AmrParGDB.H>
 #include <AMReX_ParallelDescriptor.H>
+#include <AMReX_ParallelReduce.H>
 #include <AMReX_ParmParse.H>
+#include <AMReX_ParticleReduce.H>
 #include <AMReX_ParticleTile.H>
+#include <AMReX_ParticleTransformation.H>
+#include <AMReX_Reduce.H>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 
 namespace
 {
-    bool do_omp_dynamic ()
+    /** OpenMP dynamic scheduling of the particle tiles of a container
+     *
+     * @param pc the particle container, always an ImpactXParticleContainer
+     * @return the scheduling set by ImpactXParticleContainer::SetDynamicScheduling
+     */
+    template<typename T_Container>
+    bool do_omp_dynamic (T_Container & pc)
     {
-        bool do_dynamic = true;
-        amrex::ParmParse const pp_impactx("impactx");
-        pp_impactx.query("do_dynamic_scheduling", do_dynamic);
-        return do_dynamic;
+        return static_cast<impactx::ImpactXParticleContainer const &>(pc).DynamicScheduling();
     }
 }
 
 namespace impactx
 {
     ParIter::ParIter (ContainerType& pc, int level)
-        : amrex::ParIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>(pc, level,
-                   amrex::MFItInfo().SetDynamic(do_omp_dynamic())) {}
+        : amrex::ParIterSoA<RealSoA::nattribs, IntSoA::nattribs>(pc, level,
+                   amrex::MFItInfo().SetDynamic(do_omp_dynamic(pc))) {}
 
     ParIter::ParIter (ContainerType& pc, int level, amrex::MFItInfo& info)
-        : amrex::ParIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>(pc, level,
-              info.SetDynamic(do_omp_dynamic())) {}
+        : amrex::ParIterSoA<RealSoA::nattribs, IntSoA::nattribs>(pc, level,
+              info.SetDynamic(do_omp_dynamic(pc))) {}
 
     ParConstIter::ParConstIter (ContainerType& pc, int level)
-        : amrex::ParConstIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>(pc, level,
-              amrex::MFItInfo().SetDynamic(do_omp_dynamic())) {}
+        : amrex::ParConstIterSoA<RealSoA::nattribs, IntSoA::nattribs>(pc, level,
+              amrex::MFItInfo().SetDynamic(do_omp_dynamic(pc))) {}
 
     ParConstIter::ParConstIter (ContainerType& pc, int level, amrex::MFItInfo& info)
-        : amrex::ParConstIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>(pc, level,
-              info.SetDynamic(do_omp_dynamic())) {}
+        : amrex::ParConstIterSoA<RealSoA::nattribs, IntSoA::nattribs>(pc, level,
+              info.SetDynamic(do_omp_dynamic(pc))) {}
 
     ImpactXParticleContainer::ImpactXParticleContainer (amrex::AmrCore* amr_core)
-        : amrex::ParticleContainer<0, 0, RealSoA::nattribs, IntSoA::nattribs>(amr_core->GetParGDB())
+        : amrex::ParticleContainerPureSoA<RealSoA::nattribs, IntSoA::nattribs>(amr_core->GetParGDB())
     {
         SetParticleSize();
+        SetDynamicScheduling();
+    }
+
+    void
+    ImpactXParticleContainer::SetDynamicScheduling ()
+    {
+        amrex::ParmParse const pp_impactx("impactx");
+        m_do_dynamic_scheduling = true;
+        pp_impactx.query("do_dynamic_scheduling", m_do_dynamic_scheduling);
     }
 
     void
@@ -75,6 +96,88 @@ namespace impactx
         }
     }
 
+    void
+    ImpactXParticleContainer::MayHaveLostParticles (bool counted)
+    {
+        if (counted) {
+            m_lost_counted = true;
+        } else {
+            m_lost_uncounted = true;
+        }
+    }
+
+    bool
+    ImpactXParticleContainer::HasLostParticles () const
+    {
+        if (m_lost_uncounted) { return true; }
+        if (!m_lost_counted) { return false; }
+
+        int num_lost = 0;
+        amrex::Gpu::copyAsync(amrex::Gpu::deviceToHost, m_num_lost.begin(), m_num_lost.end(), &num_lost);
+        amrex::Gpu::streamSynchronize();
+        return num_lost > 0;
+    }
+
+    void
+    ImpactXParticleContainer::ResetLostParticles ()
+    {
+        if (m_lost_counted) {
+            m_num_lost.assign(1, 0);
+        }
+        m_lost_counted = false;
+        m_lost_uncounted = false;
+    }
+
+    bool
+    ImpactXParticleContainer::CanKeepLocalParticles (amrex::DistributionMapping const & dm) const
+    {
+        if (TotalNumberOfParticles(false, true) == 0) { return true; }
+
+        int const myproc = amrex::ParallelDescriptor::MyProc();
+        return std::find(dm.ProcessorMap().begin(), dm.ProcessorMap().end(), myproc) != dm.ProcessorMap().end();
+    }
+
+    void
+    ImpactXParticleContainer::KeepLocalParticles ()
+    {
+        BL_PROFILE("ImpactXParticleContainer::KeepLocalParticles");
+
+        int const myproc = amrex::ParallelDescriptor::MyProc();
+        for (int lev = 0; lev < int(GetParticles().size()); ++lev)
+        {
+            amrex::DistributionMapping const & dm = ParticleDistributionMap(lev);
+            auto & plevel = GetParticles(lev);
+
+            // tiles of boxes this MPI rank does not own anymore
+            std::vector<std::pair<int, int>> moved;
+            for (auto const & [index, ptile] : plevel) {
+                if (dm[index.first] != myproc) { moved.push_back(index); }
+            }
+
+            for (auto const & index : moved)
+            {
+                auto & ptile_src = plevel.at(index);
+                int const np = ptile_src.numParticles();
+                if (np > 0) {
+                    auto const & owned = dm.ProcessorMap();
+                    auto const it = std::find(owned.begin(), owned.end(), myproc);
+                    AMREX_ALWAYS_ASSERT_WITH_MESSAGE(it != owned.end(),
+                        "KeepLocalParticles: this MPI rank holds particles but owns no box!");
+                    int const grid = int(std::distance(owned.begin(), it));
+
+                    auto & ptile_dest = DefineAndReturnParticleTile(lev, grid, 0);
+                    int const dest_np = ptile_dest.numParticles();
+                    ptile_dest.resize(dest_np + np);
+                    amrex::copyParticles(ptile_dest, ptile_src, 0, dest_np, np);
+                }
+                plevel.erase(index);
+            }
+
+            // particle iterators loop over the boxes of the new distribution mapping
+            RedefineDummyMF(lev);
+        }
+    }
+
     void ImpactXParticleContainer::SetParticleShape (int order) {
         if (m_particle_shape.has_value())
         {
@@ -129,33 +232,34 @@ namespace impactx
          * (particle_tile).
          */
         using PinnedTile = amrex::ParticleTile<
-            amrex::Particle<NStructReal, NStructInt>,
-            NArrayReal, NArrayInt,
+            amrex::SoAParticle<RealSoA::nattribs, IntSoA::nattribs>,
+            RealSoA::nattribs, IntSoA::nattribs,
             amrex::PinnedArenaAllocator
         >;
         PinnedTile pinned_tile;
         pinned_tile.define(NumRuntimeRealComps(), NumRuntimeIntComps());
+        pinned_tile.resize(np);
 
+        // write creating cpu id and particle id
+        auto & soa = pinned_tile.GetStructOfArrays();
+        uint64_t * const AMREX_RESTRICT idcpu_arr = soa.GetIdCPUData().dataPtr();
+        int const cpu = amrex::ParallelDescriptor::MyProc();
         for (int i = 0; i < np; i++)
         {
-            ParticleType p;
-            p.id() = ParticleType::NextID();
-            p.cpu() = amrex::ParallelDescriptor::MyProc();
-            p.pos(RealAoS::x) = x[i];
-            p.pos(RealAoS::y) = y[i];
-            p.pos(RealAoS::t) = t[i];
-            // write position, creating cpu id, and particle id
-            pinned_tile.push_back(p);
+            idcpu_arr[i] = amrex::SetParticleIDandCPU(ParticleType::NextID(), cpu);
         }
 
         // write Real attributes (SoA) to particle initialized zero
-        DefineAndReturnParticleTile(0, 0, 0);
-
-        pinned_tile.push_back_real(RealSoA::px, px);
-        pinned_tile.push_back_real(RealSoA::py, py);
-        pinned_tile.push_back_real(RealSoA::pt, pt);
-        pinned_tile.push_back_real(RealSoA::qm, np, qm);
-        pinned_tile.push_back_real(RealSoA::w, np, bchchg/ablastr::constant::SI::q_e/np);
+        std::copy(x.begin(), x.end(), soa.GetRealData(RealSoA::x).begin());
+        std::copy(y.begin(), y.end(), soa.GetRealData(RealSoA::y).begin());
+        std::copy(t.begin(), t.end(), soa.GetRealData(RealSoA::t).begin());
+        std::copy(px.begin(), px.end(), soa.GetRealData(RealSoA::px).begin());
+        std::copy(py.begin(), py.end(), soa.GetRealData(RealSoA::py).begin());
+        std::copy(pt.begin(), pt.end(), soa.GetRealData(RealSoA::pt).begin());
+        auto & qm_arr = soa.GetRealData(RealSoA::qm);
+        std::fill(qm_arr.begin(), qm_arr.end(), qm);
+        auto & w_arr = soa.GetRealData(RealSoA::w);
+        std::fill(w_arr.begin(), w_arr.end(), bchchg/ablastr::constant::SI::q_e/np);
 
         /* Redistributes particles to their respective tiles (spatial bucket
          * sort per box over MPI ranks)
@@ -165,6 +269,63 @@ namespace impactx
         particle_tile.resize(new_np);
         amrex::copyParticles(
                 particle_tile, pinned_tile, 0, old_np, pinned_tile.numParticles());
+        SetEnsembleMember(particle_tile, old_np, np, 0);
+    }
+
+    void
+    ImpactXParticleContainer::AddNParticles (int lev,
+                                             amrex::ParticleReal const * x,
+                                             amrex::ParticleReal const * y,
+                                             amrex::ParticleReal const * t,
+                                             amrex::ParticleReal const * px,
+                                             amrex::ParticleReal const * py,
+                                             amrex::ParticleReal const * pt,
+                                             int np,
+                                             amrex::ParticleReal qm,
+                                             amrex::ParticleReal bchchg)
+    {
+        BL_PROFILE("ImpactX::AddNParticles");
+
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(lev == 0, "AddNParticles: only lev=0 is supported yet.");
+        AMREX_ALWAYS_ASSERT(np >= 0);
+        if (np == 0) { return; }
+
+        auto& particle_tile = DefineAndReturnParticleTile(0, 0, 0);
+        int const old_np = particle_tile.numParticles();
+        particle_tile.resize(old_np + np);
+
+        // reserve a contiguous range of particle ids
+        amrex::Long const first_id = ParticleType::NextID();
+        ParticleType::NextID(first_id + np);
+        int const cpu = amrex::ParallelDescriptor::MyProc();
+
+        auto & soa = particle_tile.GetStructOfArrays();
+        amrex::ParticleReal * const AMREX_RESTRICT part_x = soa.GetRealData(RealSoA::x).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_y = soa.GetRealData(RealSoA::y).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_t = soa.GetRealData(RealSoA::t).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_px = soa.GetRealData(RealSoA::px).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_py = soa.GetRealData(RealSoA::py).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_pt = soa.GetRealData(RealSoA::pt).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_qm = soa.GetRealData(RealSoA::qm).dataPtr() + old_np;
+        amrex::ParticleReal * const AMREX_RESTRICT part_w = soa.GetRealData(RealSoA::w).dataPtr() + old_np;
+        uint64_t * const AMREX_RESTRICT part_idcpu = soa.GetIdCPUData().dataPtr() + old_np;
+
+        amrex::ParticleReal const w = bchchg / ablastr::constant::SI::q_e / np;
+
+        amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (int i) noexcept
+        {
+            part_x[i] = x[i];
+            part_y[i] = y[i];
+            part_t[i] = t[i];
+            part_px[i] = px[i];
+            part_py[i] = py[i];
+            part_pt[i] = pt[i];
+            part_qm[i] = qm;
+            part_w[i] = w;
+            part_idcpu[i] = amrex::SetParticleIDandCPU(first_id + i, cpu);
+        });
+        SetEnsembleMember(particle_tile, old_np, np, 0);
+        amrex::Gpu::streamSynchronize();
     }
 
     void
@@ -189,6 +350,77 @@ namespace impactx
     ImpactXParticleContainer::SetRefParticleEdge ()
     {
         m_refpart.sedge = m_refpart.s;
+        for (auto & refpart : m_ensemble_refparts) {
+            refpart.sedge = refpart.s;
+        }
+    }
+
+    int
+    ImpactXParticleContainer::AddEnsembleMember (RefPart const & refpart)
+    {
+        BL_PROFILE("ImpactXParticleContainer::AddEnsembleMember");
+
+        if (m_particles_lost == nullptr)
+            throw std::runtime_error("AddEnsembleMember: grids are not yet initialized.");
+
+        // tag the existing particles as member 0
+        //   the lost particles get the same component, so they can be copied there
+        if (EnsembleSize() == 1) {
+            for (ImpactXParticleContainer * pc : {this, m_particles_lost}) {
+                AMREX_ALWAYS_ASSERT(pc->NumRuntimeIntComps() == 0);
+                bool const comm = true;
+                pc->AddIntComp(comm);
+
+                for (int lev = 0; lev <= pc->finestLevel(); ++lev) {
+                    for (auto & [index, tile] : pc->GetParticles(lev)) {
+                        pc->SetEnsembleMember(tile, 0, tile.numParticles(), 0);
+                    }
+                }
+            }
+            amrex::Gpu::streamSynchronize();
+        }
+
+        m_ensemble_refparts.push_back(refpart);
+        m_ensemble_moments_shift.emplace_back();
+        return EnsembleSize() - 1;
+    }
+
+    RefPart &
+    ImpactXParticleContainer::GetEnsembleRefParticle (int member)
+    {
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(member >= 0 && member < EnsembleSize(),
+                                         "GetEnsembleRefParticle: no such ensemble member");
+        return member == 0 ? m_refpart : m_ensemble_refparts[member - 1];
+    }
+
+    RefPart const &
+    ImpactXParticleContainer::GetEnsembleRefParticle (int member) const
+    {
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(member >= 0 && member < EnsembleSize(),
+                                         "GetEnsembleRefParticle: no such ensemble member");
+        return member == 0 ? m_refpart : m_ensemble_refparts[member - 1];
+    }
+
+    std::array<amrex::Real, 6> &
+    ImpactXParticleContainer::EnsembleMomentsShift (int member) const
+    {
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(member >= 0 && member < EnsembleSize(),
+                                         "EnsembleMomentsShift: no such ensemble member");
+        return member == 0 ? m_moments_shift : m_ensemble_moments_shift[member - 1];
+    }
+
+    void
+    ImpactXParticleContainer::SetEnsembleMember (ParticleTileType & tile, int begin, int np, int member)
+    {
+        if (NumRuntimeIntComps() == 0 || np == 0) { return; }
+
+        int * const AMREX_RESTRICT part_member =
+            tile.GetStructOfArrays().GetIntData(EnsembleMemberComp).dataPtr() + begin;
+
+        amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (int i) noexcept
+        {
+            part_member[i] = member;
+        });
     }
 
     std::tuple<
@@ -198,25 +430,159 @@ namespace impactx
     ImpactXParticleContainer::MinAndMaxPositions ()
     {
         BL_PROFILE("ImpactXParticleContainer::MinAndMaxPositions");
-        return ablastr::particles::MinAndMaxPositions(*this);
+
+        using PType = typename ImpactXParticleContainer::SuperParticleType;
+
+        amrex::ReduceOps<
+            amrex::ReduceOpMin, amrex::ReduceOpMin, amrex::ReduceOpMin,
+            amrex::ReduceOpMax, amrex::ReduceOpMax, amrex::ReduceOpMax
+        > reduce_ops;
+        auto r = amrex::ParticleReduce<
+            amrex::ReduceData<
+                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
+                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal>
+        >(
+            *this,
+            [=] AMREX_GPU_DEVICE(const PType& p) noexcept
+            {
+                amrex::ParticleReal const x = p.rdata(RealSoA::x);
+                amrex::ParticleReal const y = p.rdata(RealSoA::y);
+                amrex::ParticleReal const z = p.rdata(RealSoA::z);
+
+                return amrex::makeTuple(x, y, z, x, y, z);
+            },
+            reduce_ops
+        );
+
+        std::vector<amrex::ParticleReal> xyz_min = {
+            amrex::get<0>(r),
+            amrex::get<1>(r),
+            amrex::get<2>(r)
+        };
+
+        std::vector<amrex::ParticleReal> xyz_max = {
+            amrex::get<3>(r),
+            amrex::get<4>(r),
+            amrex::get<5>(r)
+        };
+
+        amrex::ParallelAllReduce::Min<amrex::ParticleReal>(
+            xyz_min.data(), xyz_min.size(), amrex::ParallelDescriptor::Communicator());
+        amrex::ParallelAllReduce::Max<amrex::ParticleReal>(
+            xyz_max.data(), xyz_max.size(), amrex::ParallelDescriptor::Communicator());
+
+        return {xyz_min[0], xyz_min[1], xyz_min[2],
+                xyz_max[0], xyz_max[1], xyz_max[2]};
+    }
+
+    amrex::Real
+    ImpactXParticleContainer::MaxCellsOutsideGrid () const
+    {
+        BL_PROFILE("ImpactXParticleContainer::MaxCellsOutsideGrid");
+
+        amrex::ReduceOps<amrex::ReduceOpMax> reduce_ops;
+        amrex::ReduceData<amrex::Real> reduce_data(reduce_ops);
+        using ReduceTuple = typename decltype(reduce_data)::Type;
+
+        for (int lev = 0; lev <= finestLevel(); ++lev) {
+            auto const plo = Geom(lev).ProbLoArray();
+            auto const dxi = Geom(lev).InvCellSizeArray();
+            amrex::BoxArray const & ba = ParticleBoxArray(lev);
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (const_iterator pti(*this, lev); pti.isValid(); ++pti) {
+                int const np = pti.numParticles();
+
+                // cells of the grid box of this tile
+                amrex::Box const box = ba[pti.index()];
+                amrex::IntVect const lo = box.smallEnd();
+                amrex::IntVect const hi = box.bigEnd();
+
+                auto const & soa_real = pti.GetStructOfArrays().GetRealData();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_z = soa_real[RealSoA::z].dataPtr();
+
+                reduce_ops.eval(np, reduce_data, [=] AMREX_GPU_DEVICE (int i) -> ReduceTuple
+                {
+                    amrex::Real const pos[3] = {part_x[i], part_y[i], part_z[i]};
+
+                    amrex::Real outside = 0.0;
+                    for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                        amrex::Real const cell = std::floor((pos[d] - plo[d]) * dxi[d]);
+                        outside = amrex::max(outside, amrex::Real(lo[d]) - cell, cell - amrex::Real(hi[d]));
+                    }
+                    return {outside};
+                });
+            }
+        }
+
+        amrex::Real num_cells = amrex::get<0>(reduce_data.value(reduce_ops));
+        amrex::ParallelAllReduce::Max<amrex::Real>(num_cells, amrex::ParallelDescriptor::Communicator());
+        return num_cells;
     }
 
     std::tuple<
-            amrex::ParticleReal, amrex::ParticleReal,
-            amrex::ParticleReal, amrex::ParticleReal,
-            amrex::ParticleReal, amrex::ParticleReal>
+            amrex::Real, amrex::Real,
+            amrex::Real, amrex::Real,
+            amrex::Real, amrex::Real>
     ImpactXParticleContainer::MeanAndStdPositions ()
     {
+        using namespace amrex::literals; // for _rt
+
         BL_PROFILE("ImpactXParticleContainer::MeanAndStdPositions");
-        return ablastr::particles::MeanAndStdPositions<
-            ImpactXParticleContainer, RealSoA::w
-        >(*this);
-    }
 
-    std::vector<std::string>
-    ImpactXParticleContainer::RealAoS_names () const
-    {
-        return get_RealAoS_names();
+        using PType = typename ImpactXParticleContainer::SuperParticleType;
+
+        amrex::ReduceOps<
+            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
+            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
+            amrex::ReduceOpSum
+        > reduce_ops;
+        auto r = amrex::ParticleReduce<
+            amrex::ReduceData<
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real>
+        >(
+            *this,
+            [=] AMREX_GPU_DEVICE(const PType& p) noexcept
+            {
+                // accumulate in Real, which can be more precise than ParticleReal
+                amrex::Real const x = p.rdata(RealSoA::x);
+                amrex::Real const y = p.rdata(RealSoA::y);
+                amrex::Real const z = p.rdata(RealSoA::z);
+                amrex::Real const w = p.rdata(RealSoA::w);
+
+                return amrex::makeTuple(x * w, x * x * w,
+                                        y * w, y * y * w,
+                                        z * w, z * z * w,
+                                        w);
+            },
+            reduce_ops
+        );
+
+        std::vector<amrex::Real> data = {
+            amrex::get<0>(r), amrex::get<1>(r),
+            amrex::get<2>(r), amrex::get<3>(r),
+            amrex::get<4>(r), amrex::get<5>(r),
+            amrex::get<6>(r)
+        };
+
+        amrex::ParallelAllReduce::Sum<amrex::Real>(
+            data.data(), data.size(), amrex::ParallelDescriptor::Communicator());
+
+        amrex::Real const w_sum = data[6];
+        amrex::Real const x_mean = data[0] / w_sum;
+        amrex::Real const x_std = std::sqrt(std::max(data[1] / w_sum - x_mean * x_mean, 0.0_rt));
+        amrex::Real const y_mean = data[2] / w_sum;
+        amrex::Real const y_std = std::sqrt(std::max(data[3] / w_sum - y_mean * y_mean, 0.0_rt));
+        amrex::Real const z_mean = data[4] / w_sum;
+        amrex::Real const z_std = std::sqrt(std::max(data[5] / w_sum - z_mean * z_mean, 0.0_rt));
+
+        return {x_mean, x_std, y_mean, y_std, z_mean, z_std};
     }
 
     std::vector<std::string>
@@ -225,17 +591,6 @@ namespace impactx
         return get_RealSoA_names(this->NumRealComps());
     }
 
-    std::vector<std::string>
-    get_RealAoS_names ()
-    {
-        std::vector<std::string> real_aos_names(RealAoS::names_s.size());
-
-        // compile-time attributes
-        std::copy(RealAoS::names_s.begin(), RealAoS::names_s.end(), real_aos_names.begin());
-
-        return real_aos_names;
-    }
-
     std::vector<std::string>
     get_RealSoA_names (int num_real_comps)
     {
@@ -0,0 +1,115 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl
+ * License: BSD-3-Clause-LBNL
+ */
+#include "RefPartCache.H"
+
+#include <cmath>
+#include <limits>
+
+
+namespace impactx
+{
+namespace
+{
+    /** Compare two values of the reference particle state
+     *
+     * @param a first value
+     * @param b second value
+     * @return true if both agree to a few hundred machine epsilon
+     */
+    bool
+    is_close (amrex::Real a, amrex::Real b)
+    {
+        using namespace amrex::literals; // for _rt and _prt
+
+        constexpr amrex::Real rtol = 512 * std::numeric_limits<amrex::Real>::epsilon();
+        return std::abs(a - b) <= rtol * (1.0_rt + std::abs(a));
+    }
+
+    /** Compare the reference particle state that determines the push through a slice
+     *
+     * @param a first reference particle
+     * @param b second reference particle
+     * @return true if the push of both through the same slice is the same
+     */
+    bool
+    is_same_state (RefPart const & a, RefPart const & b)
+    {
+        if (a.mass != b.mass || a.charge != b.charge) { return false; }
+
+        if (!is_close(a.px, b.px) || !is_close(a.py, b.py) ||
+            !is_close(a.pz, b.pz) || !is_close(a.pt, b.pt)) { return false; }
+
+        if (!is_close(a.s - a.sedge, b.s - b.sedge)) { return false; }
+
+        for (int i=1; i<7; i++) {
+            for (int j=1; j<7; j++) {
+                if (!is_close(a.map(i, j), b.map(i, j))) { return false; }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+    void
+    RefPartCache::enable (bool enable)
+    {
+        m_enabled = enable;
+        m_next = 0;
+        m_records.clear();
+    }
+
+    void
+    RefPartCache::start_period ()
+    {
+        m_next = 0;
+    }
+
+    bool
+    RefPartCache::replay (RefPart & ref_part, void const * element)
+    {
+        if (m_next >= m_records.size()) { return false; }
+
+        Record const & rec = m_records[m_next];
+        if (rec.element != element || !is_same_state(ref_part, rec.in)) { return false; }
+
+        // advance by the recorded differences
+        ref_part.s += rec.out.s - rec.in.s;
+        ref_part.x += rec.out.x - rec.in.x;
+        ref_part.y += rec.out.y - rec.in.y;
+        ref_part.z += rec.out.z - rec.in.z;
+        ref_part.t += rec.out.t - rec.in.t;
+
+        // momenta and linear map as recorded
+        ref_part.px = rec.out.px;
+        ref_part.py = rec.out.py;
+        ref_part.pz = rec.out.pz;
+        ref_part.pt = rec.out.pt;
+        ref_part.map = rec.out.map;
+
+        m_next++;
+        m_num_hits++;
+        return true;
+    }
+
+    void
+    RefPartCache::record (RefPart const & in, RefPart const & out, void const * element)
+    {
+        Record const rec{element, in, out};
+        if (m_next < m_records.size()) {
+            m_records[m_next] = rec;
+        } else {
+            m_records.push_back(rec);
+        }
+
+        m_next++;
+        m_num_misses++;
+    }
+
+} // namespace impactx
@@ -0,0 +1,341 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl, Chad Mitchell
+ * License: BSD-3-Clause-LBNL
+ */
+#include "TrackParticleMajor.H"
+#include "CollectLost.H"
+#include "Push.H"
+
+#include <AMReX_BLProfiler.H>
+#include <AMReX_Extension.H>
+#include <AMReX_GpuContainers.H>
+#include <AMReX_Particle.H>
+#include <AMReX_REAL.H>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+
+namespace impactx
+{
+namespace
+{
+    /** Maximum number of recorded slice steps per kernel launch
+     *
+     * This bounds the device memory for reference particle states to a few ten MB.
+     */
+    constexpr int max_steps_per_launch = 65536;
+
+    /** Push a single particle through a device element
+     *
+     * We cannot std::visit on the device, thus we unroll the alternatives at compile time.
+     */
+    template<std::size_t I = 0>
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    void
+    push_element (
+        DeviceElements const & element_variant,
+        amrex::ParticleReal & AMREX_RESTRICT x,
+        amrex::ParticleReal & AMREX_RESTRICT y,
+        amrex::ParticleReal & AMREX_RESTRICT t,
+        amrex::ParticleReal & AMREX_RESTRICT px,
+        amrex::ParticleReal & AMREX_RESTRICT py,
+        amrex::ParticleReal & AMREX_RESTRICT pt,
+        uint64_t & AMREX_RESTRICT idcpu,
+        RefPart const & refpart
+    )
+    {
+        if constexpr (I < std::variant_size_v<DeviceElements>) {
+            if (element_variant.index() == I) {
+                (*std::get_if<I>(&element_variant))(x, y, t, px, py, pt, idcpu, refpart);
+            } else {
+                push_element<I + 1>(element_variant, x, y, t, px, py, pt, idcpu, refpart);
+            }
+        }
+    }
+
+    /** Return the element as a DeviceElements, if it is one */
+    std::optional<DeviceElements>
+    as_device_element (KnownElements const & element_variant)
+    {
+        return std::visit([](auto const & element) -> std::optional<DeviceElements>
+        {
+            using T = std::decay_t<decltype(element)>;
+            if constexpr (elements::is_alternative_of<T, DeviceElements>::value)
+                return DeviceElements{element};
+            else
+                return std::nullopt;
+        }, element_variant);
+    }
+
+    /** Push all particles through the recorded slice steps
+     *
+     * @param[in,out] pc container of the particles to push
+     * @param[in] elements device copy of the lattice elements, by ensemble member, then element
+     * @param[in] step_element per slice step: index into the elements of a member
+     * @param[in] step_ref per slice step, then ensemble member: reference particle after its push
+     * @param[in,out] s_lost per particle: position s where it got lost
+     */
+    void
+    push_steps (
+        ImpactXParticleContainer & pc,
+        amrex::Gpu::DeviceVector<DeviceElements> const & elements,
+        amrex::Gpu::DeviceVector<int> const & step_element,
+        amrex::Gpu::DeviceVector<RefPart> const & step_ref,
+        LostPositions & s_lost
+    )
+    {
+        BL_PROFILE("impactx::track_particle_major::push_steps");
+
+        int const nsteps = int(step_element.size());
+        int const num_members = pc.EnsembleSize();
+        int const num_elements = int(elements.size()) / num_members;
+        DeviceElements const * const AMREX_RESTRICT elements_ptr = elements.dataPtr();
+        int const * const AMREX_RESTRICT step_element_ptr = step_element.dataPtr();
+        RefPart const * const AMREX_RESTRICT step_ref_ptr = step_ref.dataPtr();
+
+        // loop over refinement levels
+        int const nLevel = pc.finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev)
+        {
+            // allocate the lost positions once per tile, before threading over tiles
+            using ParIt = ImpactXParticleContainer::iterator;
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                auto const key = std::make_tuple(lev, pti.index(), pti.LocalTileIndex());
+                if (s_lost.count(key) == 0u) {
+                    s_lost.emplace(key, amrex::Gpu::DeviceVector<amrex::ParticleReal>(pti.numParticles(), 0.0));
+                }
+            }
+
+            // loop over all particle boxes
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                const int np = pti.numParticles();
+
+                // preparing access to particle data: SoA of Reals
+                auto& soa = pti.GetStructOfArrays();
+                amrex::ParticleReal* const AMREX_RESTRICT part_x = soa.GetRealData(RealSoA::x).dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_y = soa.GetRealData(RealSoA::y).dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_t = soa.GetRealData(RealSoA::t).dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_px = soa.GetRealData(RealSoA::px).dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_py = soa.GetRealData(RealSoA::py).dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_pt = soa.GetRealData(RealSoA::pt).dataPtr();
+
+                // preparing access to particle data: id and cpu
+                uint64_t* const AMREX_RESTRICT part_idcpu = soa.GetIdCPUData().dataPtr();
+
+                amrex::ParticleReal* const AMREX_RESTRICT part_s_lost =
+                    s_lost.at(std::make_tuple(lev, pti.index(), pti.LocalTileIndex())).dataPtr();
+
+                // preparing access to particle data: ensemble member
+                int const * const AMREX_RESTRICT part_member = num_members > 1 ?
+                    soa.GetIntData(ImpactXParticleContainer::EnsembleMemberComp).dataPtr() : nullptr;
+
+                amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (long i)
+                {
+                    uint64_t idcpu = part_idcpu[i];
+
+                    // lost in a previous launch
+                    if (amrex::ConstParticleIDWrapper{idcpu} < 0) { return; }
+
+                    amrex::ParticleReal x = part_x[i];
+                    amrex::ParticleReal y = part_y[i];
+                    amrex::ParticleReal t = part_t[i];
+                    amrex::ParticleReal px = part_px[i];
+                    amrex::ParticleReal py = part_py[i];
+                    amrex::ParticleReal pt = part_pt[i];
+
+                    // lattice and reference particle of the ensemble member
+                    int const m = part_member ? part_member[i] : 0;
+                    DeviceElements const * const member_elements = elements_ptr + m * num_elements;
+
+                    for (int s = 0; s < nsteps; ++s) {
+                        RefPart const & refpart = step_ref_ptr[s * num_members + m];
+                        push_element(member_elements[step_element_ptr[s]], x, y, t, px, py, pt, idcpu, refpart);
+
+                        // marked as lost: remember where and stop pushing
+                        if (amrex::ConstParticleIDWrapper{idcpu} < 0) {
+                            part_s_lost[i] = refpart.s;
+                            break;
+                        }
+                    }
+
+                    part_idcpu[i] = idcpu;
+                    part_x[i] = x;
+                    part_y[i] = y;
+                    part_t[i] = t;
+                    part_px[i] = px;
+                    part_py[i] = py;
+                    part_pt[i] = pt;
+                });
+            } // end loop over all particle boxes
+        } // env mesh-refinement level loop
+    }
+} // namespace
+
+    void
+    track_particle_major (
+        ImpactXParticleContainer & pc,
+        std::list<KnownElements> & lattice,
+        int periods,
+        int & global_step
+    )
+    {
+        std::vector<std::list<KnownElements> *> const lattices{&lattice};
+        track_particle_major(pc, lattices, periods, global_step);
+    }
+
+    void
+    track_particle_major (
+        ImpactXParticleContainer & pc,
+        std::vector<std::list<KnownElements> *> const & lattices,
+        int periods,
+        int & global_step
+    )
+    {
+        BL_PROFILE("impactx::track_particle_major");
+
+        int const num_members = pc.EnsembleSize();
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(int(lattices.size()) == num_members,
+                                         "track_particle_major: need one lattice per ensemble member");
+        std::list<KnownElements> & lattice = *lattices[0];
+
+        // device copy of the lattice
+        //   per lattice element: index in the elements of a member, or -1 for elements we push on the host
+        std::vector<DeviceElements> h_elements;
+        std::vector<int> element_index;
+        for (auto const & element_variant : lattice)
+        {
+            auto device_element = as_device_element(element_variant);
+            if (device_element) {
+                element_index.push_back(int(h_elements.size()));
+                h_elements.push_back(*device_element);
+            } else {
+                element_index.push_back(-1);
+            }
+        }
+
+        //   the lattices of the other ensemble members follow, with the same layout
+        for (int m = 1; m < num_members; ++m) {
+            for (auto const & element_variant : *lattices[m]) {
+                auto device_element = as_device_element(element_variant);
+                if (device_element) { h_elements.push_back(*device_element); }
+            }
+        }
+        AMREX_ALWAYS_ASSERT(h_elements.size() % num_members == 0);
+
+        amrex::Gpu::DeviceVector<DeviceElements> elements(h_elements.size());
+        amrex::Gpu::copyAsync(amrex::Gpu::hostToDevice,
+                              h_elements.begin(), h_elements.end(),
+                              elements.begin());
+
+        // recorded slice steps
+        //   the reference particle states of all members are recorded per step
+        int const max_steps = std::max(1, max_steps_per_launch / num_members);
+        std::vector<int> h_step_element;
+        std::vector<RefPart> h_step_ref;
+        h_step_element.reserve(max_steps);
+        h_step_ref.reserve(std::size_t(max_steps) * num_members);
+        amrex::Gpu::DeviceVector<int> step_element;
+        amrex::Gpu::DeviceVector<RefPart> step_ref;
+
+        LostPositions s_lost;
+
+        auto push_recorded_steps = [&]()
+        {
+            if (h_step_element.empty()) { return; }
+
+            step_element.resize(h_step_element.size());
+            step_ref.resize(h_step_ref.size());
+            amrex::Gpu::copyAsync(amrex::Gpu::hostToDevice,
+                                  h_step_element.begin(), h_step_element.end(),
+                                  step_element.begin());
+            amrex::Gpu::copyAsync(amrex::Gpu::hostToDevice,
+                                  h_step_ref.begin(), h_step_ref.end(),
+                                  step_ref.begin());
+            amrex::Gpu::streamSynchronize();
+
+            push_steps(pc, elements, step_element, step_ref, s_lost);
+            amrex::Gpu::streamSynchronize();
+
+            h_step_element.clear();
+            h_step_ref.clear();
+        };
+
+        // move "lost" particles to another particle container
+        //   this changes the particle tiles, so the lost positions are reset
+        auto collect_lost = [&]()
+        {
+            if (s_lost.empty()) { return; }
+
+            collect_lost_particles(pc, &s_lost);
+            s_lost.clear();
+        };
+
+        // push the reference particles through the lattices and record their states
+        std::vector<std::list<KnownElements>::iterator> member_elements(num_members);
+        for (int cycle=0; cycle < periods; ++cycle) {
+            pc.GetRefParticleCache().start_period();
+
+            for (int m = 0; m < num_members; ++m) { member_elements[m] = lattices[m]->begin(); }
+
+            auto it_index = element_index.begin();
+            for (auto & element_variant : lattice) {
+                int const index = *it_index++;
+
+                // update element edge of the reference particles
+                pc.SetRefParticleEdge();
+
+                int const nslice = std::visit([](auto && element) { return element.nslice(); }, element_variant);
+
+                // elements that need the host, e.g., for I/O: push as usual
+                if (index < 0 && !std::holds_alternative<None>(element_variant)) {
+                    AMREX_ALWAYS_ASSERT_WITH_MESSAGE(num_members == 1,
+                        "track_particle_major: ensembles support only elements that run on the device");
+                    push_recorded_steps();
+                    collect_lost();
+
+                    for (int slice_step = 0; slice_step < nslice; ++slice_step) {
+                        global_step++;
+                        Push(pc, element_variant, global_step);
+                        collect_lost_particles(pc);
+                    }
+                    ++member_elements[0];
+                    continue;
+                }
+
+                for (int slice_step = 0; slice_step < nslice; ++slice_step) {
+                    global_step++;
+
+                    for (int m = 0; m < num_members; ++m) {
+                        RefPart & ref_part = pc.GetEnsembleRefParticle(m);
+                        std::visit([&pc, &ref_part](auto && element) {
+                            BL_PROFILE("impactx::Push::RefPart");
+                            pc.GetRefParticleCache().push(ref_part, element);
+                        }, *member_elements[m]);
+
+                        if (index >= 0) { h_step_ref.push_back(ref_part); }
+                    }
+
+                    if (index >= 0) { h_step_element.push_back(index); }
+                    if (int(h_step_element.size()) == max_steps) { push_recorded_steps(); }
+                }
+
+                for (int m = 0; m < num_members; ++m) { ++member_elements[m]; }
+            }
+        }
+        push_recorded_steps();
+        collect_lost();
+    }
+
+} // namespace impactx
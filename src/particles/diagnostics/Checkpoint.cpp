@@ -0,0 +1,525 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl
+ * License: BSD-3-Clause-LBNL
+ */
+#include "Checkpoint.H"
+#include "DiagnosticOutput.H"
+#include "ImpactXVersion.H"
+#include "particles/elements/diagnostics/openPMD.H"
+
+#include <AMReX.H>
+#include <AMReX_BLProfiler.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Particle.H>
+#include <AMReX_ParticleTransformation.H>
+#include <AMReX_Print.H>
+#include <AMReX_REAL.H>
+#include <AMReX_Utility.H>
+
+#ifdef ImpactX_USE_OPENPMD
+#   include <openPMD/openPMD.hpp>
+namespace io = openPMD;
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+namespace impactx::diagnostics
+{
+namespace
+{
+    /** Sizes of the regular files in diags/
+     *
+     * The IO rank lists the directory and broadcasts the result.
+     *
+     * @return one line "<size> <file name>" per file
+     */
+    std::string
+    diag_file_sizes ()
+    {
+        std::ostringstream lines;
+        if (amrex::ParallelDescriptor::IOProcessor()) {
+            std::error_code ec;
+            for (auto const & entry : std::filesystem::directory_iterator("diags", ec)) {
+                if (entry.is_regular_file()) {
+                    lines << entry.file_size() << " " << entry.path().filename().string() << "\n";
+                }
+            }
+        }
+
+        std::string sizes = lines.str();
+        int length = int(sizes.size());
+        amrex::ParallelDescriptor::Bcast(&length, 1, amrex::ParallelDescriptor::IOProcessorNumber());
+        sizes.resize(length);
+        if (length > 0) {
+            amrex::ParallelDescriptor::Bcast(sizes.data(), length, amrex::ParallelDescriptor::IOProcessorNumber());
+        }
+        return sizes;
+    }
+
+#ifdef ImpactX_USE_OPENPMD
+    //! number of values of a serialized reference particle: its attributes and linear map
+    constexpr int refpart_size = 12 + 36;
+
+    /** Append the attributes and the linear map of a reference particle
+     *
+     * @param[in,out] values serialized reference particles
+     * @param[in] ref reference particle
+     */
+    void
+    append_refpart (std::vector<double> & values, RefPart const & ref)
+    {
+        for (amrex::Real const v : {ref.s, ref.x, ref.y, ref.z, ref.t,
+                                    ref.px, ref.py, ref.pz, ref.pt,
+                                    ref.mass, ref.charge, ref.sedge}) {
+            values.push_back(double(v));
+        }
+        for (int i=1; i<7; i++) {
+            for (int j=1; j<7; j++) {
+                values.push_back(double(ref.map(i, j)));
+            }
+        }
+    }
+
+    /** Deserialize a reference particle written by append_refpart
+     *
+     * @param[in] values refpart_size values
+     * @return reference particle
+     */
+    RefPart
+    read_refpart (double const * values)
+    {
+        RefPart ref;
+        for (amrex::Real * v : {&ref.s, &ref.x, &ref.y, &ref.z, &ref.t,
+                                &ref.px, &ref.py, &ref.pz, &ref.pt,
+                                &ref.mass, &ref.charge, &ref.sedge}) {
+            *v = amrex::Real(*values++);
+        }
+        for (int i=1; i<7; i++) {
+            for (int j=1; j<7; j++) {
+                ref.map(i, j) = amrex::Real(*values++);
+            }
+        }
+        return ref;
+    }
+
+    /** Truncate the files in diags/ that grew since diag_file_sizes
+     *
+     * Only the IO rank changes the files.
+     *
+     * @param sizes the result of diag_file_sizes
+     */
+    void
+    truncate_diag_files (std::string const & sizes)
+    {
+        if (!amrex::ParallelDescriptor::IOProcessor()) { return; }
+
+        std::istringstream lines(sizes);
+        std::uintmax_t size = 0;
+        std::string name;
+        while (lines >> size && std::getline(lines >> std::ws, name)) {
+            std::filesystem::path const path = std::filesystem::path("diags") / name;
+            std::error_code ec;
+            std::uintmax_t const current = std::filesystem::file_size(path, ec);
+            if (!ec && current > size) {
+                std::filesystem::resize_file(path, size);
+            }
+        }
+    }
+
+    /** Even share of n items over a number of ranks
+     *
+     * @param n number of items
+     * @param rank index of the rank
+     * @param nranks number of ranks
+     * @return offset and number of the items of this rank
+     */
+    std::pair<uint64_t, uint64_t>
+    even_share (uint64_t n, int rank, int nranks)
+    {
+        uint64_t const navg = n / uint64_t(nranks);
+        uint64_t const nleft = n - navg * uint64_t(nranks);
+        uint64_t const count = (uint64_t(rank) < nleft) ? navg + 1 : navg;
+        uint64_t const offset = uint64_t(rank) * navg + std::min(uint64_t(rank), nleft);
+        return {offset, count};
+    }
+
+    using PinnedContainer = ImpactXParticleContainer::ContainerLike<amrex::PinnedArenaAllocator>;
+    using PinnedTile = amrex::ParticleTile<
+        amrex::SoAParticle<RealSoA::nattribs, IntSoA::nattribs>,
+        RealSoA::nattribs, IntSoA::nattribs,
+        amrex::PinnedArenaAllocator
+    >;
+
+    /** Store all particles of a staged particle container as a species
+     *
+     * The particle components are stored unchanged, the ids including the
+     * MPI rank that created the particle. The staged data must stay valid
+     * until the iteration is flushed.
+     *
+     * @param iteration the iteration to write to
+     * @param name name of the particle species
+     * @param pinned particles staged on the host
+     * @return total number of particles over all MPI ranks
+     */
+    uint64_t
+    store_species (io::Iteration & iteration, std::string const & name, PinnedContainer & pinned)
+    {
+        detail::ImpactXParticleCounter counter(pinned);
+        uint64_t const np = counter.GetTotalNumParticles();
+
+        // Do not create zero-sized data sets
+        if (np == 0) { return np; }
+
+        io::ParticleSpecies species = iteration.particles[name];
+        auto const scalar = io::RecordComponent::SCALAR;
+        std::vector<std::string> const real_soa_names = get_RealSoA_names(pinned.NumRealComps());
+        bool const has_member = pinned.NumRuntimeIntComps() > 0;
+
+        auto const d_fl = io::Dataset(io::determineDatatype<amrex::ParticleReal>(), {np});
+        species["id"][scalar].resetDataset(io::Dataset(io::determineDatatype<uint64_t>(), {np}));
+        for (auto const & component_name : real_soa_names) {
+            species[component_name][scalar].resetDataset(d_fl);
+        }
+        if (has_member) {
+            species["ensemble_member"][scalar].resetDataset(io::Dataset(io::determineDatatype<int>(), {np}));
+        }
+
+        for (int lev = 0; lev <= pinned.finestLevel(); ++lev) {
+            auto offset = static_cast<uint64_t>(counter.m_ParticleOffsetAtRank[lev]);
+
+            for (PinnedContainer::ParIterType pti(pinned, lev); pti.isValid(); ++pti) {
+                auto const np_tile = static_cast<uint64_t>(pti.numParticles());
+                // Do not call storeChunk() with zero-sized particle tiles:
+                //   https://github.com/openPMD/openPMD-api/issues/1147
+                if (np_tile == 0) { continue; }
+
+                auto & soa = pti.GetStructOfArrays();
+                species["id"][scalar].storeChunkRaw(soa.GetIdCPUData().data(), {offset}, {np_tile});
+                for (std::size_t real_idx = 0; real_idx < real_soa_names.size(); ++real_idx) {
+                    species[real_soa_names[real_idx]][scalar].storeChunkRaw(
+                        soa.GetRealData(int(real_idx)).data(), {offset}, {np_tile});
+                }
+                if (has_member) {
+                    species["ensemble_member"][scalar].storeChunkRaw(
+                        soa.GetIntData(ImpactXParticleContainer::EnsembleMemberComp).data(), {offset}, {np_tile});
+                }
+
+                offset += np_tile;
+            }
+        }
+        return np;
+    }
+
+    /** A range of particles of a species, loaded on the next flush */
+    struct LoadedParticles
+    {
+        uint64_t np = 0;  //! number of particles
+        std::shared_ptr<uint64_t> idcpu;  //! particle ids and creating MPI ranks
+        std::vector<std::shared_ptr<amrex::ParticleReal>> reals;  //! SoA Real components
+        std::shared_ptr<int> member;  //! ensemble member, if there is more than one
+    };
+
+    /** Request a range of the particles of a species
+     *
+     * @param iteration the iteration to read from
+     * @param name name of the particle species
+     * @param offset first particle
+     * @param np number of particles
+     * @param pc particle container with the same components
+     * @return particle data, valid after the next flush of the series
+     */
+    LoadedParticles
+    load_species (
+        io::Iteration & iteration,
+        std::string const & name,
+        uint64_t offset,
+        uint64_t np,
+        ImpactXParticleContainer const & pc
+    )
+    {
+        LoadedParticles loaded;
+        loaded.np = np;
+        if (np == 0) { return loaded; }
+
+        io::ParticleSpecies species = iteration.particles[name];
+        auto const scalar = io::RecordComponent::SCALAR;
+        std::vector<std::string> components = get_RealSoA_names(pc.NumRealComps());
+        bool const has_member = pc.NumRuntimeIntComps() > 0;
+        if (has_member) { components.emplace_back("ensemble_member"); }
+        for (auto const & component_name : components) {
+            if (!species.contains(component_name))
+                throw std::runtime_error("ReadCheckpoint: the particle component " + component_name +
+                                         " of " + name + " is missing");
+        }
+
+        loaded.idcpu = species["id"][scalar].loadChunk<uint64_t>({offset}, {np});
+        for (int real_idx = 0; real_idx < pc.NumRealComps(); ++real_idx) {
+            loaded.reals.push_back(
+                species[components[real_idx]][scalar].loadChunk<amrex::ParticleReal>({offset}, {np}));
+        }
+        if (has_member) {
+            loaded.member = species["ensemble_member"][scalar].loadChunk<int>({offset}, {np});
+        }
+        return loaded;
+    }
+
+    /** Add loaded particles to a particle tile
+     *
+     * @param loaded particle data after the flush of the series
+     * @param pc particle container of the tile
+     * @param tile particle tile to append the particles to
+     * @return largest particle id of the loaded particles, or -1
+     */
+    amrex::Long
+    add_to_tile (
+        LoadedParticles const & loaded,
+        ImpactXParticleContainer const & pc,
+        ImpactXParticleContainer::ParticleTileType & tile
+    )
+    {
+        auto const np = static_cast<int>(loaded.np);
+        if (np == 0) { return -1; }
+
+        PinnedTile pinned_tile;
+        pinned_tile.define(pc.NumRuntimeRealComps(), pc.NumRuntimeIntComps());
+        pinned_tile.resize(np);
+
+        auto & soa = pinned_tile.GetStructOfArrays();
+        std::copy(loaded.idcpu.get(), loaded.idcpu.get() + np, soa.GetIdCPUData().begin());
+        for (int real_idx = 0; real_idx < pc.NumRealComps(); ++real_idx) {
+            std::copy(loaded.reals[real_idx].get(), loaded.reals[real_idx].get() + np,
+                      soa.GetRealData(real_idx).begin());
+        }
+        if (loaded.member) {
+            std::copy(loaded.member.get(), loaded.member.get() + np,
+                      soa.GetIntData(ImpactXParticleContainer::EnsembleMemberComp).begin());
+        }
+
+        amrex::Long max_id = -1;
+        for (int i = 0; i < np; ++i) {
+            max_id = std::max(max_id, amrex::Long(amrex::ConstParticleIDWrapper{loaded.idcpu.get()[i]}));
+        }
+
+        int const old_np = tile.numParticles();
+        tile.resize(old_np + np);
+        amrex::copyParticles(tile, pinned_tile, 0, old_np, np);
+        return max_id;
+    }
+#endif
+} // namespace
+
+    std::string
+    WriteCheckpoint (
+        ImpactXParticleContainer & pc,
+        ImpactXParticleContainer & lost,
+        TrackingPosition const & position
+    )
+    {
+        BL_PROFILE("impactx::diagnostics::WriteCheckpoint");
+
+        amrex::ParmParse pp_checkpoint("checkpoint");
+        std::string directory = "checkpoints";
+        pp_checkpoint.queryAdd("directory", directory);
+        std::string backend = "default";
+        pp_checkpoint.queryAdd("backend", backend);
+        int file_min_digits = 6;
+        amrex::ParmParse("diag").queryAdd("file_min_digits", file_min_digits);
+
+        // the diagnostic files are complete up to this step
+        FinishDiagnosticOutput();
+        std::string const diag_sizes = diag_file_sizes();
+
+#ifdef ImpactX_USE_OPENPMD
+        // pick first available backend if default is chosen
+        if (backend == "default")
+#   if openPMD_HAVE_ADIOS2==1
+            backend = "bp";
+#   elif openPMD_HAVE_HDF5==1
+            backend = "h5";
+#   else
+            backend = "json";
+#   endif
+
+        // write under a hidden name first: an interrupted write is not mistaken for a checkpoint
+        std::string const name = amrex::Concatenate("chk", position.global_step, file_min_digits) + "." + backend;
+        std::string const file_name = directory + "/" + name;
+        std::string const partial_file_name = directory + "/." + name;
+
+        // openPMD-api is not thread-safe: complete the beam monitor writes in flight
+        BeamMonitor::wait_all();
+
+        {
+            auto series = io::Series(partial_file_name, io::Access::CREATE
+#   if openPMD_HAVE_MPI==1
+                , amrex::ParallelDescriptor::Communicator()
+#   endif
+            );
+            series.setSoftware("ImpactX", IMPACTX_VERSION);
+            series.setIterationEncoding(io::IterationEncoding::groupBased);
+
+            io::Iteration iteration = series.iterations[position.global_step];
+            iteration.setAttribute("global_step", position.global_step);
+            iteration.setAttribute("period", position.period);
+            iteration.setAttribute("element_index", position.element_index);
+            iteration.setAttribute("slice_step", position.slice_step);
+            iteration.setAttribute("lost_batch", position.lost_batch);
+            if (!diag_sizes.empty()) {
+                iteration.setAttribute("diag_file_sizes", diag_sizes);
+            }
+
+            // reference particles of all ensemble members
+            std::vector<double> ref_particles;
+            for (int member = 0; member < pc.EnsembleSize(); ++member) {
+                append_refpart(ref_particles, pc.GetEnsembleRefParticle(member));
+            }
+            iteration.setAttribute("ensemble_size", pc.EnsembleSize());
+            iteration.setAttribute("ref_particles", ref_particles);
+
+            // stage all particles on the host, then store them in one flush
+            auto pinned_beam = pc.make_alike<amrex::PinnedArenaAllocator>();
+            pinned_beam.copyParticles(pc, true);
+            auto pinned_lost = lost.make_alike<amrex::PinnedArenaAllocator>();
+            pinned_lost.copyParticles(lost, true);
+
+            iteration.setAttribute("beam_num_particles", store_species(iteration, "beam", pinned_beam));
+            iteration.setAttribute("lost_num_particles", store_species(iteration, "particles_lost", pinned_lost));
+
+            iteration.close();
+            series.close();
+        }
+
+        amrex::ParallelDescriptor::Barrier();
+        if (amrex::ParallelDescriptor::IOProcessor()) {
+            std::filesystem::remove_all(file_name);
+            std::filesystem::rename(partial_file_name, file_name);
+        }
+        amrex::ParallelDescriptor::Barrier();
+
+        return file_name;
+#else
+        amrex::ignore_unused(pc, lost, position, diag_sizes);
+        throw std::runtime_error("Checkpoints require ImpactX to be compiled with openPMD support (ImpactX_OPENPMD=ON)");
+#endif
+    }
+
+    TrackingPosition
+    ReadCheckpoint (
+        std::string const & file_name,
+        ImpactXParticleContainer & pc,
+        ImpactXParticleContainer & lost
+    )
+    {
+        BL_PROFILE("impactx::diagnostics::ReadCheckpoint");
+
+#ifdef ImpactX_USE_OPENPMD
+        BeamMonitor::wait_all();
+
+        auto series = io::Series(file_name, io::Access::READ_ONLY
+#   if openPMD_HAVE_MPI==1
+            , amrex::ParallelDescriptor::Communicator()
+#   endif
+        );
+        if (series.iterations.empty())
+            throw std::runtime_error("ReadCheckpoint: " + file_name + " contains no checkpoint");
+        io::Iteration iteration = series.iterations.begin()->second;
+
+        auto const get_attribute = [&iteration, &file_name](std::string const & key) {
+            if (!iteration.containsAttribute(key))
+                throw std::runtime_error("ReadCheckpoint: " + file_name + " has no attribute " + key);
+            return iteration.getAttribute(key);
+        };
+
+        TrackingPosition position;
+        position.global_step = get_attribute("global_step").get<int>();
+        position.period = get_attribute("period").get<int>();
+        position.element_index = get_attribute("element_index").get<int>();
+        position.slice_step = get_attribute("slice_step").get<int>();
+        position.lost_batch = get_attribute("lost_batch").get<int>();
+
+        // reference particles of all ensemble members
+        int const ensemble_size = get_attribute("ensemble_size").get<int>();
+        if (ensemble_size != pc.EnsembleSize())
+            throw std::runtime_error("ReadCheckpoint: " + file_name + " has " + std::to_string(ensemble_size) +
+                                     " ensemble members, but the simulation has " + std::to_string(pc.EnsembleSize()) +
+                                     ". Add the members with add_ensemble_member before the restart.");
+        auto const ref_particles = get_attribute("ref_particles").get<std::vector<double>>();
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(ref_particles.size() == std::size_t(ensemble_size * refpart_size),
+                                         "ReadCheckpoint: unexpected size of the reference particles in " + file_name);
+        for (int member = 0; member < ensemble_size; ++member) {
+            pc.GetEnsembleRefParticle(member) = read_refpart(ref_particles.data() + member * refpart_size);
+        }
+
+        // beam: an even share per MPI rank
+        auto const np_beam = get_attribute("beam_num_particles").get<uint64_t>();
+        auto const [beam_offset, beam_count] = even_share(
+            np_beam, amrex::ParallelDescriptor::MyProc(), amrex::ParallelDescriptor::NProcs());
+        LoadedParticles const beam = load_species(iteration, "beam", beam_offset, beam_count, pc);
+
+        // lost particles: an even share per MPI rank that owns a box of the coarsest level
+        //   the lost particles are not redistributed, see ImpactXParticleContainer::KeepLocalParticles
+        auto const np_lost = get_attribute("lost_num_particles").get<uint64_t>();
+        auto const & proc_map = lost.ParticleDistributionMap(0).ProcessorMap();
+        std::vector<int> owners(proc_map.begin(), proc_map.end());
+        std::sort(owners.begin(), owners.end());
+        owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+        auto const owner = std::find(owners.begin(), owners.end(), amrex::ParallelDescriptor::MyProc());
+        uint64_t lost_offset = 0, lost_count = 0;
+        if (owner != owners.end()) {
+            std::tie(lost_offset, lost_count) = even_share(
+                np_lost, int(std::distance(owners.begin(), owner)), int(owners.size()));
+        }
+        LoadedParticles const lost_particles = load_species(iteration, "particles_lost", lost_offset, lost_count, lost);
+
+        // read all particle data
+        series.flush();
+
+        amrex::Long max_id = -1;
+        if (beam.np > 0) {
+            auto & tile = pc.DefineAndReturnParticleTile(0, 0, 0);
+            max_id = std::max(max_id, add_to_tile(beam, pc, tile));
+        }
+        if (lost_particles.np > 0) {
+            auto const grid = int(std::distance(proc_map.begin(),
+                std::find(proc_map.begin(), proc_map.end(), amrex::ParallelDescriptor::MyProc())));
+            auto & tile = lost.DefineAndReturnParticleTile(0, grid, 0);
+            max_id = std::max(max_id, add_to_tile(lost_particles, lost, tile));
+        }
+        amrex::Gpu::streamSynchronize();
+
+        // particles created after the restart get new ids
+        amrex::ParallelDescriptor::ReduceLongMax(max_id);
+        if (ImpactXParticleContainer::ParticleType::NextID() <= max_id) {
+            ImpactXParticleContainer::ParticleType::NextID(max_id + 1);
+        }
+
+        // remove diagnostics written after the checkpoint
+        if (iteration.containsAttribute("diag_file_sizes")) {
+            truncate_diag_files(iteration.getAttribute("diag_file_sizes").get<std::string>());
+        }
+
+        series.close();
+
+        return position;
+#else
+        amrex::ignore_unused(file_name, pc, lost);
+        throw std::runtime_error("Checkpoints require ImpactX to be compiled with openPMD support (ImpactX_OPENPMD=ON)");
+#endif
+    }
+
+} // namespace impactx::diagnostics
@@ -15,16 +15,241 @@
 
 #include <AMReX_BLProfiler.H> // for BL_PROFILE
 #include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_ParallelDescriptor.H> // for Mpi_typemap
 #include <AMReX_ParmParse.H>  // for ParmParse
+#include <AMReX_Particle.H>   // for ConstParticleIDWrapper
 #include <AMReX_REAL.H>       // for ParticleReal
 #include <AMReX_Print.H>      // for PrintToFile
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 
 
 namespace impactx::diagnostics
 {
+namespace
+{
+    /** Options of the reduced diagnostics, parsed once per simulation */
+    struct ReducedOutputConfig
+    {
+        std::string format = "ascii";  //! diag.reduced_format: ascii or binary
+        int buffer_size = 1000;        //! diag.reduced_buffer_size: records per block of binary output
+        bool nonblocking = false;      //! diag.nonblocking_reduce: overlap the MPI reduction with tracking
+    };
+
+    /** options of the reduced diagnostics, see InitDiagnosticOutput */
+    std::optional<ReducedOutputConfig> reduced_config;
+
+    /** Options of the reduced diagnostics, parsed on first use if not yet by InitDiagnosticOutput */
+    ReducedOutputConfig const &
+    get_reduced_config ()
+    {
+        if (!reduced_config) { InitDiagnosticOutput(); }
+        return *reduced_config;
+    }
+
+    /** A reduction of beam moments over MPI ranks that is still in flight */
+    struct PendingBeamCharacteristics
+    {
+        ImpactXParticleContainer const * pc = nullptr;
+        BeamMoments moments;
+        std::string file_name;
+        int step = 0;
+        bool append = true;
+#ifdef AMREX_USE_MPI
+        MPI_Request request = MPI_REQUEST_NULL;
+#endif
+    };
+
+    /** at most one non-blocking reduction is in flight */
+    std::optional<PendingBeamCharacteristics> pending_rbc;
+
+    /** Records of fixed layout, buffered in memory before they are written */
+    struct BinaryTable
+    {
+        std::vector<std::string> columns;  //! names of the values of a record
+        std::vector<double> records;       //! values of all buffered records
+        bool created = false;              //! file created and header written
+    };
+
+    /** buffered tables, by file name */
+    std::map<std::string, BinaryTable> binary_tables;
+
+    /** first word of the binary reduced diagnostics files */
+    constexpr char const * binary_magic = "IMPACTX_REDUCED";
+
+    /** version of the layout of the binary reduced diagnostics files */
+    constexpr int binary_version = 1;
+
+    /** byte order of the records written by this process: little or big */
+    std::string
+    byte_order ()
+    {
+        std::uint16_t const probe = 1;
+        unsigned char first_byte = 0;
+        std::memcpy(&first_byte, &probe, 1);
+        return first_byte == 1 ? "little" : "big";
+    }
+
+    /** Write the buffered records of a table to <file_name>.bin
+     *
+     * The file starts with two text lines. The first has the magic word
+     * IMPACTX_REDUCED, the format version, the byte order (little or big),
+     * the type of all values (float64) and the number of columns.
+     * The second has the space-separated column names. The records follow
+     * as doubles in that byte order. Only the IO rank writes.
+     *
+     * @param file_name the file name to write to, without suffix
+     * @param table the buffered records
+     */
+    void
+    flush_table (std::string const & file_name, BinaryTable & table)
+    {
+        if (table.created && table.records.empty()) { return; }
+
+        BL_PROFILE("impactx::diagnostics::flush_table");
+
+        if (amrex::ParallelDescriptor::IOProcessor())
+        {
+            auto const mode = std::ios::binary | (table.created ? std::ios::app : std::ios::trunc);
+            std::ofstream ofs(file_name + ".bin", mode);
+            if (!table.created) {
+                static_assert(sizeof(double) == 8, "the binary format stores float64 values");
+                ofs << binary_magic << " " << binary_version << " " << byte_order()
+                    << " float64 " << table.columns.size() << "\n";
+                for (std::size_t i = 0; i < table.columns.size(); ++i) {
+                    ofs << (i == 0 ? "" : " ") << table.columns[i];
+                }
+                ofs << "\n";
+            }
+            ofs.write(reinterpret_cast<char const *>(table.records.data()),
+                      std::streamsize(table.records.size() * sizeof(double)));
+            if (!ofs)
+                throw std::runtime_error("DiagnosticOutput: could not write " + file_name + ".bin");
+        }
+
+        table.created = true;
+        table.records.clear();
+    }
+
+    /** Write one record of fixed layout: step, then values
+     *
+     * With diag.reduced_format = binary, the record is buffered and written
+     * in blocks of diag.reduced_buffer_size records. Otherwise, it is written
+     * as an ASCII line.
+     *
+     * @param config options of the reduced diagnostics
+     * @param file_name the file name to write to
+     * @param columns names of the values, without step
+     * @param step the global step
+     * @param values the values of the record
+     * @param append start a new file with a fresh header (false) or append to an existing file (true)
+     */
+    template<typename T_Names, typename T_Values>
+    void
+    write_record (
+        ReducedOutputConfig const & config,
+        std::string const & file_name,
+        T_Names const & columns,
+        int step,
+        T_Values const & values,
+        bool append
+    )
+    {
+        if (config.format == "binary")
+        {
+            BinaryTable & table = binary_tables[file_name];
+            if (!append) {
+                flush_table(file_name, table);
+                table = BinaryTable{};
+            }
+            if (table.columns.empty()) {
+                // appending to a table that was not started here, e.g., after a restart
+                table.created = append;
+                table.columns.emplace_back("step");
+                table.columns.insert(table.columns.end(), std::begin(columns), std::end(columns));
+            }
+
+            table.records.push_back(double(step));
+            table.records.insert(table.records.end(), std::begin(values), std::end(values));
+
+            if (table.records.size() >= std::size_t(config.buffer_size) * table.columns.size())
+                flush_table(file_name, table);
+        }
+        else
+        {
+            amrex::AllPrintToFile file_handler(file_name);
+            file_handler.SetPrecision(std::numeric_limits<amrex::Real>::max_digits10);
+
+            if (!append) {
+                file_handler << "step";
+                for (auto const & name : columns) { file_handler << " " << name; }
+                file_handler << "\n";
+            }
+
+            file_handler << step;
+            for (auto const & value : values) { file_handler << " " << value; }
+            file_handler << "\n";
+        }
+    }
+
+    /** Complete and write a non-blocking reduction, if one is in flight */
+    void
+    finish_pending_rbc ()
+    {
+        if (!pending_rbc) { return; }
+
+#ifdef AMREX_USE_MPI
+        MPI_Wait(&pending_rbc->request, MPI_STATUS_IGNORE);
+#endif
+
+        BeamCharacteristics const rbc = beam_characteristics(pending_rbc->moments);
+        update_moments_shift(*pending_rbc->pc, pending_rbc->moments, rbc);
+
+        write_record(get_reduced_config(), pending_rbc->file_name, BeamCharacteristics::names,
+                     pending_rbc->step, rbc.to_array(), pending_rbc->append);
+
+        pending_rbc.reset();
+    }
+} // anonymous namespace
+
+    void InitDiagnosticOutput ()
+    {
+        ReducedOutputConfig config;
+
+        amrex::ParmParse pp_diag("diag");
+        pp_diag.queryAdd("reduced_format", config.format);
+        pp_diag.queryAdd("reduced_buffer_size", config.buffer_size);
+        pp_diag.queryAdd("nonblocking_reduce", config.nonblocking);
+
+        if (config.format != "ascii" && config.format != "binary")
+            throw std::runtime_error("diag.reduced_format must be ascii or binary, not " + config.format);
+
+        reduced_config = config;
+    }
+
+    void FinishDiagnosticOutput ()
+    {
+        BL_PROFILE("impactx::diagnostics::FinishDiagnosticOutput");
+
+        finish_pending_rbc();
+
+        for (auto & [file_name, table] : binary_tables) {
+            flush_table(file_name, table);
+        }
+    }
+
     void DiagnosticOutput (ImpactXParticleContainer const & pc,
                            OutputType const otype,
                            std::string file_name,
@@ -35,64 +260,78 @@ namespace impactx::diagnostics
 
         using namespace amrex::literals; // for _rt and _prt
 
-        // keep file open as we add more and more lines
-        amrex::AllPrintToFile file_handler(std::move(file_name));
-        file_handler.SetPrecision(std::numeric_limits<amrex::ParticleReal>::max_digits10);
+        // complete and write an earlier non-blocking reduction first
+        finish_pending_rbc();
 
-        // write file header per MPI RANK
-        if (!append) {
-            if (otype == OutputType::PrintNonlinearLensInvariants) {
-                file_handler << "id H I\n";
-            } else if (otype == OutputType::PrintRefParticle) {
-                file_handler << "step s x y z t px py pz pt\n";
-            } else if (otype == OutputType::PrintReducedBeamCharacteristics) {
-                file_handler << "step" << " " << "s" << " " << "ref_beta_gamma" << " "
-                             << "x_mean" << " " << "y_mean" << " " << "t_mean" << " "
-                             << "sig_x" << " " << "sig_y" << " " << "sig_t" << " "
-                             << "px_mean" << " " << "py_mean" << " " << "pt_mean" << " "
-                             << "sig_px" << " " << "sig_py" << " " << "sig_pt" << " "
-                             << "emittance_x" << " " << "emittance_y" << " " << "emittance_t" << " "
-                             << "alpha_x" << " " << "alpha_y" << " " << "alpha_t" << " "
-                             << "beta_x" << " " << "beta_y" << " " << "beta_t" << " "
-                             << "charge_C" << " "
-                             << "\n";
-            }
-        }
+        ReducedOutputConfig const & config = get_reduced_config();
 
         if (otype == OutputType::PrintRefParticle) {
             // preparing to access reference particle data: RefPart
             RefPart const ref_part = pc.GetRefParticle();
 
-            amrex::ParticleReal const s = ref_part.s;
-            amrex::ParticleReal const x = ref_part.x;
-            amrex::ParticleReal const y = ref_part.y;
-            amrex::ParticleReal const z = ref_part.z;
-            amrex::ParticleReal const t = ref_part.t;
-            amrex::ParticleReal const px = ref_part.px;
-            amrex::ParticleReal const py = ref_part.py;
-            amrex::ParticleReal const pz = ref_part.pz;
-            amrex::ParticleReal const pt = ref_part.pt;
+            static constexpr std::array<char const *, 9> names = {
+                "s", "x", "y", "z", "t", "px", "py", "pz", "pt"};
+            std::array<amrex::Real, 9> const values = {
+                ref_part.s,
+                ref_part.x, ref_part.y, ref_part.z, ref_part.t,
+                ref_part.px, ref_part.py, ref_part.pz, ref_part.pt};
 
             // write particle data to file
-            file_handler
-                    << step << " " << s << " "
-                    << x << " " << y << " " << z << " " << t << " "
-                    << px << " " << py << " " << pz << " " << pt << "\n";
+            write_record(config, file_name, names, step, values, append);
+            return;
         } // if( otype == OutputType::PrintRefParticle)
         else if (otype == OutputType::PrintReducedBeamCharacteristics) {
-            std::unordered_map<std::string, amrex::ParticleReal> const rbc =
-                diagnostics::reduced_beam_characteristics(pc);
-
-            file_handler << step << " " << rbc.at("s") << " " << rbc.at("ref_beta_gamma") << " "
-                         << rbc.at("x_mean") << " " << rbc.at("y_mean") << " " << rbc.at("t_mean") << " "
-                         << rbc.at("sig_x") << " " << rbc.at("sig_y") << " " << rbc.at("sig_t") << " "
-                         << rbc.at("px_mean") << " " << rbc.at("py_mean") << " " << rbc.at("pt_mean") << " "
-                         << rbc.at("sig_px") << " " << rbc.at("sig_py") << " " << rbc.at("sig_pt") << " "
-                         << rbc.at("emittance_x") << " " << rbc.at("emittance_y") << " " << rbc.at("emittance_t") << " "
-                         << rbc.at("alpha_x") << " " << rbc.at("alpha_y") << " " << rbc.at("alpha_t") << " "
-                         << rbc.at("beta_x") << " " << rbc.at("beta_y") << " " << rbc.at("beta_t") << " "
-                         << rbc.at("charge_C") << "\n";
+            if (config.nonblocking) {
+                // start the reduction over MPI ranks and write its result later
+                pending_rbc.emplace();
+                pending_rbc->pc = &pc;
+                pending_rbc->moments = local_beam_moments(pc);
+                pending_rbc->file_name = file_name;
+                pending_rbc->step = step;
+                pending_rbc->append = append;
+#ifdef AMREX_USE_MPI
+                MPI_Iallreduce(MPI_IN_PLACE,
+                               pending_rbc->moments.sums.data(),
+                               BeamMoments::num_sums,
+                               amrex::ParallelDescriptor::Mpi_typemap<amrex::Real>::type(),
+                               MPI_SUM,
+                               amrex::ParallelDescriptor::Communicator(),
+                               &pending_rbc->request);
+#endif
+            } else {
+                BeamCharacteristics const rbc = diagnostics::reduced_beam_characteristics(pc);
+
+                write_record(config, file_name, BeamCharacteristics::names, step, rbc.to_array(), append);
+            }
+            return;
         } // if( otype == OutputType::PrintReducedBeamCharacteristics)
+        else if (otype == OutputType::PrintEnsembleReducedBeamCharacteristics) {
+            std::vector<BeamCharacteristics> const rbc = diagnostics::ensemble_reduced_beam_characteristics(pc);
+
+            // the ensemble member is the first value of each record
+            std::vector<std::string> columns{"member"};
+            columns.insert(columns.end(), BeamCharacteristics::names.begin(), BeamCharacteristics::names.end());
+
+            for (int m = 0; m < int(rbc.size()); ++m) {
+                std::vector<amrex::Real> values{amrex::Real(m)};
+                auto const member_values = rbc[m].to_array();
+                values.insert(values.end(), member_values.begin(), member_values.end());
+
+                write_record(config, file_name, columns, step, values, append || m > 0);
+            }
+            return;
+        } // if( otype == OutputType::PrintEnsembleReducedBeamCharacteristics)
+
+        // keep file open as we add more and more lines
+        amrex::AllPrintToFile file_handler(std::move(file_name));
+        file_handler.SetPrecision(std::numeric_limits<amrex::Real>::max_digits10);
+
+        // write file header per MPI RANK
+        if (!append) {
+            if (otype == OutputType::PrintNonlinearLensInvariants) {
+                file_handler << "id H I\n";
+            }
+        }
 
         // TODO: add as an option to the monitor element
         if (otype == OutputType::PrintNonlinearLensInvariants) {
@@ -111,16 +350,17 @@ namespace impactx::diagnostics
                 for (ParIt pti(tmp, lev); pti.isValid(); ++pti) {
                     const int np = pti.numParticles();
 
-                    // preparing access to particle data: AoS
-                    using PType = ImpactXParticleContainer::ParticleType;
-                    auto const &aos = pti.GetArrayOfStructs();
-                    PType const *const AMREX_RESTRICT aos_ptr = aos().dataPtr();
-
                     // preparing access to particle data: SoA of Reals
-                    auto &soa_real = pti.GetStructOfArrays().GetRealData();
+                    auto const &soa = pti.GetStructOfArrays();
+                    auto const &soa_real = soa.GetRealData();
+                    amrex::ParticleReal const *const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                    amrex::ParticleReal const *const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
                     amrex::ParticleReal const *const AMREX_RESTRICT part_px = soa_real[RealSoA::px].dataPtr();
                     amrex::ParticleReal const *const AMREX_RESTRICT part_py = soa_real[RealSoA::py].dataPtr();
 
+                    // preparing access to particle data: id and cpu
+                    uint64_t const *const AMREX_RESTRICT part_idcpu = soa.GetIdCPUData().dataPtr();
+
                     if (otype == OutputType::PrintNonlinearLensInvariants) {
                         using namespace amrex::literals;
 
@@ -144,13 +384,15 @@ namespace impactx::diagnostics
                         // print out particles
                         for (int i = 0; i < np; ++i) {
 
-                            // access AoS data such as positions and cpu/id
-                            PType const &p = aos_ptr[i];
-                            amrex::ParticleReal const x = p.pos(RealAoS::x);
-                            amrex::ParticleReal const y = p.pos(RealAoS::y);
-                            uint64_t const global_id = ablastr::particles::localIDtoGlobal(p.id(), p.cpu());
+                            // access particle id and cpu
+                            uint64_t const idcpu = part_idcpu[i];
+                            uint64_t const global_id = ablastr::particles::localIDtoGlobal(
+                                static_cast<int>(amrex::ConstParticleIDWrapper{idcpu}),
+                                static_cast<int>(amrex::ConstParticleCPUWrapper{idcpu}));
 
                             // access SoA Real data
+                            amrex::ParticleReal const x = part_x[i];
+                            amrex::ParticleReal const y = part_y[i];
                             amrex::ParticleReal const px = part_px[i];
                             amrex::ParticleReal const py = part_py[i];
 
@@ -0,0 +1,128 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl
+ * License: BSD-3-Clause-LBNL
+ */
+#include "ElementProfile.H"
+
+#include <AMReX_GpuDevice.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_ParallelReduce.H>
+#include <AMReX_Utility.H>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace impactx::diagnostics
+{
+    double
+    ElementProfileEntry::total_time () const
+    {
+        return std::accumulate(time.begin(), time.end(), 0.0);
+    }
+
+    double
+    ElementProfileEntry::bytes_per_second () const
+    {
+        double const push_time = time[int(ProfilePhase::Push)];
+        return push_time > 0.0 ? bytes / push_time : 0.0;
+    }
+
+    void
+    ElementProfile::reset (bool enable)
+    {
+        m_enabled = enable;
+        m_current = -1;
+        m_entries.clear();
+    }
+
+    void
+    ElementProfile::start_slice (int index, int num_elements, std::string const & name)
+    {
+        if (!m_enabled) { return; }
+
+        if (index >= int(m_entries.size())) { m_entries.resize(index + 1); }
+        ElementProfileEntry & entry = m_entries[index];
+        entry.index = index;
+        entry.num_elements = num_elements;
+        entry.name = name;
+        entry.slices++;
+        m_current = index;
+
+        amrex::Gpu::streamSynchronize();
+        m_last_time = amrex::second();
+    }
+
+    void
+    ElementProfile::add_particles (amrex::Long num_particles, std::size_t bytes_per_particle)
+    {
+        if (!m_enabled || m_current < 0) { return; }
+
+        ElementProfileEntry & entry = m_entries[m_current];
+        entry.particles += num_particles;
+        entry.bytes += double(num_particles) * double(bytes_per_particle);
+    }
+
+    void
+    ElementProfile::lap (ProfilePhase phase)
+    {
+        if (!m_enabled || m_current < 0) { return; }
+
+        amrex::Gpu::streamSynchronize();
+        double const now = amrex::second();
+        m_entries[m_current].time[int(phase)] += now - m_last_time;
+        m_last_time = now;
+    }
+
+    void
+    ElementProfile::reduce ()
+    {
+        if (!m_enabled) { return; }
+
+        auto const comm = amrex::ParallelDescriptor::Communicator();
+        for (auto & entry : m_entries) {
+            amrex::ParallelAllReduce::Max(entry.time.data(), num_profile_phases, comm);
+            amrex::ParallelAllReduce::Sum(entry.particles, comm);
+            amrex::ParallelAllReduce::Sum(entry.bytes, comm);
+        }
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                       [](ElementProfileEntry const & entry) { return entry.slices == 0; }),
+                        m_entries.end());
+        m_current = -1;
+    }
+
+    void
+    ElementProfile::write (std::string const & file_name) const
+    {
+        if (!m_enabled || !amrex::ParallelDescriptor::IOProcessor()) { return; }
+
+        std::ofstream ofs(file_name, std::ios::trunc);
+        ofs.precision(std::numeric_limits<double>::max_digits10);
+
+        ofs << "index num_elements name slices particles bytes_per_second total_time";
+        for (auto const & phase_name : ElementProfileEntry::phase_names) {
+            ofs << " time_" << phase_name;
+        }
+        ofs << "\n";
+
+        for (auto const & entry : m_entries) {
+            ofs << entry.index << " " << entry.num_elements << " " << entry.name << " " << entry.slices << " "
+                << entry.particles << " " << entry.bytes_per_second() << " "
+                << entry.total_time();
+            for (double const t : entry.time) { ofs << " " << t; }
+            ofs << "\n";
+        }
+
+        if (!ofs)
+            throw std::runtime_error("ElementProfile: could not write " + file_name);
+    }
+
+} // namespace impactx::diagnostics
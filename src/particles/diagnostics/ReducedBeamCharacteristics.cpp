@@ -13,239 +13,395 @@
 #include "particles/ImpactXParticleContainer.H"
 #include "particles/ReferenceParticle.H"
 
+#include <AMReX_Algorithm.H>           // for min
 #include <AMReX_BLProfiler.H>           // for TinyProfiler
+#include <AMReX_GpuAtomic.H>            // for HostDevice::Atomic
+#include <AMReX_GpuContainers.H>        // for DeviceVector
 #include <AMReX_GpuQualifiers.H>        // for AMREX_GPU_DEVICE
-#include <AMReX_REAL.H>                 // for ParticleReal
+#include <AMReX_REAL.H>                 // for Real
 #include <AMReX_Reduce.H>               // for ReduceOps
 #include <AMReX_ParallelDescriptor.H>   // for ParallelDescriptor
 #include <AMReX_ParticleReduce.H>       // for ParticleReduce
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 
 namespace impactx::diagnostics
 {
-    std::unordered_map<std::string, amrex::ParticleReal>
-    reduced_beam_characteristics (ImpactXParticleContainer const & pc)
+    std::array<amrex::Real, BeamCharacteristics::num_values>
+    BeamCharacteristics::to_array () const
     {
-        BL_PROFILE("impactx::diagnostics::reduced_beam_characteristics");
+        return {s, ref_beta_gamma,
+                x_mean, y_mean, t_mean, sig_x, sig_y, sig_t,
+                px_mean, py_mean, pt_mean, sig_px, sig_py, sig_pt,
+                emittance_x, emittance_y, emittance_t,
+                alpha_x, alpha_y, alpha_t,
+                beta_x, beta_y, beta_t,
+                charge_C};
+    }
 
-        // preparing to access reference particle data: RefPart
-        RefPart const ref_part = pc.GetRefParticle();
-        // reference particle charge in C
-        amrex::ParticleReal const q_C = ref_part.charge;
+    std::unordered_map<std::string, amrex::Real>
+    BeamCharacteristics::to_map () const
+    {
+        auto const values = to_array();
+
+        std::unordered_map<std::string, amrex::Real> data;
+        for (int i = 0; i < num_values; ++i) {
+            data[names[i]] = values[i];
+        }
+        return data;
+    }
+
+    BeamMoments
+    local_beam_moments (ImpactXParticleContainer const & pc)
+    {
+        BL_PROFILE("impactx::diagnostics::local_beam_moments");
+
+        BeamMoments moments;
+        moments.ref_part = pc.GetRefParticle();
+        moments.shift = pc.MomentsShift();
+
+        // shift of x, y, t, px, py, pt
+        amrex::GpuArray<amrex::Real, 6> const k{
+            moments.shift[0], moments.shift[1], moments.shift[2],
+            moments.shift[3], moments.shift[4], moments.shift[5]};
 
-        // preparing access to particle data: AoS and SoA
+        // preparing access to particle data: SoA
         using PType = typename ImpactXParticleContainer::SuperParticleType;
 
         amrex::ReduceOps<
+            amrex::ReduceOpSum,
+            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
+            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
             amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
             amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
-            amrex::ReduceOpSum
+            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum
         > reduce_ops;
 
         auto r = amrex::ParticleReduce<
             amrex::ReduceData<
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal
+                amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real
             >
         >(
             pc,
             [=] AMREX_GPU_DEVICE (const PType& p) noexcept
             -> amrex::GpuTuple<
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal
+                amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real,
+                amrex::Real, amrex::Real, amrex::Real
             >
             {
-                // access AoS particle position data
-                const amrex::ParticleReal p_pos0 = p.pos(0);
-                const amrex::ParticleReal p_pos1 = p.pos(1);
-                const amrex::ParticleReal p_pos2 = p.pos(2);
-
-                // access SoA particle momentum data and weighting
-                const amrex::ParticleReal p_w = p.rdata(RealSoA::w);
-                const amrex::ParticleReal p_px = p.rdata(RealSoA::px);
-                const amrex::ParticleReal p_py = p.rdata(RealSoA::py);
-                const amrex::ParticleReal p_pt = p.rdata(RealSoA::pt);
-
-                // prepare mean position values
-                const amrex::ParticleReal p_x_mean = p_pos0*p_w;
-                const amrex::ParticleReal p_y_mean = p_pos1*p_w;
-                const amrex::ParticleReal p_t_mean = p_pos2*p_w;
-
-                const amrex::ParticleReal p_px_mean = p_px*p_w;
-                const amrex::ParticleReal p_py_mean = p_py*p_w;
-                const amrex::ParticleReal p_pt_mean = p_pt*p_w;
+                // access SoA particle data and weighting, relative to the shift
+                const amrex::Real p_w = p.rdata(RealSoA::w);
+                const amrex::Real p_x = p.rdata(RealSoA::x) - k[0];
+                const amrex::Real p_y = p.rdata(RealSoA::y) - k[1];
+                const amrex::Real p_t = p.rdata(RealSoA::t) - k[2];
+                const amrex::Real p_px = p.rdata(RealSoA::px) - k[3];
+                const amrex::Real p_py = p.rdata(RealSoA::py) - k[4];
+                const amrex::Real p_pt = p.rdata(RealSoA::pt) - k[5];
 
                 return {p_w,
-                        p_x_mean, p_y_mean, p_t_mean,
-                        p_px_mean, p_py_mean, p_pt_mean};
+                        p_x*p_w, p_y*p_w, p_t*p_w,
+                        p_px*p_w, p_py*p_w, p_pt*p_w,
+                        p_x*p_x*p_w, p_y*p_y*p_w, p_t*p_t*p_w,
+                        p_px*p_px*p_w, p_py*p_py*p_w, p_pt*p_pt*p_w,
+                        p_x*p_px*p_w, p_y*p_py*p_w, p_t*p_pt*p_w};
             },
             reduce_ops
         );
 
-        std::vector<amrex::ParticleReal> values_per_rank_1st = {
-                amrex::get<0>(r), // w
-                amrex::get<1>(r), // x_mean
-                amrex::get<2>(r), // y_mean
-                amrex::get<3>(r), // t_mean
-                amrex::get<4>(r), // px_mean
-                amrex::get<5>(r), // py_mean
-                amrex::get<6>(r), // pt_mean
+        moments.sums = {
+            amrex::get<0>(r),   // w
+            amrex::get<1>(r),   // x
+            amrex::get<2>(r),   // y
+            amrex::get<3>(r),   // t
+            amrex::get<4>(r),   // px
+            amrex::get<5>(r),   // py
+            amrex::get<6>(r),   // pt
+            amrex::get<7>(r),   // x*x
+            amrex::get<8>(r),   // y*y
+            amrex::get<9>(r),   // t*t
+            amrex::get<10>(r),  // px*px
+            amrex::get<11>(r),  // py*py
+            amrex::get<12>(r),  // pt*pt
+            amrex::get<13>(r),  // x*px
+            amrex::get<14>(r),  // y*py
+            amrex::get<15>(r)   // t*pt
         };
 
+        return moments;
+    }
+
+    BeamCharacteristics
+    beam_characteristics (BeamMoments const & moments)
+    {
+        auto const & sums = moments.sums;
+        auto const & k = moments.shift;
+        RefPart const & ref_part = moments.ref_part;
+
+        // reference particle charge in C
+        amrex::Real const q_C = ref_part.charge;
+
+        amrex::Real const w_sum = sums[0];
+
+        // means relative to the shift
+        amrex::Real const dx  = sums[1] / w_sum;
+        amrex::Real const dy  = sums[2] / w_sum;
+        amrex::Real const dt  = sums[3] / w_sum;
+        amrex::Real const dpx = sums[4] / w_sum;
+        amrex::Real const dpy = sums[5] / w_sum;
+        amrex::Real const dpt = sums[6] / w_sum;
+
+        amrex::Real const x_mean  = k[0] + dx;
+        amrex::Real const y_mean  = k[1] + dy;
+        amrex::Real const t_mean  = k[2] + dt;
+        amrex::Real const px_mean = k[3] + dpx;
+        amrex::Real const py_mean = k[4] + dpy;
+        amrex::Real const pt_mean = k[5] + dpt;
+
+        // central second moments
+        amrex::Real const x_ms  = sums[7] / w_sum - dx*dx;
+        amrex::Real const y_ms  = sums[8] / w_sum - dy*dy;
+        amrex::Real const t_ms  = sums[9] / w_sum - dt*dt;
+        amrex::Real const px_ms = sums[10] / w_sum - dpx*dpx;
+        amrex::Real const py_ms = sums[11] / w_sum - dpy*dpy;
+        amrex::Real const pt_ms = sums[12] / w_sum - dpt*dpt;
+        amrex::Real const xpx   = sums[13] / w_sum - dx*dpx;
+        amrex::Real const ypy   = sums[14] / w_sum - dy*dpy;
+        amrex::Real const tpt   = sums[15] / w_sum - dt*dpt;
+        amrex::Real const charge = q_C * w_sum;
+        // standard deviations of positions
+        amrex::Real const sig_x = std::sqrt(x_ms);
+        amrex::Real const sig_y = std::sqrt(y_ms);
+        amrex::Real const sig_t = std::sqrt(t_ms);
+        // standard deviations of momenta
+        amrex::Real const sig_px = std::sqrt(px_ms);
+        amrex::Real const sig_py = std::sqrt(py_ms);
+        amrex::Real const sig_pt = std::sqrt(pt_ms);
+        // RMS emittances
+        amrex::Real const emittance_x = std::sqrt(x_ms*px_ms-xpx*xpx);
+        amrex::Real const emittance_y = std::sqrt(y_ms*py_ms-ypy*ypy);
+        amrex::Real const emittance_t = std::sqrt(t_ms*pt_ms-tpt*tpt);
+        // Courant-Snyder (Twiss) beta-function
+        amrex::Real const beta_x = x_ms / emittance_x;
+        amrex::Real const beta_y = y_ms / emittance_y;
+        amrex::Real const beta_t = t_ms / emittance_t;
+        // Courant-Snyder (Twiss) alpha
+        amrex::Real const alpha_x = - xpx / emittance_x;
+        amrex::Real const alpha_y = - ypy / emittance_y;
+        amrex::Real const alpha_t = - tpt / emittance_t;
+
+        BeamCharacteristics data;
+        data.s = ref_part.s;
+        data.ref_beta_gamma = ref_part.beta_gamma();
+        data.x_mean = x_mean;
+        data.y_mean = y_mean;
+        data.t_mean = t_mean;
+        data.sig_x = sig_x;
+        data.sig_y = sig_y;
+        data.sig_t = sig_t;
+        data.px_mean = px_mean;
+        data.py_mean = py_mean;
+        data.pt_mean = pt_mean;
+        data.sig_px = sig_px;
+        data.sig_py = sig_py;
+        data.sig_pt = sig_pt;
+        data.emittance_x = emittance_x;
+        data.emittance_y = emittance_y;
+        data.emittance_t = emittance_t;
+        data.alpha_x = alpha_x;
+        data.alpha_y = alpha_y;
+        data.alpha_t = alpha_t;
+        data.beta_x = beta_x;
+        data.beta_y = beta_y;
+        data.beta_t = beta_t;
+        data.charge_C = charge;
+
+        return data;
+    }
+
+    void
+    update_moments_shift (
+        ImpactXParticleContainer const & pc,
+        BeamMoments const & moments,
+        BeamCharacteristics const & data
+    )
+    {
+        // keep the old shift if there are no particles left
+        if (!(moments.sums[0] > 0.0)) { return; }
+
+        pc.MomentsShift() = {data.x_mean, data.y_mean, data.t_mean,
+                             data.px_mean, data.py_mean, data.pt_mean};
+    }
+
+    BeamCharacteristics
+    reduced_beam_characteristics (ImpactXParticleContainer const & pc)
+    {
+        BL_PROFILE("impactx::diagnostics::reduced_beam_characteristics");
+
+        BeamMoments moments = local_beam_moments(pc);
+
         // reduced sum over mpi ranks (allreduce)
         amrex::ParallelAllReduce::Sum(
-            values_per_rank_1st.data(),
-            values_per_rank_1st.size(),
+            moments.sums.data(),
+            moments.sums.size(),
             amrex::ParallelDescriptor::Communicator()
         );
 
-        amrex::ParticleReal const w_sum   = values_per_rank_1st.at(0);
-        amrex::ParticleReal const x_mean  = values_per_rank_1st.at(1) /= w_sum;
-        amrex::ParticleReal const y_mean  = values_per_rank_1st.at(2) /= w_sum;
-        amrex::ParticleReal const t_mean  = values_per_rank_1st.at(3) /= w_sum;
-        amrex::ParticleReal const px_mean = values_per_rank_1st.at(4) /= w_sum;
-        amrex::ParticleReal const py_mean = values_per_rank_1st.at(5) /= w_sum;
-        amrex::ParticleReal const pt_mean = values_per_rank_1st.at(6) /= w_sum;
+        BeamCharacteristics const data = beam_characteristics(moments);
+        update_moments_shift(pc, moments, data);
 
+        return data;
+    }
 
-        amrex::ReduceOps<
-            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
-            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
-            amrex::ReduceOpSum, amrex::ReduceOpSum, amrex::ReduceOpSum,
-            amrex::ReduceOpSum
-        > reduce_ops2;
+    std::vector<BeamCharacteristics>
+    ensemble_reduced_beam_characteristics (ImpactXParticleContainer const & pc)
+    {
+        BL_PROFILE("impactx::diagnostics::ensemble_reduced_beam_characteristics");
 
+        constexpr int num_sums = BeamMoments::num_sums;
+        int const num_members = pc.EnsembleSize();
 
-        auto r2 = amrex::ParticleReduce<
-            amrex::ReduceData<
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal
-            >
-        >(
-            pc,
-            [=] AMREX_GPU_DEVICE(const PType& p) noexcept
-            -> amrex::GpuTuple<
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
-                amrex::ParticleReal
-            >
-            {
-                // access SoA particle momentum data and weighting
-                const amrex::ParticleReal p_w = p.rdata(RealSoA::w);
-                const amrex::ParticleReal p_px = p.rdata(RealSoA::px);
-                const amrex::ParticleReal p_py = p.rdata(RealSoA::py);
-                const amrex::ParticleReal p_pt = p.rdata(RealSoA::pt);
-                // access AoS particle position data
-                const amrex::ParticleReal p_pos0 = p.pos(0);
-                const amrex::ParticleReal p_pos1 = p.pos(1);
-                const amrex::ParticleReal p_pos2 = p.pos(2);
-                const amrex::ParticleReal p_x = p_pos0;
-                const amrex::ParticleReal p_y = p_pos1;
-                const amrex::ParticleReal p_t = p_pos2;
-                // prepare mean square for positions
-                const amrex::ParticleReal p_x_ms = (p_x-x_mean)*(p_x-x_mean)*p_w;
-                const amrex::ParticleReal p_y_ms = (p_y-y_mean)*(p_y-y_mean)*p_w;
-                const amrex::ParticleReal p_t_ms = (p_t-t_mean)*(p_t-t_mean)*p_w;
-                // prepare mean square for momenta
-                const amrex::ParticleReal p_px_ms = (p_px-px_mean)*(p_px-px_mean)*p_w;
-                const amrex::ParticleReal p_py_ms = (p_py-py_mean)*(p_py-py_mean)*p_w;
-                const amrex::ParticleReal p_pt_ms = (p_pt-pt_mean)*(p_pt-pt_mean)*p_w;
-
-                const amrex::ParticleReal p_xpx = (p_x-x_mean)*(p_px-px_mean)*p_w;
-                const amrex::ParticleReal p_ypy = (p_y-y_mean)*(p_py-py_mean)*p_w;
-                const amrex::ParticleReal p_tpt = (p_t-t_mean)*(p_pt-pt_mean)*p_w;
-
-                const amrex::ParticleReal p_charge = q_C*p_w;
-
-                return {p_x_ms, p_y_ms, p_t_ms,
-                        p_px_ms, p_py_ms, p_pt_ms,
-                        p_xpx, p_ypy, p_tpt,
-                        p_charge};
-            },
-            reduce_ops2
-        );
+        // a single beam: the usual reduction
+        if (num_members == 1) {
+            return {reduced_beam_characteristics(pc)};
+        }
 
-        std::vector<amrex::ParticleReal> values_per_rank_2nd = {
-                amrex::get<0>(r2), // x_ms
-                amrex::get<1>(r2), // y_ms
-                amrex::get<2>(r2), // t_ms
-                amrex::get<3>(r2), // px_ms
-                amrex::get<4>(r2), // py_ms
-                amrex::get<5>(r2), // pt_ms
-                amrex::get<6>(r2), // xpx
-                amrex::get<7>(r2), // ypy
-                amrex::get<8>(r2), // tpt
-                amrex::get<9>(r2) // charge
-        };
+        // shift of x, y, t, px, py, pt per member
+        std::vector<amrex::Real> h_shift(6 * num_members);
+        for (int m = 0; m < num_members; ++m) {
+            auto const & shift = pc.EnsembleMomentsShift(m);
+            std::copy(shift.begin(), shift.end(), h_shift.begin() + 6 * m);
+        }
+        amrex::Gpu::DeviceVector<amrex::Real> shift(h_shift.size());
+        amrex::Gpu::copyAsync(amrex::Gpu::hostToDevice,
+                              h_shift.begin(), h_shift.end(),
+                              shift.begin());
 
-        // reduced sum over mpi ranks (reduce to IO rank)
-        amrex::ParallelDescriptor::ReduceRealSum(
-            values_per_rank_2nd.data(),
-            values_per_rank_2nd.size(),
-            amrex::ParallelDescriptor::IOProcessorNumber()
+        // sums per member, in the order of BeamMoments
+        amrex::Gpu::DeviceVector<amrex::Real> sums(num_sums * num_members, 0.0);
+        amrex::Real const * const AMREX_RESTRICT k_ptr = shift.dataPtr();
+        amrex::Real * const AMREX_RESTRICT sums_ptr = sums.dataPtr();
+
+        // particles are summed in chunks: each work item sums the particles
+        // of one member in one chunk locally, then adds its partial sums
+        // once to the sums of the member
+        constexpr int chunk_size = 256;
+
+        int const nLevel = pc.finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev)
+        {
+            // loop over all particle boxes
+            using ParIt = ImpactXParticleContainer::const_iterator;
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                const int np = pti.numParticles();
+                if (np == 0) { continue; }
+
+                // preparing access to particle data: SoA
+                auto const & soa = pti.GetStructOfArrays();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_x = soa.GetRealData(RealSoA::x).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_y = soa.GetRealData(RealSoA::y).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_t = soa.GetRealData(RealSoA::t).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_px = soa.GetRealData(RealSoA::px).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_py = soa.GetRealData(RealSoA::py).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_pt = soa.GetRealData(RealSoA::pt).dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_w = soa.GetRealData(RealSoA::w).dataPtr();
+                int const * const AMREX_RESTRICT part_member =
+                    soa.GetIntData(ImpactXParticleContainer::EnsembleMemberComp).dataPtr();
+
+                // neighboring work items sum the same chunk for different members
+                amrex::Long const num_chunks = (np + chunk_size - 1) / chunk_size;
+                amrex::ParallelFor(num_chunks * num_members, [=] AMREX_GPU_DEVICE (amrex::Long n) noexcept
+                {
+                    int const m = int(n % num_members);
+                    int const begin = int(n / num_members) * chunk_size;
+                    int const end = amrex::min(begin + chunk_size, np);
+                    amrex::Real const * const k = k_ptr + 6 * m;
+
+                    bool found = false;
+                    amrex::Real values[num_sums] = {};
+                    for (int i = begin; i < end; ++i) {
+                        if (part_member[i] != m) { continue; }
+                        found = true;
+
+                        // access SoA particle data and weighting, relative to the shift
+                        const amrex::Real p_w = part_w[i];
+                        const amrex::Real p_x = part_x[i] - k[0];
+                        const amrex::Real p_y = part_y[i] - k[1];
+                        const amrex::Real p_t = part_t[i] - k[2];
+                        const amrex::Real p_px = part_px[i] - k[3];
+                        const amrex::Real p_py = part_py[i] - k[4];
+                        const amrex::Real p_pt = part_pt[i] - k[5];
+
+                        values[0] += p_w;
+                        values[1] += p_x*p_w;
+                        values[2] += p_y*p_w;
+                        values[3] += p_t*p_w;
+                        values[4] += p_px*p_w;
+                        values[5] += p_py*p_w;
+                        values[6] += p_pt*p_w;
+                        values[7] += p_x*p_x*p_w;
+                        values[8] += p_y*p_y*p_w;
+                        values[9] += p_t*p_t*p_w;
+                        values[10] += p_px*p_px*p_w;
+                        values[11] += p_py*p_py*p_w;
+                        values[12] += p_pt*p_pt*p_w;
+                        values[13] += p_x*p_px*p_w;
+                        values[14] += p_y*p_py*p_w;
+                        values[15] += p_t*p_pt*p_w;
+                    }
+                    if (!found) { return; }
+
+                    amrex::Real * const msums = sums_ptr + num_sums * m;
+                    for (int j = 0; j < num_sums; ++j) {
+                        amrex::HostDevice::Atomic::Add(msums + j, values[j]);
+                    }
+                });
+            } // end loop over all particle boxes
+        } // env mesh-refinement level loop
+
+        std::vector<amrex::Real> h_sums(sums.size());
+        amrex::Gpu::copyAsync(amrex::Gpu::deviceToHost,
+                              sums.begin(), sums.end(),
+                              h_sums.begin());
+        amrex::Gpu::streamSynchronize();
+
+        // reduced sum over mpi ranks (allreduce)
+        amrex::ParallelAllReduce::Sum(
+            h_sums.data(),
+            int(h_sums.size()),
+            amrex::ParallelDescriptor::Communicator()
         );
 
-        amrex::ParticleReal const x_ms   = values_per_rank_2nd.at(0) /= w_sum;
-        amrex::ParticleReal const y_ms   = values_per_rank_2nd.at(1) /= w_sum;
-        amrex::ParticleReal const t_ms   = values_per_rank_2nd.at(2) /= w_sum;
-        amrex::ParticleReal const px_ms  = values_per_rank_2nd.at(3) /= w_sum;
-        amrex::ParticleReal const py_ms  = values_per_rank_2nd.at(4) /= w_sum;
-        amrex::ParticleReal const pt_ms  = values_per_rank_2nd.at(5) /= w_sum;
-        amrex::ParticleReal const xpx    = values_per_rank_2nd.at(6) /= w_sum;
-        amrex::ParticleReal const ypy    = values_per_rank_2nd.at(7) /= w_sum;
-        amrex::ParticleReal const tpt    = values_per_rank_2nd.at(8) /= w_sum;
-        amrex::ParticleReal const charge = values_per_rank_2nd.at(9);
-        // standard deviations of positions
-        amrex::ParticleReal const sig_x = std::sqrt(x_ms);
-        amrex::ParticleReal const sig_y = std::sqrt(y_ms);
-        amrex::ParticleReal const sig_t = std::sqrt(t_ms);
-        // standard deviations of momenta
-        amrex::ParticleReal const sig_px = std::sqrt(px_ms);
-        amrex::ParticleReal const sig_py = std::sqrt(py_ms);
-        amrex::ParticleReal const sig_pt = std::sqrt(pt_ms);
-        // RMS emittances
-        amrex::ParticleReal const emittance_x = std::sqrt(x_ms*px_ms-xpx*xpx);
-        amrex::ParticleReal const emittance_y = std::sqrt(y_ms*py_ms-ypy*ypy);
-        amrex::ParticleReal const emittance_t = std::sqrt(t_ms*pt_ms-tpt*tpt);
-        // Courant-Snyder (Twiss) beta-function
-        amrex::ParticleReal const beta_x = x_ms / emittance_x;
-        amrex::ParticleReal const beta_y = y_ms / emittance_y;
-        amrex::ParticleReal const beta_t = t_ms / emittance_t;
-        // Courant-Snyder (Twiss) alpha
-        amrex::ParticleReal const alpha_x = - xpx / emittance_x;
-        amrex::ParticleReal const alpha_y = - ypy / emittance_y;
-        amrex::ParticleReal const alpha_t = - tpt / emittance_t;
-
-        std::unordered_map<std::string, amrex::ParticleReal> data;
-        data["s"] = ref_part.s;  // TODO: remove when the output gets rerouted to openPMD
-        data["ref_beta_gamma"] = ref_part.beta_gamma();  // TODO: remove when the output gets rerouted to openPMD
-        data["x_mean"] = x_mean;
-        data["y_mean"] = y_mean;
-        data["t_mean"] = t_mean;
-        data["sig_x"] = sig_x;
-        data["sig_y"] = sig_y;
-        data["sig_t"] = sig_t;
-        data["px_mean"] = px_mean;
-        data["py_mean"] = py_mean;
-        data["pt_mean"] = pt_mean;
-        data["sig_px"] = sig_px;
-        data["sig_py"] = sig_py;
-        data["sig_pt"] = sig_pt;
-        data["emittance_x"] = emittance_x;
-        data["emittance_y"] = emittance_y;
-        data["emittance_t"] = emittance_t;
-        data["alpha_x"] = alpha_x;
-        data["alpha_y"] = alpha_y;
-        data["alpha_t"] = alpha_t;
-        data["beta_x"] = beta_x;
-        data["beta_y"] = beta_y;
-        data["beta_t"] = beta_t;
-        data["charge_C"] = charge;  // TODO: remove when the output gets rerouted to openPMD
+        std::vector<BeamCharacteristics> data(num_members);
+        for (int m = 0; m < num_members; ++m) {
+            BeamMoments moments;
+            moments.ref_part = pc.GetEnsembleRefParticle(m);
+            moments.shift = pc.EnsembleMomentsShift(m);
+            std::copy(h_sums.begin() + num_sums * m, h_sums.begin() + num_sums * (m + 1),
+                      moments.sums.begin());
+
+            data[m] = beam_characteristics(moments);
+
+            // keep the old shift if there are no particles left
+            if (moments.sums[0] > 0.0) {
+                pc.EnsembleMomentsShift(m) = {data[m].x_mean, data[m].y_mean, data[m].t_mean,
+                                              data[m].px_mean, data[m].py_mean, data[m].pt_mean};
+            }
+        }
 
         return data;
     }
@@ -20,6 +20,9 @@ namespace impactx
         int step
     ) const
     {
+        // user code can mark particles as lost without counting them
+        pc.MayHaveLostParticles(false);
+
         if (m_push == nullptr) {
             // TODO: print if verbose mode is set
             push_all(pc, *this, step, m_threadsafe);
@@ -13,9 +13,13 @@
 #include "particles/ImpactXParticleContainer.H"
 
 #include <ablastr/particles/IndexHandling.H>
+#include <ablastr/warn_manager/WarnManager.H>
 
 #include <AMReX.H>
 #include <AMReX_BLProfiler.H>
+#include <AMReX_GpuDevice.H>
+#include <AMReX_Particle.H>
+#include <AMReX_ParticleTransformation.H>
 #include <AMReX_REAL.H>
 #include <AMReX_ParmParse.H>
 
@@ -24,8 +28,12 @@
 namespace io = openPMD;
 #endif
 
+#include <cstdint>
+#include <future>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 
 namespace impactx::diagnostics
@@ -134,11 +142,132 @@ namespace detail
         const auto [record_name, component_name] = name2openPMD(std::move(comp_name));
         return species[record_name][component_name];
     }
+
+    /** A tile of staged particles and its position in the MPI-global particle array */
+    struct StagedTile
+    {
+        uint64_t offset = 0;  //! offset in the MPI-global particle array
+        uint64_t np = 0;      //! number of particles in the tile
+        uint64_t const * ids = nullptr;  //! globally unique particle ids
+        std::vector<amrex::ParticleReal const *> reals;  //! SoA Real components
+    };
+
+    /** Write one iteration of the beam
+     *
+     * Only openPMD-api calls with staged data, so this can run on a
+     * background thread. The data of the tiles must stay valid until this
+     * returns.
+     *
+     * @param series the series to write to
+     * @param step global step, used as iteration index
+     * @param ref_part reference particle
+     * @param np number of beam particles over all MPI ranks
+     * @param real_soa_names names of the SoA Real components
+     * @param tiles staged particle tiles of this MPI rank
+     */
+    void write_beam (
+        io::Series series,
+        int step,
+        RefPart const & ref_part,
+        uint64_t np,
+        std::vector<std::string> const & real_soa_names,
+        std::vector<StagedTile> const & tiles
+    )
+    {
+        BL_PROFILE("impactx::diagnostics::BeamMonitor::write_beam");
+
+        // series & iteration
+        io::WriteIterations iterations = series.writeIterations();
+        io::Iteration iteration = iterations[step];
+        io::ParticleSpecies beam = iteration.particles["beam"];
+
+        // helpers to parse strings to openPMD
+        auto const scalar = openPMD::RecordComponent::SCALAR;
+        auto const getComponentRecord = [&beam](std::string comp_name) {
+            return detail::get_component_record(beam, std::move(comp_name));
+        };
+
+        // define data set and metadata
+        io::Datatype const dtype_fl = io::determineDatatype<amrex::ParticleReal>();
+        io::Datatype const dtype_ui = io::determineDatatype<uint64_t>();
+        auto d_fl = io::Dataset(dtype_fl, {np});
+        auto d_ui = io::Dataset(dtype_ui, {np});
+
+        // reference particle information
+        beam.setAttribute( "beta_ref", ref_part.beta() );
+        beam.setAttribute( "gamma_ref", ref_part.gamma() );
+        beam.setAttribute( "s_ref", ref_part.s );
+        beam.setAttribute( "x_ref", ref_part.x );
+        beam.setAttribute( "y_ref", ref_part.y );
+        beam.setAttribute( "z_ref", ref_part.z );
+        beam.setAttribute( "t_ref", ref_part.t );
+        beam.setAttribute( "px_ref", ref_part.px );
+        beam.setAttribute( "py_ref", ref_part.py );
+        beam.setAttribute( "pz_ref", ref_part.pz );
+        beam.setAttribute( "pt_ref", ref_part.pt );
+        beam.setAttribute( "mass", ref_part.mass );
+        beam.setAttribute( "charge", ref_part.charge );
+
+        // openPMD coarse position: for global coordinates
+        {
+            beam["positionOffset"]["x"].resetDataset(d_fl);
+            beam["positionOffset"]["x"].makeConstant(ref_part.x);
+            beam["positionOffset"]["y"].resetDataset(d_fl);
+            beam["positionOffset"]["y"].makeConstant(ref_part.y);
+            beam["positionOffset"]["t"].resetDataset(d_fl);
+            beam["positionOffset"]["t"].makeConstant(ref_part.t);
+        }
+
+        // SoA: particle ID
+        beam["id"][scalar].resetDataset(d_ui);
+
+        // SoA: Real (positions, momenta and other floating point properties)
+        for (auto const & component_name : real_soa_names) {
+            getComponentRecord(component_name).resetDataset(d_fl);
+        }
+        // SoA: Int
+        static_assert(IntSoA::nattribs == 0); // not yet used
+
+        // store all tiles directly from the staged buffers
+        for (auto const & tile : tiles) {
+            // Do not call storeChunk() with zero-sized particle tiles:
+            //   https://github.com/openPMD/openPMD-api/issues/1147
+            if (tile.np == 0) { continue; }
+
+            beam["id"][scalar].storeChunkRaw(tile.ids, {tile.offset}, {tile.np});
+
+            for (std::size_t real_idx = 0; real_idx < real_soa_names.size(); ++real_idx) {
+                getComponentRecord(real_soa_names[real_idx]).storeChunkRaw(
+                    tile.reals[real_idx], {tile.offset}, {tile.np});
+            }
+        }
+
+        // close iteration: a single flush for all tiles
+        iteration.close();
+    }
 #endif
+
+    void BeamMonitorStaging::wait ()
+    {
+        if (pending.valid()) {
+            BL_PROFILE("impactx::diagnostics::BeamMonitor::wait");
+            pending.get();
+        }
+    }
 } // namespace detail
 
+    void BeamMonitor::wait_all ()
+    {
+        for (auto & [series_name, staging] : m_unique_staging) {
+            staging->wait();
+        }
+    }
+
     void BeamMonitor::finalize ()
     {
+        // complete all writes in flight before the series is closed
+        wait_all();
+
         // close shared series alias
         if (m_series.has_value())
         {
@@ -147,6 +276,21 @@ namespace detail
             m_series.reset();
         }
 
+        // release the staging buffers and the communicator of the series
+        if (m_staging)
+        {
+#if defined(ImpactX_USE_OPENPMD) && openPMD_HAVE_MPI==1
+            if (m_staging->comm.has_value()) {
+                auto comm = std::any_cast<MPI_Comm>(m_staging->comm);
+                MPI_Comm_free(&comm);
+                m_staging->comm.reset();
+            }
+#endif
+            m_staging.reset();
+        }
+        if (m_unique_staging.count(m_series_name) != 0u)
+            m_unique_staging.erase(m_series_name);
+
         // remove from unique series map
         if (m_unique_series.count(m_series_name) != 0u)
             m_unique_series.erase(m_series_name);
@@ -167,7 +311,43 @@ namespace detail
 #   else
         m_OpenPMDFileType = "json";
 #   endif
+#endif
+
+        // Ensure m_staging is the same for the same names.
+        if (m_unique_staging.count(m_series_name) == 0u) {
+            m_staging = std::make_shared<detail::BeamMonitorStaging>();
+            amrex::ParmParse("diag").queryAdd("async_io", m_staging->async);
+
+            // HDF5 and the JSON backend must only be called from one thread at a time
+            if (m_staging->async && m_OpenPMDFileType != "bp") {
+                ablastr::warn_manager::WMRecordWarning(
+                    "BeamMonitor",
+                    "diag.async_io is ignored for the " + m_OpenPMDFileType +
+                    " backend of series " + m_series_name + ", it requires ADIOS2 (bp).",
+                    ablastr::warn_manager::WarnPriority::low);
+                m_staging->async = false;
+            }
 
+#ifdef AMREX_USE_MPI
+            // the background thread calls MPI in openPMD flushes
+            int thread_level = MPI_THREAD_SINGLE;
+            MPI_Query_thread(&thread_level);
+            if (m_staging->async && thread_level < MPI_THREAD_MULTIPLE) {
+                ablastr::warn_manager::WMRecordWarning(
+                    "BeamMonitor",
+                    "diag.async_io is ignored because MPI was not initialized "
+                    "with MPI_THREAD_MULTIPLE.",
+                    ablastr::warn_manager::WarnPriority::low);
+                m_staging->async = false;
+            }
+#endif
+            m_unique_staging[m_series_name] = m_staging;
+        }
+        else {
+            m_staging = m_unique_staging[m_series_name];
+        }
+
+#ifdef ImpactX_USE_OPENPMD
         // encoding of iterations in the series
         openPMD::IterationEncoding series_encoding = openPMD::IterationEncoding::groupBased;
         if ( "v" == encoding )
@@ -181,8 +361,15 @@ namespace detail
         amrex::ParmParse pp_diag("diag");
         pp_diag.queryAdd("file_min_digits", m_file_min_digits);
 
+        // openPMD-api / backend options, e.g., for ADIOS2 engines like SST or BP5
+        std::string openpmd_config = "adios2.engine.usesteps = true";
+        pp_diag.queryAdd("openpmd_config", openpmd_config);
+
         // Ensure m_series is the same for the same names.
         if (m_unique_series.count(m_series_name) == 0u) {
+            // no openPMD-api calls while a background write is in flight
+            wait_all();
+
             std::string filepath = "diags/openPMD/";
             filepath.append(m_series_name);
 
@@ -198,11 +385,25 @@ namespace detail
             filepath = openPMD::auxiliary::replace_all(filepath, "/", "\\");
 #   endif
 
-            auto series = io::Series(filepath, io::Access::CREATE
 #   if openPMD_HAVE_MPI==1
-                , amrex::ParallelDescriptor::Communicator()
+            // background flushes use their own communicator
+            MPI_Comm comm = amrex::ParallelDescriptor::Communicator();
+            if (m_staging->async) {
+                MPI_Comm_dup(amrex::ParallelDescriptor::Communicator(), &comm);
+                m_staging->comm = comm;
+            }
+#   endif
+
+            // continue the series of the interrupted run after a restart from a checkpoint
+            std::string restart_file;
+            amrex::ParmParse("checkpoint").query("restart", restart_file);
+            io::Access const access = restart_file.empty() ? io::Access::CREATE : io::Access::APPEND;
+
+            auto series = io::Series(filepath, access
+#   if openPMD_HAVE_MPI==1
+                , comm
 #   endif
-                , "adios2.engine.usesteps = true"
+                , openpmd_config
             );
             series.setSoftware("ImpactX", IMPACTX_VERSION);
             series.setIterationEncoding( series_encoding );
@@ -217,93 +418,6 @@ namespace detail
 #endif
     }
 
-    void BeamMonitor::prepare (
-        PinnedContainer & pc,
-        RefPart const & ref_part,
-        int step
-    ) {
-#ifdef ImpactX_USE_OPENPMD
-        m_step = step;
-
-        // series & iteration
-        auto series = std::any_cast<io::Series>(m_series);
-        io::WriteIterations iterations = series.writeIterations();
-        io::Iteration iteration = iterations[m_step];
-        io::ParticleSpecies beam = iteration.particles["beam"];
-
-        // calculate & update particle offset in MPI-global particle array, per level
-        auto const num_levels = pc.finestLevel() + 1;
-        m_offset = std::vector<uint64_t>(num_levels);
-        auto counter = detail::ImpactXParticleCounter(pc);
-        auto const np = counter.GetTotalNumParticles();
-        for (auto currentLevel = 0; currentLevel < num_levels; currentLevel++) {
-            m_offset.at(currentLevel) = static_cast<uint64_t>( counter.m_ParticleOffsetAtRank[currentLevel] );
-        }
-
-        // helpers to parse strings to openPMD
-        auto const scalar = openPMD::RecordComponent::SCALAR;
-        auto const getComponentRecord = [&beam](std::string comp_name) {
-            return detail::get_component_record(beam, std::move(comp_name));
-        };
-
-        // define data set and metadata
-        io::Datatype const dtype_fl = io::determineDatatype<amrex::ParticleReal>();
-        io::Datatype const dtype_ui = io::determineDatatype<uint64_t>();
-        auto d_fl = io::Dataset(dtype_fl, {np});
-        auto d_ui = io::Dataset(dtype_ui, {np});
-
-        // AoS: Real
-        {
-            std::vector<std::string> real_aos_names = get_RealAoS_names();
-            for (auto real_idx=0; real_idx < RealAoS::nattribs; real_idx++) {
-                auto const component_name = real_aos_names.at(real_idx);
-                getComponentRecord(component_name).resetDataset(d_fl);
-            }
-        }
-
-        // reference particle information
-        beam.setAttribute( "beta_ref", ref_part.beta() );
-        beam.setAttribute( "gamma_ref", ref_part.gamma() );
-        beam.setAttribute( "s_ref", ref_part.s );
-        beam.setAttribute( "x_ref", ref_part.x );
-        beam.setAttribute( "y_ref", ref_part.y );
-        beam.setAttribute( "z_ref", ref_part.z );
-        beam.setAttribute( "t_ref", ref_part.t );
-        beam.setAttribute( "px_ref", ref_part.px );
-        beam.setAttribute( "py_ref", ref_part.py );
-        beam.setAttribute( "pz_ref", ref_part.pz );
-        beam.setAttribute( "pt_ref", ref_part.pt );
-        beam.setAttribute( "mass", ref_part.mass );
-        beam.setAttribute( "charge", ref_part.charge );
-
-        // openPMD coarse position: for global coordinates
-        {
-            beam["positionOffset"]["x"].resetDataset(d_fl);
-            beam["positionOffset"]["x"].makeConstant(ref_part.x);
-            beam["positionOffset"]["y"].resetDataset(d_fl);
-            beam["positionOffset"]["y"].makeConstant(ref_part.y);
-            beam["positionOffset"]["t"].resetDataset(d_fl);
-            beam["positionOffset"]["t"].makeConstant(ref_part.t);
-        }
-
-        // AoS: Int
-        beam["id"][scalar].resetDataset(d_ui);
-
-        // SoA: Real
-        {
-            std::vector<std::string> real_soa_names = get_RealSoA_names(pc.NumRealComps());
-            for (auto real_idx = 0; real_idx < pc.NumRealComps(); real_idx++) {
-                auto const component_name = real_soa_names.at(real_idx);
-                getComponentRecord(component_name).resetDataset(d_fl);
-            }
-        }
-        // SoA: Int
-        static_assert(IntSoA::nattribs == 0); // not yet used
-#else
-        amrex::ignore_unused(pc, step);
-#endif
-    }
-
     void
     BeamMonitor::operator() (
         ImpactXParticleContainer & pc,
@@ -314,150 +428,93 @@ namespace detail
         BL_PROFILE(profile_name);
 
         // preparing to access reference particle data: RefPart
-        RefPart & ref_part = pc.GetRefParticle();
-
-        // pinned memory copy
-        PinnedContainer pinned_pc = pc.make_alike<amrex::PinnedArenaAllocator>();
-        pinned_pc.copyParticles(pc, true);  // no filtering
-
-        // TODO: filtering
-        /*
-        using SrcData = WarpXParticleContainer::ParticleTileType::ConstParticleTileDataType;
-        tmp.copyParticles(*pc,
-                          [=] AMREX_GPU_HOST_DEVICE (const SrcData& src, int ip, const amrex::RandomEngine& engine)
-                          {
-                              const SuperParticleType& p = src.getSuperParticle(ip);
-                              return random_filter(p, engine) * uniform_filter(p, engine)
-                                     * parser_filter(p, engine) * geometry_filter(p, engine);
-                          }, true);
-        */
-
-        // prepare element access & write reference particle
-        this->prepare(pinned_pc, ref_part, step);
+        RefPart const ref_part = pc.GetRefParticle();
 
-        // loop over refinement levels
-        int const nLevel = pinned_pc.finestLevel();
-        for (int lev = 0; lev <= nLevel; ++lev)
-        {
-            // loop over all particle boxes
-            //using ParIt = ImpactXParticleContainer::iterator;
-            using ParIt = PinnedContainer::ParIterType;
-            // note: openPMD-api is not thread-safe, so do not run OMP parallel here
-            for (ParIt pti(pinned_pc, lev); pti.isValid(); ++pti) {
-                // write beam particles relative to reference particle
-                this->operator()(pti, ref_part);
-            } // end loop over all particle boxes
-        } // end mesh-refinement level loop
-
-        auto series = std::any_cast<io::Series>(m_series);
-        io::WriteIterations iterations = series.writeIterations();
-        io::Iteration iteration = iterations[m_step];
-
-        // close iteration
-        iteration.close();
-    }
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(m_staging != nullptr,
+            "BeamMonitor: output after finalize() for series " + m_series_name);
 
-    void
-    BeamMonitor::operator() (
-        PinnedContainer::ParIterType & pti,
-        RefPart const & ref_part
-    )
-    {
-#ifdef ImpactX_USE_OPENPMD
-        int const currentLevel = pti.GetLevel();
-
-        auto & offset = m_offset.at(currentLevel); // ...
-
-        // preparing access to particle data: AoS
-        auto& aos = pti.GetArrayOfStructs();
+        // pinned memory copy: overlaps with the write of the other buffer
+        auto & staging = *m_staging;
+        auto & pinned_pc = staging.buffers[staging.next];
+        if (!pinned_pc) {
+            pinned_pc = std::make_unique<PinnedContainer>(pc.make_alike<amrex::PinnedArenaAllocator>());
+        }
 
-        // series & iteration
-        auto series = std::any_cast<io::Series>(m_series);
-        io::WriteIterations iterations = series.writeIterations();
-        io::Iteration iteration = iterations[m_step];
+        // copy all particles (no filtering) and convert the ids to globally
+        // unique IDs in the same kernel
+        //   TODO: filtering
+        using SrcData = ImpactXParticleContainer::ParticleTileType::ConstParticleTileDataType;
+        using DstData = PinnedContainer::ParticleTileType::ParticleTileDataType;
+        pinned_pc->clearParticles();
+        for (int lev = 0; lev <= pc.finestLevel(); ++lev) {
+            for (auto const & [index, src_tile] : pc.GetParticles(lev)) {
+                auto & dst_tile = pinned_pc->DefineAndReturnParticleTile(lev, index.first, index.second);
+                dst_tile.resize(src_tile.numParticles());
+                amrex::transformParticles(dst_tile, src_tile,
+                    [=] AMREX_GPU_HOST_DEVICE (DstData const & dst, SrcData const & src, int src_i, int dst_i) noexcept
+                    {
+                        amrex::copyParticle(dst, src, src_i, dst_i);
+                        uint64_t const idcpu = src.m_idcpu[src_i];
+                        dst.m_idcpu[dst_i] = ablastr::particles::localIDtoGlobal(
+                            static_cast<int>(amrex::ConstParticleIDWrapper{idcpu}),
+                            static_cast<int>(amrex::ConstParticleCPUWrapper{idcpu}));
+                    });
+            }
+        }
+        amrex::Gpu::streamSynchronize();
 
-        // writing
-        io::ParticleSpecies beam = iteration.particles["beam"];
+        // openPMD-api is called by one output at a time
+        wait_all();
 
-        auto const numParticleOnTile = pti.numParticles();
-        uint64_t const numParticleOnTile64 = static_cast<uint64_t>( numParticleOnTile );
+#ifdef ImpactX_USE_OPENPMD
+        // calculate particle offset in MPI-global particle array, per level
+        auto counter = detail::ImpactXParticleCounter(*pinned_pc);
+        uint64_t const np = counter.GetTotalNumParticles();
 
-        // Do not call storeChunk() with zero-sized particle tiles:
-        //   https://github.com/openPMD/openPMD-api/issues/1147
-        //if (numParticleOnTile == 0) continue;
+        std::vector<std::string> const real_soa_names = get_RealSoA_names(pinned_pc->NumRealComps());
 
-        auto const scalar = openPMD::RecordComponent::SCALAR;
-        auto const getComponentRecord = [&beam](std::string comp_name) {
-            return detail::get_component_record(beam, std::move(comp_name));
-        };
-
-        // AoS: position and particle ID
+        // loop over refinement levels
+        std::vector<detail::StagedTile> tiles;
+        int const nLevel = pinned_pc->finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev)
         {
-            using vs = std::vector<std::string>;
-            vs const positionComponents{"x", "y", "t"}; // TODO: generalize
-            for (auto currDim = 0; currDim < AMREX_SPACEDIM; currDim++) {
-                std::shared_ptr<amrex::ParticleReal> const curr(
-                    new amrex::ParticleReal[numParticleOnTile],
-                    [](amrex::ParticleReal const *p) { delete[] p; }
-                );
-                for (auto i = 0; i < numParticleOnTile; i++) {
-                    curr.get()[i] = aos[i].pos(currDim);
-                }
-                std::string const& positionComponent = positionComponents[currDim];
-                beam["position"][positionComponent].storeChunk(curr, {offset},
-                                                               {numParticleOnTile64});
-            }
+            auto offset = static_cast<uint64_t>(counter.m_ParticleOffsetAtRank[lev]);
 
-            // save particle ID after converting it to a globally unique ID
-            std::shared_ptr<uint64_t> const ids(
-                new uint64_t[numParticleOnTile],
-                [](uint64_t const *p) { delete[] p; }
-            );
-            for (auto i = 0; i < numParticleOnTile; i++) {
-                ids.get()[i] = ablastr::particles::localIDtoGlobal(aos[i].id(), aos[i].cpu());
-            }
-            beam["id"][scalar].storeChunk(ids, {offset}, {numParticleOnTile64});
-        }
+            // loop over all particle boxes
+            using ParIt = PinnedContainer::ParIterType;
+            for (ParIt pti(*pinned_pc, lev); pti.isValid(); ++pti) {
+                auto & soa = pti.GetStructOfArrays();
+                auto const np_tile = static_cast<uint64_t>(pti.numParticles());
 
-        // SoA: everything else
-        auto const& soa = pti.GetStructOfArrays();
-        //   SoA floating point (ParticleReal) properties
-        {
-            std::vector<std::string> real_soa_names = get_RealSoA_names(soa.NumRealComps());
-            for (auto real_idx=0; real_idx < soa.NumRealComps(); real_idx++) {
-                auto const component_name = real_soa_names.at(real_idx);
-                getComponentRecord(component_name).storeChunkRaw(
-                soa.GetRealData(real_idx).data(), {offset}, {numParticleOnTile64});
-            }
-        }
-        //   SoA integer (int) properties (not yet used)
-        {
-            static_assert(IntSoA::nattribs == 0); // not yet used
-            /*
-            // comment this in once IntSoA::nattribs is > 0
+                // write beam particles relative to reference particle
+                detail::StagedTile tile;
+                tile.offset = offset;
+                tile.np = np_tile;
+                tile.ids = soa.GetIdCPUData().data();
+                for (int real_idx = 0; real_idx < soa.NumRealComps(); real_idx++) {
+                    tile.reals.push_back(soa.GetRealData(real_idx).data());
+                }
+                tiles.push_back(std::move(tile));
 
-            std::vector<std::string> int_soa_names(IntSoA::names_s.size);
-            std::copy(IntSoA::names_s.begin(), IntSoA::names_s.end(), int_soa_names.begin());
+                offset += np_tile;
+            } // end loop over all particle boxes
+        } // end mesh-refinement level loop
 
-            for (auto int_idx=0; int_idx < RealSoA::nattribs; int_idx++) {
-                auto const component_name = int_soa_names.at(int_idx);
-                getComponentRecord(component_name).storeChunkRaw(
-                    soa.GetIntData(int_idx).data(), {offset}, {numParticleOnTile64});
-            }
-            */
+        auto series = std::any_cast<io::Series>(m_series);
+        if (staging.async) {
+            // note: openPMD-api is not thread-safe, so only this thread calls it until wait_all()
+            staging.pending = std::async(std::launch::async,
+                [series, step, ref_part, np, real_soa_names, tiles = std::move(tiles)]() {
+                    detail::write_beam(series, step, ref_part, np, real_soa_names, tiles);
+                });
+
+            // the buffer in flight must not be changed: stage the next output in the other one
+            staging.next = 1 - staging.next;
+        } else {
+            detail::write_beam(series, step, ref_part, np, real_soa_names, tiles);
         }
-
-        // TODO
-        amrex::ignore_unused(ref_part);
-
-        // needs to be higher for next pti; must be reset for next step via prepare
-        offset += numParticleOnTile64;
-
-        // TODO could be done once after all pti are processed
-        // TODO at that point, we could also close the iteration/step
-        series.flush();
 #else
-        amrex::ignore_unused(pti, ref_part);
+        amrex::ignore_unused(ref_part, step);
 #endif
     }
 
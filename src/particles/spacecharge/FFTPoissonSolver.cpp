@@ -0,0 +1,261 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl, Ji Qiang
+ * License: BSD-3-Clause-LBNL
+ */
+#include "FFTPoissonSolver.H"
+
+#include <ablastr/constant.H>
+
+#include <AMReX_BLProfiler.H>
+#include <AMReX_Box.H>
+#include <AMReX_BoxArray.H>
+#include <AMReX_DistributionMapping.H>
+#include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_GpuLaunch.H>
+#include <AMReX_MFIter.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Vector.H>
+
+#include <cmath>
+#include <stdexcept>
+
+
+namespace impactx::spacecharge
+{
+#ifdef ImpactX_USE_FFT
+namespace
+{
+    /** Primitive of 1/r, integrated in x, y and z
+     *
+     * @param x,y,z position relative to the source (all non-zero)
+     */
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    amrex::Real
+    green_primitive (amrex::Real x, amrex::Real y, amrex::Real z)
+    {
+        using namespace amrex::literals;
+
+        amrex::Real const r = std::sqrt(x*x + y*y + z*z);
+
+        return y*z*std::log(x + r) + x*z*std::log(y + r) + x*y*std::log(z + r)
+               - 0.5_rt*x*x*std::atan(y*z / (x*r))
+               - 0.5_rt*y*y*std::atan(x*z / (y*r))
+               - 0.5_rt*z*z*std::atan(x*y / (z*r));
+    }
+
+    /** Integral of 1/r over the cell of size (hx, hy, hz) centered at (x, y, z)
+     *
+     * @param x,y,z distance between the nodes (all non-negative)
+     * @param hx,hy,hz cell size
+     */
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    amrex::Real
+    integrated_green (amrex::Real x, amrex::Real y, amrex::Real z,
+                      amrex::Real hx, amrex::Real hy, amrex::Real hz)
+    {
+        using namespace amrex::literals;
+
+        amrex::Real const xp = x + 0.5_rt*hx, xm = x - 0.5_rt*hx;
+        amrex::Real const yp = y + 0.5_rt*hy, ym = y - 0.5_rt*hy;
+        amrex::Real const zp = z + 0.5_rt*hz, zm = z - 0.5_rt*hz;
+
+        return green_primitive(xp, yp, zp) - green_primitive(xm, yp, zp)
+             - green_primitive(xp, ym, zp) - green_primitive(xp, yp, zm)
+             + green_primitive(xm, ym, zp) + green_primitive(xm, yp, zm)
+             + green_primitive(xp, ym, zm) - green_primitive(xm, ym, zm);
+    }
+} // anonymous namespace
+
+    FFTPoissonSolver::FFTPoissonSolver () = default;
+
+    FFTPoissonSolver::~FFTPoissonSolver ()
+    {
+        destroy_plans();
+    }
+
+    void FFTPoissonSolver::destroy_plans ()
+    {
+        if (m_defined && m_owner) {
+            ablastr::math::anyfft::DestroyPlan(m_forward_rho);
+            ablastr::math::anyfft::DestroyPlan(m_forward_green);
+            ablastr::math::anyfft::DestroyPlan(m_backward);
+        }
+        m_defined = false;
+    }
+
+    void FFTPoissonSolver::define (amrex::MultiFab const & rho)
+    {
+        BL_PROFILE("impactx::spacecharge::FFTPoissonSolver::define");
+
+        using namespace ablastr::math::anyfft;
+
+        m_ba = rho.boxArray();
+
+        // all nodes of the beam mesh, in one box on the first MPI rank
+        //   all ranks take part in gathering rho to and scattering phi from it
+        amrex::Box const domain = m_ba.minimalBox();
+        amrex::BoxArray const ba_single(domain);
+        amrex::DistributionMapping const dm_single(amrex::Vector<int>{0});
+        m_rho_single.define(ba_single, dm_single, 1, 0);
+        m_phi_single.define(ba_single, dm_single, 1, 0);
+
+        // same number of nodes: keep the plans and the Green's function
+        if (m_defined && domain.length() == m_n) { return; }
+
+        destroy_plans();
+        m_n = domain.length();
+        m_owner = dm_single[0] == amrex::ParallelDescriptor::MyProc();
+
+        // Green's function needs to be recomputed
+        m_green_n = amrex::IntVect{0, 0, 0};
+        m_defined = true;
+
+        // only the owner of the single box performs the FFTs
+        if (!m_owner) { return; }
+
+        // real-to-complex transforms keep half of the frequencies in x
+        amrex::IntVect const real_size = 2 * m_n;
+        long const n_real = long(real_size[0]) * real_size[1] * real_size[2];
+        long const n_complex = long(real_size[0] / 2 + 1) * real_size[1] * real_size[2];
+
+        m_real.resize(n_real);
+        m_rho_hat.resize(n_complex);
+        m_green_hat.resize(n_complex);
+
+        m_forward_rho = CreatePlan(real_size, m_real.dataPtr(),
+                                   reinterpret_cast<Complex*>(m_rho_hat.dataPtr()),
+                                   direction::R2C, AMREX_SPACEDIM);
+        m_forward_green = CreatePlan(real_size, m_real.dataPtr(),
+                                     reinterpret_cast<Complex*>(m_green_hat.dataPtr()),
+                                     direction::R2C, AMREX_SPACEDIM);
+        m_backward = CreatePlan(real_size, m_real.dataPtr(),
+                                reinterpret_cast<Complex*>(m_rho_hat.dataPtr()),
+                                direction::C2R, AMREX_SPACEDIM);
+    }
+
+    void FFTPoissonSolver::compute_green (amrex::RealVect const & cell_size)
+    {
+        BL_PROFILE("impactx::spacecharge::FFTPoissonSolver::compute_green");
+
+        int const nx = m_n[0];
+        int const ny = m_n[1];
+        int const nz = m_n[2];
+        amrex::Real const hx = cell_size[0];
+        amrex::Real const hy = cell_size[1];
+        amrex::Real const hz = cell_size[2];
+        amrex::Real * const AMREX_RESTRICT real = m_real.dataPtr();
+
+        amrex::Box const doubled(amrex::IntVect(0), 2 * m_n - 1);
+        amrex::ParallelFor(doubled,
+            [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+            {
+                // distance in cells: the upper half holds the negative offsets
+                int const di = (i < nx) ? i : 2*nx - i;
+                int const dj = (j < ny) ? j : 2*ny - j;
+                int const dk = (k < nz) ? k : 2*nz - k;
+
+                real[i + 2*nx*(j + 2*ny*k)] = integrated_green(
+                    di*hx, dj*hy, dk*hz, hx, hy, hz);
+            });
+
+        ablastr::math::anyfft::Execute(m_forward_green);
+
+        m_green_n = m_n;
+        m_green_cell_size = cell_size;
+    }
+
+    void FFTPoissonSolver::solve (
+        amrex::MultiFab const & rho,
+        amrex::MultiFab & phi,
+        amrex::Geometry const & geom,
+        amrex::Real gamma
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::FFTPoissonSolver::solve");
+
+        using namespace amrex::literals;
+        using namespace ablastr::constant::SI;
+
+        if (!m_defined || rho.boxArray() != m_ba) {
+            define(rho);
+        }
+
+        // gather rho on the MPI rank of the single box
+        m_rho_single.ParallelCopy(rho);
+
+        // beam rest frame: the longitudinal cell size is stretched by gamma
+        amrex::RealVect const cell_size(geom.CellSize(0), geom.CellSize(1), geom.CellSize(2) * gamma);
+        if (m_owner && (m_n != m_green_n || cell_size != m_green_cell_size)) { compute_green(cell_size); }
+
+        int const nx = m_n[0];
+        int const ny = m_n[1];
+        amrex::IntVect const real_size = 2 * m_n;
+        long const n_real = long(real_size[0]) * real_size[1] * real_size[2];
+        long const n_complex = long(real_size[0] / 2 + 1) * real_size[1] * real_size[2];
+
+        // the FFTs are not normalized
+        amrex::Real const scale = 1.0_rt / (4.0_rt * ablastr::constant::math::pi * ep0 * amrex::Real(n_real));
+
+        amrex::Real * const AMREX_RESTRICT real = m_real.dataPtr();
+        amrex::GpuComplex<amrex::Real> * const AMREX_RESTRICT rho_hat = m_rho_hat.dataPtr();
+        amrex::GpuComplex<amrex::Real> const * const AMREX_RESTRICT green_hat = m_green_hat.dataPtr();
+
+        for (amrex::MFIter mfi(m_rho_single); mfi.isValid(); ++mfi)
+        {
+            amrex::Box const bx = mfi.validbox();
+            amrex::IntVect const lo = bx.smallEnd();
+            auto const rho_arr = m_rho_single.const_array(mfi);
+            auto const phi_arr = m_phi_single.array(mfi);
+
+            // zero-padded charge density on the doubled domain
+            amrex::ParallelFor(n_real, [=] AMREX_GPU_DEVICE (long i) noexcept { real[i] = 0.0_rt; });
+            amrex::ParallelFor(bx,
+                [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+                {
+                    real[(i-lo[0]) + 2*nx*((j-lo[1]) + 2*ny*(k-lo[2]))] = rho_arr(i, j, k);
+                });
+
+            // convolution with the Green's function
+            ablastr::math::anyfft::Execute(m_forward_rho);
+            amrex::ParallelFor(n_complex,
+                [=] AMREX_GPU_DEVICE (long i) noexcept
+                {
+                    rho_hat[i] *= green_hat[i] * scale;
+                });
+            ablastr::math::anyfft::Execute(m_backward);
+
+            amrex::ParallelFor(bx,
+                [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+                {
+                    phi_arr(i, j, k) = real[(i-lo[0]) + 2*nx*((j-lo[1]) + 2*ny*(k-lo[2]))];
+                });
+        }
+
+        // scatter phi to the boxes of all MPI ranks
+        //   guard cells outside of the domain stay zero
+        phi.setVal(0.);
+        phi.ParallelCopy(m_phi_single);
+    }
+#else
+    FFTPoissonSolver::FFTPoissonSolver ()
+    {
+        throw std::runtime_error("algo.poisson_solver = fft requires ImpactX to be compiled with ImpactX_FFT=ON");
+    }
+
+    FFTPoissonSolver::~FFTPoissonSolver () = default;
+
+    void FFTPoissonSolver::solve (
+        amrex::MultiFab const & /* rho */,
+        amrex::MultiFab & /* phi */,
+        amrex::Geometry const & /* geom */,
+        amrex::Real /* gamma */
+    )
+    {
+    }
+#endif
+} // namespace impactx::spacecharge
@@ -19,7 +19,8 @@ namespace impactx::spacecharge
     void ForceFromSelfFields (
         std::unordered_map<int, std::unordered_map<std::string, amrex::MultiFab> > & space_charge_field,
         std::unordered_map<int, amrex::MultiFab> const & phi,
-        amrex::Vector<amrex::Geometry> const & geom
+        amrex::Vector<amrex::Geometry> const & geom,
+        bool longitudinal
     )
     {
         BL_PROFILE("impactx::spacecharge::ForceFromSelfFields");
@@ -55,9 +56,53 @@ namespace impactx::spacecharge
                 amrex::ParallelFor(bx, [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept {
                     scf_arr_x(i, j, k) = inv2dr[0] * (phi_arr(i-1, j, k) - phi_arr(i+1, j, k));
                     scf_arr_y(i, j, k) = inv2dr[1] * (phi_arr(i, j-1, k) - phi_arr(i, j+1, k));
-                    scf_arr_z(i, j, k) = inv2dr[2] * (phi_arr(i, j, k-1) - phi_arr(i, j, k+1));
+                    if (longitudinal) {
+                        scf_arr_z(i, j, k) = inv2dr[2] * (phi_arr(i, j, k-1) - phi_arr(i, j, k+1));
+                    }
                 });
             }
         }
     }
+
+    void RescaleSelfFields (
+        std::unordered_map<int, std::unordered_map<std::string, amrex::MultiFab> > & space_charge_field,
+        amrex::RealBox const & old_domain,
+        amrex::RealBox const & new_domain
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::RescaleSelfFields");
+
+        amrex::GpuArray<amrex::Real, 3> const stretch{AMREX_D_DECL(
+            new_domain.length(0) / old_domain.length(0),
+            new_domain.length(1) / old_domain.length(1),
+            new_domain.length(2) / old_domain.length(2))};
+        if (stretch[0] == 1.0 && stretch[1] == 1.0 && stretch[2] == 1.0) { return; }
+        amrex::Real const volume = stretch[0] * stretch[1] * stretch[2];
+
+        // loop over refinement levels
+        for (auto & level_field : space_charge_field) {
+            auto & scf = level_field.second;
+            int const ng = scf.at("x").nGrow();
+            scf.at("x").mult(stretch[0] / volume, ng);
+            scf.at("y").mult(stretch[1] / volume, ng);
+            scf.at("z").mult(stretch[2] / volume, ng);
+        }
+    }
+
+    void RescaleSelfFields (
+        amrex::GpuArray<amrex::Real, 3> & phi_gradient_scale,
+        amrex::RealBox const & old_domain,
+        amrex::RealBox const & new_domain
+    )
+    {
+        amrex::GpuArray<amrex::Real, 3> const stretch{AMREX_D_DECL(
+            new_domain.length(0) / old_domain.length(0),
+            new_domain.length(1) / old_domain.length(1),
+            new_domain.length(2) / old_domain.length(2))};
+        amrex::Real const volume = stretch[0] * stretch[1] * stretch[2];
+
+        for (int d = 0; d < 3; ++d) {
+            phi_gradient_scale[d] *= stretch[d] * stretch[d] / volume;
+        }
+    }
 } // namespace impactx::spacecharge
@@ -0,0 +1,425 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl
+ * License: BSD-3-Clause-LBNL
+ */
+#include "FusedSpaceCharge.H"
+#include "FieldGather.H"
+
+#include "particles/transformation/ToFixedS.H"
+#include "particles/transformation/ToFixedT.H"
+
+#include <ablastr/constant.H>
+
+#include <AMReX_BLProfiler.H>
+#include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_GpuAtomic.H>
+#include <AMReX_MFIter.H>
+#include <AMReX_ParallelReduce.H>
+#include <AMReX_Reduce.H>
+#include <AMReX_REAL.H>       // for Real
+#include <AMReX_SPACE.H>      // for AMREX_D_DECL
+
+#include <cmath>
+#include <vector>
+
+
+namespace impactx::spacecharge
+{
+namespace
+{
+    /** Nodal shape factors of a particle
+     *
+     * Same as the shape factors that ablastr::particles::deposit_charge uses.
+     * That function reads the particle positions from the container, but the
+     * fixed-t positions here exist only in registers, so the deposition is
+     * repeated in deposit_tile.
+     *
+     * @tparam order particle shape order (1, 2 or 3)
+     * @param[out] sx shape factor on the nodes covered by the particle
+     * @param[in] xmid particle position in units of cells, relative to node 0
+     * @return index of the first node covered by the particle
+     */
+    template<int order>
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    int
+    shape_factor (amrex::Real * const AMREX_RESTRICT sx, amrex::Real xmid)
+    {
+        using namespace amrex::literals;
+
+        static_assert(order >= 1 && order <= 3, "particle shape order can be only 1, 2, or 3");
+
+        if constexpr (order == 1) {
+            int const j = static_cast<int>(std::floor(xmid));
+            amrex::Real const xint = xmid - amrex::Real(j);
+            sx[0] = 1.0_rt - xint;
+            sx[1] = xint;
+            return j;
+        } else if constexpr (order == 2) {
+            int const j = static_cast<int>(std::floor(xmid + 0.5_rt));
+            amrex::Real const xint = xmid - amrex::Real(j);
+            sx[0] = 0.5_rt*(0.5_rt - xint)*(0.5_rt - xint);
+            sx[1] = 0.75_rt - xint*xint;
+            sx[2] = 0.5_rt*(0.5_rt + xint)*(0.5_rt + xint);
+            return j - 1;
+        } else if constexpr (order == 3) {
+            int const j = static_cast<int>(std::floor(xmid));
+            amrex::Real const xint = xmid - amrex::Real(j);
+            sx[0] = 1.0_rt/6.0_rt*(1.0_rt - xint)*(1.0_rt - xint)*(1.0_rt - xint);
+            sx[1] = 2.0_rt/3.0_rt - xint*xint*(1.0_rt - xint/2.0_rt);
+            sx[2] = 2.0_rt/3.0_rt - (1.0_rt - xint)*(1.0_rt - xint)*(1.0_rt - 0.5_rt*(1.0_rt - xint));
+            sx[3] = 1.0_rt/6.0_rt*xint*xint*xint;
+            return j - 1;
+        }
+    }
+
+    /** Deposit the charge of the particles of one tile
+     *
+     * @tparam order particle shape order (1, 2 or 3)
+     */
+    template<int order>
+    void
+    deposit_tile (
+        long np,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_x,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_y,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_t,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_px,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_py,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_pt,
+        amrex::ParticleReal const * const AMREX_RESTRICT part_w,
+        transformation::ToFixedT const to_t,
+        amrex::GpuArray<amrex::Real, 3> const prob_lo,
+        amrex::GpuArray<amrex::Real, 3> const invdr,
+        amrex::Real const q_invvol,
+        amrex::Array4<amrex::Real> const & rho_arr
+    )
+    {
+        amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (long i)
+        {
+            // fixed-t coordinates, in registers only
+            amrex::ParticleReal x = part_x[i];
+            amrex::ParticleReal y = part_y[i];
+            amrex::ParticleReal z = part_t[i];
+            amrex::ParticleReal px = part_px[i];
+            amrex::ParticleReal py = part_py[i];
+            amrex::ParticleReal pz = part_pt[i];
+            to_t(x, y, z, px, py, pz);
+
+            amrex::Real sx[order + 1];
+            amrex::Real sy[order + 1];
+            amrex::Real sz[order + 1];
+            int const i0 = shape_factor<order>(sx, (x - prob_lo[0]) * invdr[0]);
+            int const j0 = shape_factor<order>(sy, (y - prob_lo[1]) * invdr[1]);
+            int const k0 = shape_factor<order>(sz, (z - prob_lo[2]) * invdr[2]);
+
+            amrex::Real const wq = part_w[i] * q_invvol;
+            for (int iz = 0; iz <= order; ++iz) {
+                for (int iy = 0; iy <= order; ++iy) {
+                    for (int ix = 0; ix <= order; ++ix) {
+                        amrex::HostDevice::Atomic::Add(
+                            &rho_arr(i0 + ix, j0 + iy, k0 + iz),
+                            wq * sx[ix] * sy[iy] * sz[iz]);
+                    }
+                }
+            }
+        });
+    }
+} // anonymous namespace
+
+    std::tuple<
+            amrex::ParticleReal, amrex::ParticleReal,
+            amrex::ParticleReal, amrex::ParticleReal,
+            amrex::ParticleReal, amrex::ParticleReal>
+    MinAndMaxPositionsFixedT (ImpactXParticleContainer const & pc)
+    {
+        BL_PROFILE("impactx::spacecharge::MinAndMaxPositionsFixedT");
+
+        transformation::ToFixedT const to_t(pc.GetRefParticle().pt);
+
+        // reduce over the six phase space arrays only, instead of whole
+        // particles as with amrex::ParticleReduce
+        amrex::ReduceOps<
+            amrex::ReduceOpMin, amrex::ReduceOpMin, amrex::ReduceOpMin,
+            amrex::ReduceOpMax, amrex::ReduceOpMax, amrex::ReduceOpMax
+        > reduce_ops;
+        amrex::ReduceData<
+            amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal,
+            amrex::ParticleReal, amrex::ParticleReal, amrex::ParticleReal
+        > reduce_data(reduce_ops);
+        using ReduceTuple = typename decltype(reduce_data)::Type;
+
+        int const nLevel = pc.finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev) {
+            using ParIt = ImpactXParticleContainer::const_iterator;
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                int const np = pti.numParticles();
+
+                auto const & soa_real = pti.GetStructOfArrays().GetRealData();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_t = soa_real[RealSoA::t].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_px = soa_real[RealSoA::px].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_py = soa_real[RealSoA::py].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_pt = soa_real[RealSoA::pt].dataPtr();
+
+                reduce_ops.eval(np, reduce_data, [=] AMREX_GPU_DEVICE (int i) -> ReduceTuple
+                {
+                    amrex::ParticleReal x = part_x[i];
+                    amrex::ParticleReal y = part_y[i];
+                    amrex::ParticleReal z = part_t[i];
+                    amrex::ParticleReal px = part_px[i];
+                    amrex::ParticleReal py = part_py[i];
+                    amrex::ParticleReal pz = part_pt[i];
+                    to_t(x, y, z, px, py, pz);
+
+                    return {x, y, z, x, y, z};
+                });
+            }
+        }
+        ReduceTuple const r = reduce_data.value(reduce_ops);
+
+        std::vector<amrex::ParticleReal> xyz_min = {
+            amrex::get<0>(r),
+            amrex::get<1>(r),
+            amrex::get<2>(r)
+        };
+
+        std::vector<amrex::ParticleReal> xyz_max = {
+            amrex::get<3>(r),
+            amrex::get<4>(r),
+            amrex::get<5>(r)
+        };
+
+        amrex::ParallelAllReduce::Min<amrex::ParticleReal>(
+            xyz_min.data(), xyz_min.size(), amrex::ParallelDescriptor::Communicator());
+        amrex::ParallelAllReduce::Max<amrex::ParticleReal>(
+            xyz_max.data(), xyz_max.size(), amrex::ParallelDescriptor::Communicator());
+
+        return {xyz_min[0], xyz_min[1], xyz_min[2],
+                xyz_max[0], xyz_max[1], xyz_max[2]};
+    }
+
+    void DepositChargeFixedS (
+        ImpactXParticleContainer const & pc,
+        std::unordered_map<int, amrex::MultiFab> & rho
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::DepositChargeFixedS");
+
+        transformation::ToFixedT const to_t(pc.GetRefParticle().pt);
+
+        // in SI [C]
+        amrex::Real const charge = pc.GetRefParticle().charge;
+        int const particle_shape = pc.GetParticleShape();
+        AMREX_ALWAYS_ASSERT_WITH_MESSAGE(particle_shape >= 1 && particle_shape <= 3,
+            "DepositChargeFixedS: algo.particle_shape order can be only 1, 2, or 3");
+
+        // loop over refinement levels
+        int const nLevel = pc.finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev) {
+            amrex::MultiFab & rho_at_level = rho.at(lev);
+            // reset the values in rho to zero
+            rho_at_level.setVal(0.);
+
+            // get simulation geometry information
+            amrex::Geometry const & gm = pc.Geom(lev);
+            auto const prob_lo = gm.ProbLoArray();
+            auto const invdr = gm.InvCellSizeArray();
+            amrex::Real const q_invvol = charge * invdr[0] * invdr[1] * invdr[2];
+
+            // deposit with atomics into the box of the whole level: the
+            // particles are not sorted into tiles at fixed t
+            using ParIt = ImpactXParticleContainer::const_iterator;
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                long const np = pti.numParticles();
+
+                // preparing access to particle data: SoA of Reals
+                auto const & soa_real = pti.GetStructOfArrays().GetRealData();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_t = soa_real[RealSoA::t].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_px = soa_real[RealSoA::px].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_py = soa_real[RealSoA::py].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_pt = soa_real[RealSoA::pt].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_w = soa_real[RealSoA::w].dataPtr();
+
+                auto const rho_arr = rho_at_level.array(pti);
+
+                if (particle_shape == 1) {
+                    deposit_tile<1>(np, part_x, part_y, part_t, part_px, part_py, part_pt, part_w,
+                                    to_t, prob_lo, invdr, q_invvol, rho_arr);
+                } else if (particle_shape == 2) {
+                    deposit_tile<2>(np, part_x, part_y, part_t, part_px, part_py, part_pt, part_w,
+                                    to_t, prob_lo, invdr, q_invvol, rho_arr);
+                } else if (particle_shape == 3) {
+                    deposit_tile<3>(np, part_x, part_y, part_t, part_px, part_py, part_pt, part_w,
+                                    to_t, prob_lo, invdr, q_invvol, rho_arr);
+                }
+            }
+
+            // start async charge communication for this level
+            rho_at_level.SumBoundary_nowait();
+        }
+
+        // finalize communication
+        for (int lev = 0; lev <= nLevel; ++lev)
+        {
+            amrex::MultiFab & rho_at_level = rho.at(lev);
+            rho_at_level.SumBoundary_finish();
+        }
+    }
+
+namespace
+{
+    /** Transform, gather the force, push the momenta and transform back on all levels
+     *
+     * @tparam MakeGather callable (lev, pti, invdr, prob_lo) returning the device
+     *                    functor of the force at a particle position, see FieldGather.H
+     */
+    template <typename MakeGather>
+    void gather_and_push_fixed_s (
+        ImpactXParticleContainer & pc,
+        const amrex::Vector<amrex::Geometry>& geom,
+        amrex::Real const slice_ds,
+        MakeGather const & make_gather
+    )
+    {
+        using namespace amrex::literals;
+
+        RefPart const ref_part = pc.GetRefParticle();
+        amrex::Real const charge = ref_part.charge;
+
+        // coordinate transformations, see CoordinateTransformation
+        transformation::ToFixedT const to_t(ref_part.pt);
+        transformation::ToFixedS const to_s(ref_part.beta_gamma());
+
+        // physical constants and reference quantities
+        using ablastr::constant::SI::c;
+        amrex::Real const mc_SI = ref_part.mass * c;
+        amrex::Real const pz_ref_SI = ref_part.beta_gamma() * mc_SI;
+        amrex::Real const gamma = ref_part.gamma();
+        amrex::Real const inv_gamma2 = 1.0_rt / (gamma * gamma);
+
+        amrex::Real const dt = slice_ds / ref_part.beta() / c;
+
+        // group together constants for the momentum push
+        amrex::Real const push_consts = dt * charge * inv_gamma2 / pz_ref_SI;
+
+        // loop over refinement levels
+        int const nLevel = pc.finestLevel();
+        for (int lev = 0; lev <= nLevel; ++lev)
+        {
+            // get simulation geometry information
+            auto const &gm = geom[lev];
+            auto const dr = gm.CellSizeArray();
+            amrex::GpuArray<amrex::Real, 3> const invdr{AMREX_D_DECL(1_rt/dr[0], 1_rt/dr[1], 1_rt/dr[2])};
+            const auto prob_lo = gm.ProbLoArray();
+
+            // loop over all particle boxes
+            using ParIt = ImpactXParticleContainer::iterator;
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (amrex::Gpu::notInLaunchRegion())
+#endif
+            for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
+                const int np = pti.numParticles();
+
+                // force at the particle position, from the fields of this box
+                auto const gather = make_gather(lev, pti, invdr, prob_lo);
+
+                // preparing access to particle data: SoA of Reals
+                auto& soa_real = pti.GetStructOfArrays().GetRealData();
+                amrex::ParticleReal* const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_t = soa_real[RealSoA::t].dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_px = soa_real[RealSoA::px].dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_py = soa_real[RealSoA::py].dataPtr();
+                amrex::ParticleReal* const AMREX_RESTRICT part_pt = soa_real[RealSoA::pt].dataPtr();
+
+                // transform, gather, push momentum and transform back
+                amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (int i) {
+                    // access SoA Real data
+                    amrex::ParticleReal x = part_x[i];
+                    amrex::ParticleReal y = part_y[i];
+                    amrex::ParticleReal z = part_t[i];
+                    amrex::ParticleReal px = part_px[i];
+                    amrex::ParticleReal py = part_py[i];
+                    amrex::ParticleReal pz = part_pt[i];
+
+                    // from x',y',t to x,y,z
+                    to_t(x, y, z, px, py, pz);
+
+                    // force gather
+                    amrex::GpuArray<amrex::Real, 3> const field_interp = gather(x, y, z);
+
+                    // push momentum
+                    px += field_interp[0] * push_consts;
+                    py += field_interp[1] * push_consts;
+                    pz += field_interp[2] * push_consts;
+
+                    // from x,y,z to x',y',t
+                    to_s(x, y, z, px, py, pz);
+
+                    // assign updated values: z and pz now hold t and pt
+                    part_x[i] = x;
+                    part_y[i] = y;
+                    part_t[i] = z;
+                    part_px[i] = px;
+                    part_py[i] = py;
+                    part_pt[i] = pz;
+                });
+            } // end loop over all particle boxes
+        } // env mesh-refinement level loop
+    }
+} // anonymous namespace
+
+    void GatherAndPushFixedS (
+        ImpactXParticleContainer & pc,
+        std::unordered_map<int, std::unordered_map<std::string, amrex::MultiFab> > const & space_charge_field,
+        const amrex::Vector<amrex::Geometry>& geom,
+        amrex::Real const slice_ds
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::GatherAndPushFixedS");
+
+        gather_and_push_fixed_s(pc, geom, slice_ds,
+            [&space_charge_field](int lev, amrex::MFIter const & pti,
+                                  amrex::GpuArray<amrex::Real, 3> const & invdr,
+                                  amrex::GpuArray<amrex::Real, 3> const & prob_lo)
+            {
+                auto const & scf = space_charge_field.at(lev);
+                return StoredFieldGather{
+                    scf.at("x").const_array(pti), scf.at("y").const_array(pti), scf.at("z").const_array(pti),
+                    invdr, prob_lo};
+            });
+    }
+
+    void GatherAndPushFixedS (
+        ImpactXParticleContainer & pc,
+        std::unordered_map<int, amrex::MultiFab> const & phi,
+        amrex::GpuArray<amrex::Real, 3> const & phi_gradient_scale,
+        const amrex::Vector<amrex::Geometry>& geom,
+        amrex::Real const slice_ds
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::GatherAndPushFixedS");
+
+        gather_and_push_fixed_s(pc, geom, slice_ds,
+            [&phi, phi_gradient_scale](int lev, amrex::MFIter const & pti,
+                                       amrex::GpuArray<amrex::Real, 3> const & invdr,
+                                       amrex::GpuArray<amrex::Real, 3> const & prob_lo)
+            {
+                return PhiGradientGather{phi.at(lev).const_array(pti), invdr, prob_lo, phi_gradient_scale};
+            });
+    }
+} // namespace impactx::spacecharge
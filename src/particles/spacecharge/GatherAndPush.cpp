@@ -8,30 +8,38 @@
  * License: BSD-3-Clause-LBNL
  */
 #include "GatherAndPush.H"
-
-#include <ablastr/particles/NodalFieldGather.H>
+#include "FieldGather.H"
 
 #include <AMReX_BLProfiler.H>
+#include <AMReX_MFIter.H>
 #include <AMReX_REAL.H>       // for Real
 #include <AMReX_SPACE.H>      // for AMREX_D_DECL
 
 
 namespace impactx::spacecharge
 {
-    void GatherAndPush (
+namespace
+{
+    /** Gather the force and push the particle momenta of all levels
+     *
+     * @tparam MakeGather callable (lev, pti, invdr, prob_lo) returning the device
+     *                    functor of the force at a particle position, see FieldGather.H
+     */
+    template <typename MakeGather>
+    void gather_and_push (
         ImpactXParticleContainer & pc,
-        std::unordered_map<int, std::unordered_map<std::string, amrex::MultiFab> > const & space_charge_field,
         const amrex::Vector<amrex::Geometry>& geom,
-        amrex::ParticleReal const slice_ds
+        amrex::Real const slice_ds,
+        MakeGather const & make_gather
     )
     {
-        BL_PROFILE("impactx::spacecharge::GatherAndPush");
-
         using namespace amrex::literals;
 
-        amrex::ParticleReal const charge = pc.GetRefParticle().charge;
+        amrex::Real const charge = pc.GetRefParticle().charge;
 
         // loop over refinement levels
+        //   particles are on the finest level that covers their position and
+        //   gather the field of this level
         int const nLevel = pc.finestLevel();
         for (int lev = 0; lev <= nLevel; ++lev)
         {
@@ -49,51 +57,42 @@ namespace impactx::spacecharge
             for (ParIt pti(pc, lev); pti.isValid(); ++pti) {
                 const int np = pti.numParticles();
 
-                // get the device pointer-wrapper Array4 for 3D field access
-                auto const scf_arr_x = space_charge_field.at(lev).at("x")[pti].array();
-                auto const scf_arr_y = space_charge_field.at(lev).at("y")[pti].array();
-                auto const scf_arr_z = space_charge_field.at(lev).at("z")[pti].array();
+                // force at the particle position, from the fields of this box
+                auto const gather = make_gather(lev, pti, invdr, prob_lo);
 
                 // physical constants and reference quantities
-                amrex::ParticleReal const c0_SI = 2.99792458e8;  // TODO move out
-                amrex::ParticleReal const mc_SI = pc.GetRefParticle().mass * c0_SI;
-                amrex::ParticleReal const pz_ref_SI = pc.GetRefParticle().beta_gamma() * mc_SI;
-                amrex::ParticleReal const gamma = pc.GetRefParticle().gamma();
-                amrex::ParticleReal const inv_gamma2 = 1.0_prt / (gamma * gamma);
-
-                amrex::ParticleReal const dt = slice_ds / pc.GetRefParticle().beta() / c0_SI;
+                amrex::Real const c0_SI = 2.99792458e8;  // TODO move out
+                amrex::Real const mc_SI = pc.GetRefParticle().mass * c0_SI;
+                amrex::Real const pz_ref_SI = pc.GetRefParticle().beta_gamma() * mc_SI;
+                amrex::Real const gamma = pc.GetRefParticle().gamma();
+                amrex::Real const inv_gamma2 = 1.0_rt / (gamma * gamma);
 
-                // preparing access to particle data: AoS
-                using PType = ImpactXParticleContainer::ParticleType;
-                auto const & aos = pti.GetArrayOfStructs();
-                PType const * const AMREX_RESTRICT aos_ptr = aos().dataPtr();
+                amrex::Real const dt = slice_ds / pc.GetRefParticle().beta() / c0_SI;
 
                 // preparing access to particle data: SoA of Reals
                 auto& soa_real = pti.GetStructOfArrays().GetRealData();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_x = soa_real[RealSoA::x].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_y = soa_real[RealSoA::y].dataPtr();
+                amrex::ParticleReal const * const AMREX_RESTRICT part_z = soa_real[RealSoA::z].dataPtr(); // note: currently for a fixed t
                 amrex::ParticleReal* const AMREX_RESTRICT part_px = soa_real[RealSoA::px].dataPtr();
                 amrex::ParticleReal* const AMREX_RESTRICT part_py = soa_real[RealSoA::py].dataPtr();
                 amrex::ParticleReal* const AMREX_RESTRICT part_pz = soa_real[RealSoA::pz].dataPtr(); // note: currently for a fixed t
 
                 // group together constants for the momentum push
-                amrex::ParticleReal const push_consts = dt * charge * inv_gamma2 / pz_ref_SI;
+                amrex::Real const push_consts = dt * charge * inv_gamma2 / pz_ref_SI;
 
                 // gather to each particle and push momentum
                 amrex::ParallelFor(np, [=] AMREX_GPU_DEVICE (int i) {
-                    // access AoS data such as positions and cpu/id
-                    PType const & AMREX_RESTRICT p = aos_ptr[i];
-
                     // access SoA Real data
+                    amrex::ParticleReal const x = part_x[i];
+                    amrex::ParticleReal const y = part_y[i];
+                    amrex::ParticleReal const z = part_z[i];
                     amrex::ParticleReal & AMREX_RESTRICT px = part_px[i];
                     amrex::ParticleReal & AMREX_RESTRICT py = part_py[i];
                     amrex::ParticleReal & AMREX_RESTRICT pz = part_pz[i];
 
                     // force gather
-                    amrex::GpuArray<amrex::Real, 3> const field_interp =
-                        ablastr::particles::doGatherVectorFieldNodal (
-                            p.pos(RealAoS::x), p.pos(RealAoS::y), p.pos(RealAoS::t),
-                            scf_arr_x, scf_arr_y, scf_arr_z,
-                            invdr,
-                            prob_lo);
+                    amrex::GpuArray<amrex::Real, 3> const field_interp = gather(x, y, z);
 
                     // push momentum
                     px += field_interp[0] * push_consts;
@@ -105,6 +104,47 @@ namespace impactx::spacecharge
 
 
             } // end loop over all particle boxes
-        } // env mesh-refinement level loop
+        } // end mesh-refinement level loop
+    }
+} // anonymous namespace
+
+    void GatherAndPush (
+        ImpactXParticleContainer & pc,
+        std::unordered_map<int, std::unordered_map<std::string, amrex::MultiFab> > const & space_charge_field,
+        const amrex::Vector<amrex::Geometry>& geom,
+        amrex::Real const slice_ds
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::GatherAndPush");
+
+        gather_and_push(pc, geom, slice_ds,
+            [&space_charge_field](int lev, amrex::MFIter const & pti,
+                                  amrex::GpuArray<amrex::Real, 3> const & invdr,
+                                  amrex::GpuArray<amrex::Real, 3> const & prob_lo)
+            {
+                auto const & scf = space_charge_field.at(lev);
+                return StoredFieldGather{
+                    scf.at("x").const_array(pti), scf.at("y").const_array(pti), scf.at("z").const_array(pti),
+                    invdr, prob_lo};
+            });
+    }
+
+    void GatherAndPush (
+        ImpactXParticleContainer & pc,
+        std::unordered_map<int, amrex::MultiFab> const & phi,
+        amrex::GpuArray<amrex::Real, 3> const & phi_gradient_scale,
+        const amrex::Vector<amrex::Geometry>& geom,
+        amrex::Real const slice_ds
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::GatherAndPush");
+
+        gather_and_push(pc, geom, slice_ds,
+            [&phi, phi_gradient_scale](int lev, amrex::MFIter const & pti,
+                                       amrex::GpuArray<amrex::Real, 3> const & invdr,
+                                       amrex::GpuArray<amrex::Real, 3> const & prob_lo)
+            {
+                return PhiGradientGather{phi.at(lev).const_array(pti), invdr, prob_lo, phi_gradient_scale};
+            });
     }
 } // namespace impactx::spacecharge
@@ -8,117 +8,297 @@
  * License: BSD-3-Clause-LBNL
  */
 #include "PoissonSolve.H"
+#include "SpaceChargeAlgo.H"
 
 #include <ablastr/constant.H>
-#include <ablastr/fields/PoissonSolver.H>
+#include <ablastr/warn_manager/WarnManager.H>
 
+#include <AMReX_BCRec.H>
+#include <AMReX_BC_TYPES.H>
+#include <AMReX_BLassert.H>
 #include <AMReX_BLProfiler.H>
-#include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_FillPatchUtil.H>
+#include <AMReX_GpuDevice.H>
+#include <AMReX_Interpolater.H>
 #include <AMReX_LO_BCTYPES.H>
+#include <AMReX_MLLinOp.H>
+#include <AMReX_ParallelDescriptor.H>
 #include <AMReX_ParmParse.H>
-#include <AMReX_REAL.H>       // for ParticleReal
+#include <AMReX_PhysBCFunct.H>
+#include <AMReX_Print.H>
+#include <AMReX_REAL.H>       // for Real
+#include <AMReX_Utility.H>       // for second
+#include <AMReX_Vector.H>
 
 #include <cmath>
+#include <stdexcept>
+#include <string>
 
 
 namespace impactx::spacecharge
 {
-    void PoissonSolve (
-        ImpactXParticleContainer const & pc,
-        std::unordered_map<int, amrex::MultiFab> & rho,
-        std::unordered_map<int, amrex::MultiFab> & phi
-    )
+    PoissonSolver::PoissonSolver ()
     {
-        using namespace amrex::literals;
+        amrex::ParmParse pp_algo("algo");
+        pp_algo.queryAdd("poisson_solver", m_poisson_solver);
+        if (get_space_charge_algo() == SpaceChargeAlgo::True_2p5D) {
+            m_transverse = std::make_unique<TransverseFFTPoissonSolver>();
+        } else if (m_poisson_solver == "fft") {
+            m_fft = std::make_unique<FFTPoissonSolver>();
+        } else if (m_poisson_solver != "multigrid") {
+            throw std::runtime_error("algo.poisson_solver = " + m_poisson_solver +
+                                     " is not supported (use: multigrid, fft)");
+        }
 
-        // set space charge field to zero
-        //   loop over refinement levels
-        int const finest_level = phi.size() - 1u;
-        for (int lev = 0; lev <= finest_level; ++lev) {
-            amrex::MultiFab &phi_at_level = phi.at(lev);
-            // reset the values in phi to zero
-            phi_at_level.setVal(0.);
+        pp_algo.queryAdd("mlmg_relative_tolerance", m_relative_tolerance);
+        pp_algo.queryAdd("mlmg_absolute_tolerance", m_absolute_tolerance);
+        pp_algo.queryAdd("mlmg_max_iters", m_max_iters);
+        pp_algo.queryAdd("mlmg_verbosity", m_verbosity);
+        pp_algo.queryAdd("mlmg_warm_start", m_warm_start);
+
+        amrex::ParmParse pp_diag("diag");
+        pp_diag.queryAdd("performance_counters", m_timed);
+
+        // the MLMG operator is only reused while the mesh is kept
+        if (!m_transverse && !m_fft) {
+            amrex::ParmParse pp_geometry("geometry");
+            bool dynamic_size = true;
+            pp_geometry.query("dynamic_size", dynamic_size);
+            amrex::Real hysteresis = 0.0;
+            pp_geometry.query("dynamic_size_hysteresis", hysteresis);
+            if (dynamic_size && hysteresis == 0.0) {
+                ablastr::warn_manager::WMRecordWarning(
+                    "PoissonSolver",
+                    "The mesh is resized for every space charge calculation, so the "
+                    "MLMG operator is rebuilt for every solve. Set "
+                    "geometry.dynamic_size_hysteresis > 0 to keep the mesh and reuse "
+                    "the operator while the beam size changes little.",
+                    ablastr::warn_manager::WarnPriority::low);
+            }
+        }
+    }
+
+    bool PoissonSolver::is_defined_for (
+        int lev,
+        amrex::Geometry const & geom,
+        amrex::BoxArray const & ba,
+        amrex::DistributionMapping const & dm,
+        amrex::Real beta_s
+    ) const
+    {
+        if (lev >= int(m_levels.size()) || !m_levels[lev].linop) { return false; }
+        LevelOperator const & op = m_levels[lev];
+
+        bool same_geom = geom.Domain() == op.geom.Domain();
+        for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+            same_geom = same_geom &&
+                        geom.ProbLo(d) == op.geom.ProbLo(d) &&
+                        geom.ProbHi(d) == op.geom.ProbHi(d);
         }
 
-        // prepare parameters of the MLMG Poisson Solver
-        //   relativistic beta=v/c of the reference particle
-        amrex::ParticleReal const pt_ref = pc.GetRefParticle().pt;
-        amrex::ParticleReal const beta_s = std::sqrt(1.0_prt - 1.0_prt/std::pow(pt_ref, 2));
+        return same_geom && ba == op.ba && dm == op.dm && beta_s == op.beta_s;
+    }
+
+    void PoissonSolver::define (
+        int lev,
+        amrex::Geometry const & geom,
+        amrex::BoxArray const & ba,
+        amrex::DistributionMapping const & dm,
+        amrex::Real beta_s
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::PoissonSolver::define");
+
+        if (lev >= int(m_levels.size())) { m_levels.resize(lev + 1); }
+        LevelOperator & op = m_levels[lev];
+
+        // the MLMG object refers to the operator: release it first
+        op.mlmg.reset();
+        op.linop.reset();
+
         // The beam particles and the corresponding box are all given in local coordinates
         // in which z is the direction of motion - this coincides with the direction of the momentum
         // of the reference particle.
         // After every T-to-Z transformation, Z aligns with the tangential vector of our reference
         // particle.
-        std::array<amrex::Real, 3> const beta_xyz = {0.0, 0.0, beta_s};
+        amrex::Array<amrex::Real, AMREX_SPACEDIM> const beta_xyz = {0.0, 0.0, beta_s};
 
-        amrex::ParmParse pp_algo("algo");
-        amrex::Real mlmg_relative_tolerance = 1.e-7; // relative TODO: make smaller for SP
-        amrex::Real mlmg_absolute_tolerance = 0.0;   // ignored
-        pp_algo.queryAdd("mlmg_relative_tolerance", mlmg_relative_tolerance);
-        pp_algo.queryAdd("mlmg_absolute_tolerance", mlmg_absolute_tolerance);
-
-        int mlmg_max_iters = 100;
-        int mlmg_verbosity = 1;
-        pp_algo.queryAdd("mlmg_max_iters", mlmg_max_iters);
-        pp_algo.queryAdd("mlmg_verbosity", mlmg_verbosity);
-
-        struct PoissonBoundaryHandler {
-            amrex::Array<amrex::LinOpBCType, AMREX_SPACEDIM> const lobc = {
-                amrex::LinOpBCType::Dirichlet,
-                amrex::LinOpBCType::Dirichlet,
-                amrex::LinOpBCType::Dirichlet
-            };
-            amrex::Array<amrex::LinOpBCType, AMREX_SPACEDIM> const hibc = {
-                amrex::LinOpBCType::Dirichlet,
-                amrex::LinOpBCType::Dirichlet,
-                amrex::LinOpBCType::Dirichlet
-            };
-            //bool bcs_set = false;
-            //std::array<bool, AMREX_SPACEDIM * 2> dirichlet_flag;
-            //bool has_non_periodic = false;
-        } poisson_boundary_handler;
-
-        // create a vector to our fields, sorted by level
-        amrex::Vector<amrex::MultiFab*> sorted_rho;
-        amrex::Vector<amrex::MultiFab*> sorted_phi;
-
-        for (int lev = 0; lev <= finest_level; ++lev) {
-            sorted_rho.emplace_back(&rho[lev]);
-            sorted_phi.emplace_back(&phi[lev]);
-        }
+        // Dirichlet boundaries on all sides of the (padded) beam box
+        //   on refined levels, the faces of the patches inside the domain keep
+        //   the values of phi interpolated from the coarser level
+        amrex::Array<amrex::LinOpBCType, AMREX_SPACEDIM> const lobc = {
+            amrex::LinOpBCType::Dirichlet,
+            amrex::LinOpBCType::Dirichlet,
+            amrex::LinOpBCType::Dirichlet
+        };
+        amrex::Array<amrex::LinOpBCType, AMREX_SPACEDIM> const hibc = {
+            amrex::LinOpBCType::Dirichlet,
+            amrex::LinOpBCType::Dirichlet,
+            amrex::LinOpBCType::Dirichlet
+        };
 
-        ablastr::fields::computePhi(
-            sorted_rho,
-            sorted_phi,
-            beta_xyz,
-            mlmg_relative_tolerance,
-            mlmg_absolute_tolerance,
-            mlmg_max_iters,
-            mlmg_verbosity,
-            pc.GetParGDB()->Geom(),
-            pc.GetParGDB()->DistributionMap(),
-            pc.GetParGDB()->boxArray(),
-            poisson_boundary_handler
-            /*
-            do_single_precision_comms,
-            this->ref_ratio,
-            post_phi_calculation,
-            gett_new(0),
-            eb_farray_box_factory
-            */
+        op.linop = std::make_unique<amrex::MLNodeTensorLaplacian>(
+            amrex::Vector<amrex::Geometry>{geom},
+            amrex::Vector<amrex::BoxArray>{ba},
+            amrex::Vector<amrex::DistributionMapping>{dm}
         );
+        op.linop->setBeta(beta_xyz);
+        op.linop->setDomainBC(lobc, hibc);
+
+        op.mlmg = std::make_unique<amrex::MLMG>(*op.linop);
+        op.mlmg->setVerbose(m_verbosity);
+        op.mlmg->setMaxIter(m_max_iters);
+
+        op.geom = geom;
+        op.ba = ba;
+        op.dm = dm;
+        op.beta_s = beta_s;
+        m_num_rebuilds++;
+    }
+
+    void PoissonSolver::solve_level (
+        int lev,
+        amrex::Geometry const & geom,
+        amrex::BoxArray const & ba,
+        amrex::DistributionMapping const & dm,
+        amrex::Real beta_s,
+        amrex::MultiFab & rho,
+        amrex::MultiFab & phi
+    )
+    {
+        using namespace amrex::literals;
+        using namespace ablastr::constant::SI;
+
+        bool const reuse = is_defined_for(lev, geom, ba, dm, beta_s);
+        if (!reuse) { define(lev, geom, ba, dm, beta_s); }
+        amrex::MLMG & mlmg = *m_levels[lev].mlmg;
 
-        // fix side effect on rho from previous call
-        for (int lev=0; lev<=finest_level; lev++) {
-            using namespace ablastr::constant::SI;
-            rho[lev].mult(-1._rt * ep0);
+        // scale rho to the right-hand side of the Poisson equation
+        rho.mult(-1._rt / ep0);
+
+        // converge relative to the right-hand side instead of the initial
+        // residual, so a good initial guess saves iterations
+        amrex::Real max_norm_b = rho.norm0();
+        amrex::ParallelDescriptor::ReduceRealMax(max_norm_b);
+        bool const always_use_bnorm = max_norm_b > 0;
+        amrex::Real absolute_tolerance = m_absolute_tolerance;
+        if (!always_use_bnorm) {
+            if (absolute_tolerance == 0.0) { absolute_tolerance = amrex::Real(1e-6); }
+            ablastr::warn_manager::WMRecordWarning(
+                "ImpactX::PoissonSolver",
+                "Max norm of rho is 0: using the absolute tolerance of "
+                + std::to_string(absolute_tolerance) + " for the space charge solve.",
+                ablastr::warn_manager::WarnPriority::low);
+        }
+        mlmg.setAlwaysUseBNorm(always_use_bnorm);
+
+        mlmg.solve({&phi}, {&rho}, m_relative_tolerance, absolute_tolerance);
+
+        // restore rho
+        rho.mult(-1._rt * ep0);
+
+        int const num_iters = mlmg.getNumIters();
+        m_num_iters += num_iters;
+
+        if (m_verbosity > 0) {
+            bool const warm_start = m_warm_start && m_num_solves > 0;
+            amrex::Print() << " Poisson solve";
+            if (lev > 0) { amrex::Print() << " on level " << lev; }
+            amrex::Print() << ": " << num_iters << " MLMG iterations ("
+                           << (lev > 0 ? "interpolated" : (warm_start ? "warm" : "cold")) << " start, "
+                           << (reuse ? "reused" : "new") << " operator)\n";
         }
+    }
+
+    void PoissonSolver::solve (
+        ImpactXParticleContainer const & pc,
+        std::unordered_map<int, amrex::MultiFab> & rho,
+        std::unordered_map<int, amrex::MultiFab> & phi
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::PoissonSolver::solve");
+
+        using namespace amrex::literals;
+
+        double const start_time = amrex::second();
 
-        // fill boundary
-        for (int lev=0; lev<=finest_level; lev++)
+        // relativistic beta=v/c of the reference particle
+        amrex::Real const pt_ref = pc.GetRefParticle().pt;
+        amrex::Real const beta_s = std::sqrt(1.0_rt - 1.0_rt/std::pow(pt_ref, 2));
+
+        // operators of levels that were removed
+        int const finest_level = phi.size() - 1u;
+        if (int(m_levels.size()) > finest_level + 1) { m_levels.resize(finest_level + 1); }
+
+        // 2.5D: transverse solve, scaled by the line density
+        if (m_transverse)
+        {
+            AMREX_ALWAYS_ASSERT_WITH_MESSAGE(finest_level == 0,
+                "PoissonSolver: mesh refinement is not supported with algo.space_charge = 2.5D");
+            amrex::Geometry const & geom = pc.GetParGDB()->Geom(0);
+            m_transverse->solve(rho.at(0), phi.at(0), geom);
+            phi.at(0).FillBoundary(geom.periodicity());
+
+            m_num_iters = 0;
+            m_num_solves++;
+
+            if (m_timed) {
+                amrex::Gpu::streamSynchronize();
+                m_total_time += amrex::second() - start_time;
+            }
+            return;
+        }
+
+        m_num_iters = 0;
+        for (int lev = 0; lev <= finest_level; ++lev)
         {
+            amrex::MultiFab & rho_at_level = rho.at(lev);
             amrex::MultiFab & phi_at_level = phi.at(lev);
-            phi_at_level.FillBoundary(pc.GetParGDB()->Geom()[lev].periodicity());
+
+            amrex::Geometry const & geom = pc.GetParGDB()->Geom(lev);
+            amrex::BoxArray const & ba = pc.GetParGDB()->boxArray(lev);
+            amrex::DistributionMapping const & dm = pc.GetParGDB()->DistributionMap(lev);
+
+            if (lev == 0 && m_fft)
+            {
+                m_fft->solve(rho_at_level, phi_at_level, geom, pc.GetRefParticle().gamma());
+            }
+            else
+            {
+                if (lev == 0) {
+                    // initial guess: the previous potential, which is given in the same
+                    // (relative) grid index space of the beam box, or zero
+                    bool const warm_start = m_warm_start && m_num_solves > 0;
+                    if (!warm_start) {
+                        phi_at_level.setVal(0.);
+                    }
+                } else {
+                    // boundary values on the faces of the refined patches and initial
+                    // guess: interpolated from the potential on the coarser level
+                    amrex::PhysBCFunctNoOp no_bc;
+                    amrex::Vector<amrex::BCRec> const bcs(1, amrex::BCRec(
+                        AMREX_D_DECL(amrex::BCType::ext_dir, amrex::BCType::ext_dir, amrex::BCType::ext_dir),
+                        AMREX_D_DECL(amrex::BCType::ext_dir, amrex::BCType::ext_dir, amrex::BCType::ext_dir)));
+                    amrex::InterpFromCoarseLevel(phi_at_level, 0.0, phi.at(lev - 1), 0, 0, 1,
+                                                 pc.GetParGDB()->Geom(lev - 1), geom,
+                                                 no_bc, 0, no_bc, 0,
+                                                 pc.GetParGDB()->refRatio(lev - 1),
+                                                 &amrex::node_bilinear_interp, bcs, 0);
+                }
+
+                solve_level(lev, geom, ba, dm, beta_s, rho_at_level, phi_at_level);
+            }
+
+            // fill boundary
+            phi_at_level.FillBoundary(geom.periodicity());
+        }
+
+        m_total_iters += m_num_iters;
+        m_num_solves++;
+
+        if (m_timed) {
+            amrex::Gpu::streamSynchronize();
+            m_total_time += amrex::second() - start_time;
         }
     }
 } // impactx::spacecharge
@@ -0,0 +1,43 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl
+ * License: BSD-3-Clause-LBNL
+ */
+#include "SpaceChargeAlgo.H"
+
+#include <AMReX_ParmParse.H>
+#include <AMReX_String.H>
+
+#include <stdexcept>
+#include <string>
+
+
+namespace impactx::spacecharge
+{
+    SpaceChargeAlgo get_space_charge_algo ()
+    {
+        amrex::ParmParse pp_algo("algo");
+        std::string space_charge = "true";
+        pp_algo.queryAdd("space_charge", space_charge);
+
+        std::string const value = amrex::toLower(space_charge);
+        if (value == "false" || value == "0")
+            return SpaceChargeAlgo::False;
+        if (value == "true" || value == "1" || value == "3d")
+            return SpaceChargeAlgo::True_3D;
+        if (value == "2.5d") {
+#ifndef ImpactX_USE_FFT
+            throw std::runtime_error("algo.space_charge = 2.5D requires ImpactX to be compiled with ImpactX_FFT=ON");
+#endif
+            return SpaceChargeAlgo::True_2p5D;
+        }
+
+        throw std::runtime_error("algo.space_charge = " + space_charge +
+                                 " is not supported (use: false, true, 3D, 2.5D)");
+    }
+
+} // namespace impactx::spacecharge
@@ -0,0 +1,276 @@
+/* Copyright 2022-2023 The Regents of the University of California, through Lawrence
+ *           Berkeley National Laboratory (subject to receipt of any required
+ *           approvals from the U.S. Dept. of Energy). All rights reserved.
+ *
+ * This file is part of ImpactX.
+ *
+ * Authors: Axel Huebl, Ji Qiang
+ * License: BSD-3-Clause-LBNL
+ */
+#include "TransverseFFTPoissonSolver.H"
+
+#include <ablastr/constant.H>
+
+#include <AMReX_BLProfiler.H>
+#include <AMReX_Box.H>
+#include <AMReX_BoxArray.H>
+#include <AMReX_Extension.H>  // for AMREX_RESTRICT
+#include <AMReX_GpuAtomic.H>
+#include <AMReX_GpuContainers.H>
+#include <AMReX_GpuLaunch.H>
+#include <AMReX_MFIter.H>
+#include <AMReX_ParallelDescriptor.H>
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+
+namespace impactx::spacecharge
+{
+#ifdef ImpactX_USE_FFT
+namespace
+{
+    /** Primitive of ln(x^2 + y^2), integrated in x and y
+     *
+     * @param x,y position relative to the source (both non-zero)
+     */
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    amrex::Real
+    green_primitive_2d (amrex::Real x, amrex::Real y)
+    {
+        using namespace amrex::literals;
+
+        return x*y*(std::log(x*x + y*y) - 3.0_rt)
+               + x*x*std::atan(y / x)
+               + y*y*std::atan(x / y);
+    }
+
+    /** Integral of ln(r) over the cell of size (hx, hy) centered at (x, y)
+     *
+     * @param x,y distance between the nodes (both non-negative)
+     * @param hx,hy cell size
+     */
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    amrex::Real
+    integrated_green_2d (amrex::Real x, amrex::Real y, amrex::Real hx, amrex::Real hy)
+    {
+        using namespace amrex::literals;
+
+        amrex::Real const xp = x + 0.5_rt*hx, xm = x - 0.5_rt*hx;
+        amrex::Real const yp = y + 0.5_rt*hy, ym = y - 0.5_rt*hy;
+
+        // ln(r) = ln(r^2) / 2
+        return 0.5_rt * (green_primitive_2d(xp, yp) - green_primitive_2d(xm, yp)
+                       - green_primitive_2d(xp, ym) + green_primitive_2d(xm, ym));
+    }
+} // anonymous namespace
+
+    TransverseFFTPoissonSolver::TransverseFFTPoissonSolver () = default;
+
+    TransverseFFTPoissonSolver::~TransverseFFTPoissonSolver ()
+    {
+        destroy_plans();
+    }
+
+    void TransverseFFTPoissonSolver::destroy_plans ()
+    {
+        if (m_defined) {
+            ablastr::math::anyfft::DestroyPlan(m_forward_rho);
+            ablastr::math::anyfft::DestroyPlan(m_forward_green);
+            ablastr::math::anyfft::DestroyPlan(m_backward);
+        }
+        m_defined = false;
+    }
+
+    void TransverseFFTPoissonSolver::define (amrex::MultiFab const & rho)
+    {
+        BL_PROFILE("impactx::spacecharge::TransverseFFTPoissonSolver::define");
+
+        using namespace ablastr::math::anyfft;
+
+        m_ba = rho.boxArray();
+
+        // all nodes of the beam mesh
+        amrex::Box const domain = m_ba.minimalBox();
+        m_lo = domain.smallEnd();
+
+        // same number of nodes: keep the plans and the Green's function
+        if (m_defined && domain.length() == m_n) { return; }
+
+        destroy_plans();
+        m_n = domain.length();
+
+        // 2D real-to-complex transforms keep half of the frequencies in x
+        amrex::IntVect const real_size(2 * m_n[0], 2 * m_n[1], 1);
+        long const n_real = long(real_size[0]) * real_size[1];
+        long const n_complex = long(real_size[0] / 2 + 1) * real_size[1];
+
+        m_line_density.resize(m_n[2]);
+        m_projection.resize(long(m_n[0]) * m_n[1]);
+        m_real.resize(n_real);
+        m_rho_hat.resize(n_complex);
+        m_green_hat.resize(n_complex);
+
+        int const dim = 2;
+        m_forward_rho = CreatePlan(real_size, m_real.dataPtr(),
+                                   reinterpret_cast<Complex*>(m_rho_hat.dataPtr()),
+                                   direction::R2C, dim);
+        m_forward_green = CreatePlan(real_size, m_real.dataPtr(),
+                                     reinterpret_cast<Complex*>(m_green_hat.dataPtr()),
+                                     direction::R2C, dim);
+        m_backward = CreatePlan(real_size, m_real.dataPtr(),
+                                reinterpret_cast<Complex*>(m_rho_hat.dataPtr()),
+                                direction::C2R, dim);
+
+        // Green's function needs to be recomputed
+        m_green_n = amrex::IntVect{0, 0, 0};
+        m_defined = true;
+    }
+
+    void TransverseFFTPoissonSolver::compute_green (amrex::Real hx, amrex::Real hy)
+    {
+        BL_PROFILE("impactx::spacecharge::TransverseFFTPoissonSolver::compute_green");
+
+        int const nx = m_n[0];
+        int const ny = m_n[1];
+        amrex::Real * const AMREX_RESTRICT real = m_real.dataPtr();
+
+        amrex::Box const doubled(amrex::IntVect(0), amrex::IntVect(2*nx - 1, 2*ny - 1, 0));
+        amrex::ParallelFor(doubled,
+            [=] AMREX_GPU_DEVICE (int i, int j, int) noexcept
+            {
+                // distance in cells: the upper half holds the negative offsets
+                int const di = (i < nx) ? i : 2*nx - i;
+                int const dj = (j < ny) ? j : 2*ny - j;
+
+                real[i + 2*nx*j] = integrated_green_2d(di*hx, dj*hy, hx, hy);
+            });
+
+        ablastr::math::anyfft::Execute(m_forward_green);
+
+        m_green_n = m_n;
+        m_green_hx = hx;
+        m_green_hy = hy;
+    }
+
+    void TransverseFFTPoissonSolver::solve (
+        amrex::MultiFab const & rho,
+        amrex::MultiFab & phi,
+        amrex::Geometry const & geom
+    )
+    {
+        BL_PROFILE("impactx::spacecharge::TransverseFFTPoissonSolver::solve");
+
+        using namespace amrex::literals;
+        using namespace ablastr::constant::SI;
+
+        if (!m_defined || rho.boxArray() != m_ba) {
+            define(rho);
+        }
+
+        amrex::Real const hx = geom.CellSize(0);
+        amrex::Real const hy = geom.CellSize(1);
+        amrex::Real const hz = geom.CellSize(2);
+        if (m_n != m_green_n || hx != m_green_hx || hy != m_green_hy) { compute_green(hx, hy); }
+
+        int const nx = m_n[0];
+        int const ny = m_n[1];
+        int const nz = m_n[2];
+        long const n_projection = long(nx) * ny;
+        long const n_real = long(2 * nx) * (2 * ny);
+        long const n_complex = long(nx + 1) * (2 * ny);
+        amrex::IntVect const lo = m_lo;
+
+        amrex::Real * const AMREX_RESTRICT line_density = m_line_density.dataPtr();
+        amrex::Real * const AMREX_RESTRICT projection = m_projection.dataPtr();
+        amrex::Real * const AMREX_RESTRICT real = m_real.dataPtr();
+        amrex::GpuComplex<amrex::Real> * const AMREX_RESTRICT rho_hat = m_rho_hat.dataPtr();
+        amrex::GpuComplex<amrex::Real> const * const AMREX_RESTRICT green_hat = m_green_hat.dataPtr();
+
+        // projections of the charge density of the local boxes
+        //   nodes on the faces between boxes are counted by their owner only
+        amrex::ParallelFor(nz, [=] AMREX_GPU_DEVICE (int k) noexcept { line_density[k] = 0.0_rt; });
+        amrex::ParallelFor(n_projection, [=] AMREX_GPU_DEVICE (long i) noexcept { projection[i] = 0.0_rt; });
+        auto const owner_mask = rho.OwnerMask();
+        for (amrex::MFIter mfi(rho); mfi.isValid(); ++mfi)
+        {
+            auto const rho_arr = rho.const_array(mfi);
+            auto const owner_arr = owner_mask->const_array(mfi);
+            amrex::ParallelFor(mfi.validbox(),
+                [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+                {
+                    if (!owner_arr(i, j, k)) { return; }
+                    amrex::Real const value = rho_arr(i, j, k);
+                    amrex::HostDevice::Atomic::Add(&line_density[k - lo[2]], value * hx * hy);
+                    amrex::HostDevice::Atomic::Add(&projection[(i - lo[0]) + nx*(j - lo[1])], value * hz);
+                });
+        }
+
+        // sum over all MPI ranks
+        //   nz + nx * ny values instead of gathering all nx * ny * nz nodes
+        std::vector<amrex::Real> host_sum(std::size_t(nz + n_projection));
+        amrex::Gpu::copy(amrex::Gpu::deviceToHost, m_line_density.begin(), m_line_density.end(), host_sum.begin());
+        amrex::Gpu::copy(amrex::Gpu::deviceToHost, m_projection.begin(), m_projection.end(), host_sum.begin() + nz);
+        amrex::ParallelDescriptor::ReduceRealSum(host_sum.data(), int(host_sum.size()));
+        amrex::Gpu::copy(amrex::Gpu::hostToDevice, host_sum.begin(), host_sum.begin() + nz, m_line_density.begin());
+        amrex::Gpu::copy(amrex::Gpu::hostToDevice, host_sum.begin() + nz, host_sum.end(), m_projection.begin());
+
+        amrex::Real charge = 0.0_rt;
+        for (int k = 0; k < nz; ++k) { charge += host_sum[k]; }
+        charge *= hz;
+
+        // guard cells outside of the domain stay zero
+        phi.setVal(0.);
+        if (charge == 0.0_rt) { return; }
+
+        // potential of a unit line charge, the FFTs are not normalized
+        amrex::Real const scale = -1.0_rt / (2.0_rt * ablastr::constant::math::pi * ep0 * amrex::Real(n_real));
+
+        // transverse projection, normalized to a unit charge and zero-padded
+        amrex::ParallelFor(n_real, [=] AMREX_GPU_DEVICE (long i) noexcept { real[i] = 0.0_rt; });
+        amrex::Box const transverse(amrex::IntVect(0), amrex::IntVect(nx - 1, ny - 1, 0));
+        amrex::ParallelFor(transverse,
+            [=] AMREX_GPU_DEVICE (int i, int j, int) noexcept
+            {
+                real[i + 2*nx*j] = projection[i + nx*j] / charge;
+            });
+
+        // convolution with the Green's function, redundantly on each MPI rank
+        ablastr::math::anyfft::Execute(m_forward_rho);
+        amrex::ParallelFor(n_complex,
+            [=] AMREX_GPU_DEVICE (long i) noexcept
+            {
+                rho_hat[i] *= green_hat[i] * scale;
+            });
+        ablastr::math::anyfft::Execute(m_backward);
+
+        // transverse potential of each slice of the local boxes, scaled by its line density
+        for (amrex::MFIter mfi(phi); mfi.isValid(); ++mfi)
+        {
+            auto const phi_arr = phi.array(mfi);
+            amrex::ParallelFor(mfi.validbox(),
+                [=] AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+                {
+                    phi_arr(i, j, k) = real[(i-lo[0]) + 2*nx*(j-lo[1])] * line_density[k-lo[2]];
+                });
+        }
+    }
+#else
+    TransverseFFTPoissonSolver::TransverseFFTPoissonSolver ()
+    {
+        throw std::runtime_error("algo.space_charge = 2.5D requires ImpactX to be compiled with ImpactX_FFT=ON");
+    }
+
+    TransverseFFTPoissonSolver::~TransverseFFTPoissonSolver () = default;
+
+    void TransverseFFTPoissonSolver::solve (
+        amrex::MultiFab const & /* rho */,
+        amrex::MultiFab & /* phi */,
+        amrex::Geometry const & /* geom */
+    )
+    {
+    }
+#endif
+} // namespace impactx::spacecharge
@@ -6,6 +6,7 @@
 #include "pyImpactX.H"
 
 #include <ImpactX.H>
+#include <particles/spacecharge/SpaceChargeAlgo.H>
 
 #include <AMReX.H>
 #include <AMReX_ParmParse.H>
@@ -14,7 +15,9 @@
 #if defined(AMREX_DEBUG) || defined(DEBUG)
 #   include <cstdio>
 #endif
+#include <stdexcept>
 #include <string>
+#include <variant>
 
 
 namespace py = pybind11;
@@ -161,6 +164,16 @@ void init_ImpactX (py::module& m)
               },
               "Use dynamic (``true``) resizing of the field mesh or static sizing (``false``)."
         )
+        .def_property("dynamic_size_hysteresis",
+              [](ImpactX & /* ix */) {
+                  return detail::get_or_throw<amrex::Real>("geometry", "dynamic_size_hysteresis");
+              },
+              [](ImpactX & /* ix */, amrex::Real hysteresis) {
+                  amrex::ParmParse pp_geometry("geometry");
+                  pp_geometry.add("dynamic_size_hysteresis", hysteresis);
+              },
+              "Keep the field mesh while each of its faces deviates by less than this fraction of the mesh width from the face requested by prob_relative."
+        )
 
         .def_property("particle_shape",
             [](ImpactX & /* ix */) {
@@ -178,14 +191,143 @@ void init_ImpactX (py::module& m)
             "Whether to calculate space charge effects."
         )
         .def_property("space_charge",
+             [](ImpactX & /* ix */) -> std::variant<bool, std::string> {
+                 auto const space_charge_algo = spacecharge::get_space_charge_algo();
+                 if (space_charge_algo == spacecharge::SpaceChargeAlgo::True_2p5D)
+                     return std::string("2.5D");
+                 return space_charge_algo != spacecharge::SpaceChargeAlgo::False;
+             },
+             [](ImpactX & /* ix */, std::variant<bool, std::string> const & space_charge) {
+                 amrex::ParmParse pp_algo("algo");
+                 if (std::holds_alternative<bool>(space_charge))
+                     pp_algo.add("space_charge", std::get<bool>(space_charge));
+                 else
+                     pp_algo.add("space_charge", std::get<std::string>(space_charge));
+                 // validate
+                 spacecharge::get_space_charge_algo();
+             },
+             "Enable (True) or disable (False) space charge calculations, or select the \"2.5D\" model (default: enabled)."
+        )
+        .def_property("space_charge_interval",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<int>("algo", "space_charge_interval");
+             },
+             [](ImpactX & /* ix */, int const interval) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("space_charge_interval", interval);
+             },
+             "Recompute the space charge field only every this many space charge slices (default: 1)."
+        )
+        .def_property("space_charge_rtol",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<amrex::Real>("algo", "space_charge_rtol");
+             },
+             [](ImpactX & /* ix */, amrex::Real const rtol) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("space_charge_rtol", rtol);
+             },
+             "Also recompute the space charge field if the beam width or energy changed by more than this relative tolerance (default: 0, disabled)."
+        )
+        .def_property("mr_tag_rho_rtol",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<amrex::Real>("algo", "mr_tag_rho_rtol");
+             },
+             [](ImpactX & /* ix */, amrex::Real const rtol) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("mr_tag_rho_rtol", rtol);
+             },
+             "With mesh-refinement, refine cells whose charge density exceeds this fraction of the maximum on their level (default: 0.1)."
+        )
+        .def_property("fuse_linear_elements",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("algo", "fuse_linear_elements");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("fuse_linear_elements", enable);
+             },
+             "Combine consecutive linear elements into a single transfer map, if space charge is disabled (default: disabled)."
+        )
+        .def_property("load_balance_interval",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<int>("algo", "load_balance_interval");
+             },
+             [](ImpactX & /* ix */, int const interval) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("load_balance_interval", interval);
+             },
+             "Redistribute the mesh boxes over the MPI ranks every this many slices, weighted by their number of particles (default: 0, disabled)."
+        )
+        .def_property("store_space_charge_field",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("algo", "store_space_charge_field");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("store_space_charge_field", enable);
+             },
+             "Store the space charge force field on the mesh, or calculate it from the gradient of phi in the gather (default: enabled)."
+        )
+        .def_property("sort_interval",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<int>("algo", "sort_interval");
+             },
+             [](ImpactX & /* ix */, int const interval) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("sort_interval", interval);
+             },
+             "Sort the particles by their cell on the space charge mesh every this many slices (default: 0, disabled)."
+        )
+        .def_property("cache_ref_particle",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("algo", "cache_ref_particle");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("cache_ref_particle", enable);
+             },
+             "Replay the reference particle pushes of RF cavities, soft-edge elements and exact bends of the first\n"
+             "lattice period in later periods, if the reference particle enters each slice in the same state (default: disabled)."
+        )
+        .def_property("particle_major",
              [](ImpactX & /* ix */) {
-                 return detail::get_or_throw<bool>("algo", "space_charge");
+                 return detail::get_or_throw<bool>("algo", "particle_major");
              },
              [](ImpactX & /* ix */, bool const enable) {
                  amrex::ParmParse pp_algo("algo");
-                 pp_algo.add("space_charge", enable);
+                 pp_algo.add("particle_major", enable);
              },
-             "Enable or disable space charge calculations (default: enabled)."
+             "Push each particle through all elements and periods in one kernel, if space charge is disabled (default: disabled)."
+        )
+        .def_property("simd",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("algo", "simd");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("simd", enable);
+             },
+             "Push SIMD vectors of particles through common elements, in builds with ImpactX_SIMD (default: enabled)."
+        )
+        .def_property("fused_space_charge",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("algo", "fused_space_charge");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_algo("algo");
+                 pp_algo.add("fused_space_charge", enable);
+             },
+             "Calculate space charge directly on the particles at fixed s, without coordinate transformation passes (default: disabled)."
+        )
+        .def_property("poisson_solver",
+              [](ImpactX & /* ix */) {
+                  return detail::get_or_throw<std::string>("algo", "poisson_solver");
+              },
+              [](ImpactX & /* ix */, std::string const poisson_solver) {
+                  amrex::ParmParse pp_algo("algo");
+                  pp_algo.add("poisson_solver", poisson_solver);
+              },
+              "The numerical solver to solve the Poisson equation when calculating space charge effects: multigrid (default) or fft."
         )
         .def_property("mlmg_relative_tolerance",
               [](ImpactX & /* ix */) {
@@ -238,6 +380,16 @@ void init_ImpactX (py::module& m)
               "Currently MLMG solver looks for verbosity levels from 0-5. "
               "A higher number results in more verbose output."
         )
+        .def_property("mlmg_warm_start",
+              [](ImpactX & /* ix */) {
+                  return detail::get_or_throw<bool>("algo", "mlmg_warm_start");
+              },
+              [](ImpactX & /* ix */, bool const mlmg_warm_start) {
+                  amrex::ParmParse pp_algo("algo");
+                  pp_algo.add("mlmg_warm_start", mlmg_warm_start);
+              },
+              "Use the potential of the previous space-charge solve as the initial guess of the next one (default: enabled)."
+        )
         .def_property("diagnostics",
              [](ImpactX & /* ix */) {
                  return detail::get_or_throw<bool>("diag", "enable");
@@ -261,6 +413,16 @@ void init_ImpactX (py::module& m)
              "By default, diagnostics is performed at the beginning and end of the simulation.\n"
              "Enabling this flag will write diagnostics every step and slice step."
         )
+        .def_property("diag_nonblocking_reduce",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("diag", "nonblocking_reduce");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_diag("diag");
+                 pp_diag.add("nonblocking_reduce", enable);
+             },
+             "Sum the reduced beam characteristics over MPI ranks with a non-blocking allreduce (default: disabled)."
+        )
         .def_property("diag_file_min_digits",
              [](ImpactX & /* ix */) {
                  return detail::get_or_throw<int>("diag", "file_min_digits");
@@ -272,6 +434,27 @@ void init_ImpactX (py::module& m)
              "The minimum number of digits (default: 6) used for the step\n"
              "number appended to the diagnostic file names."
         )
+        .def_property("diag_element_profile",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("diag", "element_profile");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_diag("diag");
+                 pp_diag.add("element_profile", enable);
+             },
+             "Record the wall time per lattice element and phase during evolve (default: disabled).\n\n"
+             "The result is written to diags/element_profile.txt and available as :py:attr:`~element_profile`."
+        )
+        .def_property("diag_performance_counters",
+             [](ImpactX & /* ix */) {
+                 return detail::get_or_throw<bool>("diag", "performance_counters");
+             },
+             [](ImpactX & /* ix */, bool const enable) {
+                 amrex::ParmParse pp_diag("diag");
+                 pp_diag.add("performance_counters", enable);
+             },
+             "Count the particle pushes, sample the memory and time the Poisson solves during evolve (default: disabled)."
+        )
         .def_property("particle_lost_diagnostics_backend",
                       [](ImpactX & /* ix */) {
                           return detail::get_or_throw<std::string>("diag", "backend");
@@ -283,6 +466,51 @@ void init_ImpactX (py::module& m)
                       "Diagnostics for particles lost in apertures.\n\n"
                       "See the ``BeamMonitor`` element for backend values."
         )
+        .def_property("particle_lost_spill_threshold",
+                      [](ImpactX & /* ix */) {
+                          return detail::get_or_throw<int>("diag", "lost_spill_threshold");
+                      },
+                      [](ImpactX & /* ix */, int const threshold) {
+                          amrex::ParmParse pp_diag("diag");
+                          pp_diag.add("lost_spill_threshold", threshold);
+                      },
+                      "Write particles lost in apertures in batches of at least this many\n"
+                      "particles per MPI rank during the simulation (default: 0, disabled).\n"
+                      "Requires :py:attr:`diagnostics`."
+        )
+        .def_property("checkpoint_step_interval",
+                      [](ImpactX & /* ix */) {
+                          return detail::get_or_throw<int>("checkpoint", "step_interval");
+                      },
+                      [](ImpactX & /* ix */, int const interval) {
+                          amrex::ParmParse pp_checkpoint("checkpoint");
+                          pp_checkpoint.add("step_interval", interval);
+                      },
+                      "Write a checkpoint every this many global steps, including slice steps\n"
+                      "(default: 0, disabled). See :py:meth:`restart`."
+        )
+        .def_property("checkpoint_walltime_interval",
+                      [](ImpactX & /* ix */) {
+                          return detail::get_or_throw<double>("checkpoint", "walltime_interval");
+                      },
+                      [](ImpactX & /* ix */, double const interval) {
+                          amrex::ParmParse pp_checkpoint("checkpoint");
+                          pp_checkpoint.add("walltime_interval", interval);
+                      },
+                      "Write a checkpoint after a slice step if this many seconds of wall time\n"
+                      "passed since the last one (default: 0, disabled). See :py:meth:`restart`."
+        )
+        .def_property("checkpoint_restart",
+                      [](ImpactX & /* ix */) {
+                          return detail::get_or_throw<std::string>("checkpoint", "restart");
+                      },
+                      [](ImpactX & /* ix */, std::string const & file_name) {
+                          amrex::ParmParse pp_checkpoint("checkpoint");
+                          pp_checkpoint.add("restart", file_name);
+                      },
+                      "The checkpoint file to continue the tracking from, see :py:meth:`restart`.\n"
+                      "This must be set before :py:meth:`init_grids`, which then keeps the diagnostics."
+        )
         .def_property("abort_on_warning_threshold",
              [](ImpactX & /* ix */){
                  return detail::get_or_throw<std::string>("impactx", "abort_on_warning_threshold");
@@ -308,6 +536,16 @@ void init_ImpactX (py::module& m)
             "If set to 1, immediately prints every warning message\n"
             " as soon as it is generated."
         )
+        .def_property("verbose",
+            [](ImpactX & /* ix */){
+                return detail::get_or_throw<int>("impactx", "verbose");
+            },
+            [](ImpactX & /* ix */, int const verbose) {
+                amrex::ParmParse pp_impactx("impactx");
+                pp_impactx.add("verbose", verbose);
+            },
+            "Set to 0 to skip the progress line printed at the start of each slice step."
+        )
         // TODO this is an integer with 0 or 1 - can I just make this a boolean here?
         .def_property("abort_on_unused_inputs",
             [](ImpactX & /* ix */){
@@ -332,18 +570,37 @@ void init_ImpactX (py::module& m)
         .def("add_particles", &ImpactX::add_particles,
              py::arg("bunch_charge"),
              py::arg("distr"), py::arg("npart"),
+             py::arg("ensemble_member") = 0,
              "Generate and add n particles to the particle container.\n\n"
              "Will also resize the geometry based on the updated particle\n"
              "distribution's extent and then redistribute particles in according\n"
-             "AMReX grid boxes."
+             "AMReX grid boxes.\n"
+             "The particles belong to the ensemble member ensemble_member, see :py:meth:`add_ensemble_member`."
+        )
+        .def("restart", &ImpactX::restart,
+             "Restore the beam, the lost particles and the reference particles from the checkpoint\n"
+             ":py:attr:`checkpoint_restart`, instead of adding particles.\n\n"
+             "The next :py:meth:`evolve` continues after the slice step at which the checkpoint was written.\n"
+             "The lattice, periods and algorithms must be the same as in the run that wrote the checkpoint.\n"
+             "This must come after :py:meth:`init_grids` and, for ensembles, :py:meth:`add_ensemble_member`."
+        )
+        .def("add_ensemble_member", &ImpactX::add_ensemble_member,
+             py::arg("ref_particle"), py::arg("lattice"),
+             "Add a member to the ensemble of independent beams.\n\n"
+             "Member 0 is the beam of the reference particle of the particle container, tracked through :py:attr:`lattice`.\n"
+             "Each further member has its own reference particle and a lattice with the same element types and slices,\n"
+             "but, e.g., different element parameters. All members are tracked together, particle-major.\n"
+             "This must come after :py:meth:`init_grids`.\n\n"
+             ":return: index of the new member"
         )
 
         .def("evolve", &ImpactX::evolve,
              "Run the main simulation loop for a number of steps."
         )
         // TODO: step
-        .def("resize_mesh", &ImpactX::ResizeMesh,
-             "Resize the mesh :py:attr:`~domain` based on the :py:attr:`~dynamic_size` and related parameters."
+        .def("resize_mesh", py::overload_cast<>(&ImpactX::ResizeMesh),
+             "Resize the mesh :py:attr:`~domain` based on the :py:attr:`~dynamic_size` and related parameters.\n"
+             "Returns True if the mesh extent changed."
         )
 
         .def("particle_container",
@@ -370,12 +627,38 @@ void init_ImpactX (py::module& m)
         .def(
             "space_charge_field",
             [](ImpactX & ix, int lev, std::string const & comp) {
-                return &ix.m_space_charge_field.at(lev).at(comp);
+                auto & scf = ix.m_space_charge_field.at(lev);
+                if (scf.count(comp) == 0)
+                    throw std::runtime_error("space_charge_field: component " + comp + " is not stored "
+                                             "(see algo.store_space_charge_field)");
+                return &scf.at(comp);
             },
             py::arg("lev"), py::arg("comp"),
             py::return_value_policy::reference_internal,
             "space charge force (vector: x,y,z) per level"
         )
+        .def_property_readonly("element_profile",
+            [](ImpactX const & ix) {
+                py::list rows;
+                for (auto const & entry : ix.m_element_profile.entries()) {
+                    py::dict row;
+                    row["index"] = entry.index;
+                    row["num_elements"] = entry.num_elements;
+                    row["name"] = entry.name;
+                    row["slices"] = entry.slices;
+                    row["particles"] = entry.particles;
+                    row["bytes_per_second"] = entry.bytes_per_second();
+                    row["total_time"] = entry.total_time();
+                    for (int p = 0; p < diagnostics::num_profile_phases; ++p) {
+                        row[(std::string("time_") + diagnostics::ElementProfileEntry::phase_names[p]).c_str()] = entry.time[p];
+                    }
+                    rows.append(row);
+                }
+                return rows;
+            },
+            "Wall time per lattice element of the last evolve, with :py:attr:`~diag_element_profile`.\n\n"
+            "A list with a dict per element, e.g., for pandas.DataFrame."
+        )
         .def_readwrite("lattice",
             &ImpactX::m_lattice,
             "Access the accelerator element lattice."
@@ -423,6 +706,24 @@ void init_ImpactX (py::module& m)
                 return true;
 #else
                 return false;
+#endif
+            })
+        .def_property_readonly_static(
+            "have_openpmd",
+            [](py::object const &){
+#ifdef ImpactX_USE_OPENPMD
+                return true;
+#else
+                return false;
+#endif
+            })
+        .def_property_readonly_static(
+            "have_simd",
+            [](py::object const &){
+#ifdef ImpactX_USE_SIMD
+                return true;
+#else
+                return false;
 #endif
             })
         .def_property_readonly_static(
@@ -443,6 +744,11 @@ void init_ImpactX (py::module& m)
                 return false;
 #endif
             })
+        .def_property_readonly_static(
+            "precision_particles",
+            [](py::object const &){
+                return sizeof(amrex::ParticleReal) == sizeof(float) ? "SINGLE" : "DOUBLE";
+            })
         .def_property_readonly_static(
             "gpu_backend",
             [](py::object const &){
@@ -9,22 +9,86 @@
 #include <particles/diagnostics/ReducedBeamCharacteristics.H>
 
 #include <AMReX.H>
+#include <AMReX_GpuContainers.H>
 #include <AMReX_MFIter.H>
 #include <AMReX_ParticleContainer.H>
 
 #include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace py = pybind11;
 using namespace impactx;
 
+namespace
+{
+    /** Access the data of a contiguous 1D array of amrex::ParticleReal in place
+     *
+     * This reads the CUDA array interface (e.g., CuPy arrays) in GPU builds
+     * and the NumPy array interface on the host. Arrays on the host are
+     * copied to the device in GPU builds.
+     *
+     * @param array the Python array
+     * @param name name of the array, for error messages
+     * @param staging storage for a device copy of host arrays, if needed
+     * @return pointer to the data that the device can access and number of elements
+     */
+    std::pair<amrex::ParticleReal const *, int>
+    device_array (
+        py::object const & array,
+        std::string const & name,
+        amrex::Gpu::DeviceVector<amrex::ParticleReal> & staging
+    )
+    {
+        bool on_device = false;
+        py::dict interface;
+#ifdef AMREX_USE_GPU
+        if (py::hasattr(array, "__cuda_array_interface__")) {
+            interface = array.attr("__cuda_array_interface__");
+            on_device = true;
+        } else
+#endif
+        if (py::hasattr(array, "__array_interface__")) {
+            interface = array.attr("__array_interface__");
+        } else {
+            throw std::runtime_error("add_n_particles_from_arrays: " + name + " does not provide an array interface");
+        }
+
+        auto const shape = interface["shape"].cast<std::vector<py::ssize_t>>();
+        auto const typestr = interface["typestr"].cast<std::string>();
+        std::string const expected = "f" + std::to_string(sizeof(amrex::ParticleReal));
+        if (shape.size() != 1 || typestr.substr(1) != expected) {
+            throw std::runtime_error("add_n_particles_from_arrays: " + name + " must be a 1D array of type " + expected);
+        }
+        if (interface.contains("strides") && !interface["strides"].is_none()) {
+            auto const strides = interface["strides"].cast<std::vector<py::ssize_t>>();
+            if (strides[0] != py::ssize_t(sizeof(amrex::ParticleReal))) {
+                throw std::runtime_error("add_n_particles_from_arrays: " + name + " must be contiguous");
+            }
+        }
+
+        int const np = static_cast<int>(shape[0]);
+        auto const * data = reinterpret_cast<amrex::ParticleReal const *>(
+            interface["data"].cast<py::tuple>()[0].cast<std::uintptr_t>());
+
+        if (!on_device && amrex::Gpu::inLaunchRegion()) {
+            staging.resize(np);
+            amrex::Gpu::copyAsync(amrex::Gpu::hostToDevice, data, data + np, staging.begin());
+            amrex::Gpu::streamSynchronize();
+            data = staging.dataPtr();
+        }
+        return {data, np};
+    }
+} // namespace
+
 
 void init_impactxparticlecontainer(py::module& m)
 {
     py::class_<
         ParIter,
-        amrex::ParIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>
+        amrex::ParIterSoA<RealSoA::nattribs, IntSoA::nattribs>
     >(m, "ImpactXParIter")
         .def(py::init<ParIter::ContainerType&, int>(),
              py::arg("particle_container"), py::arg("level"))
@@ -34,7 +98,7 @@ void init_impactxparticlecontainer(py::module& m)
 
     py::class_<
         ParConstIter,
-        amrex::ParConstIter<0, 0, RealSoA::nattribs, IntSoA::nattribs>
+        amrex::ParConstIterSoA<RealSoA::nattribs, IntSoA::nattribs>
     >(m, "ImpactXParConstIter")
         .def(py::init<ParConstIter::ContainerType&, int>(),
              py::arg("particle_container"), py::arg("level"))
@@ -44,14 +108,10 @@ void init_impactxparticlecontainer(py::module& m)
 
     py::class_<
         ImpactXParticleContainer,
-        amrex::ParticleContainer<0, 0, RealSoA::nattribs, IntSoA::nattribs>
+        amrex::ParticleContainerPureSoA<RealSoA::nattribs, IntSoA::nattribs>
     >(m, "ImpactXParticleContainer")
         //.def(py::init<>())
 
-        .def_property_readonly_static("RealAoS",
-            [](py::object /* pc */){ return py::type::of<RealAoS>(); },
-            "RealAoS attribute name labels"
-        )
         .def_property_readonly_static("RealSoA",
             [](py::object /* pc */){ return py::type::of<RealSoA>(); },
             "RealSoA attribute name labels"
@@ -77,6 +137,43 @@ void init_impactxparticlecontainer(py::module& m)
              ":param qm: charge over mass in 1/eV\n"
              ":param bchchg: total charge within a bunch in C"
         )
+        .def("add_n_particles_from_arrays",
+             [](ImpactXParticleContainer & pc, int lev,
+                py::object const & x_arr, py::object const & y_arr, py::object const & t_arr,
+                py::object const & px_arr, py::object const & py_arr, py::object const & pt_arr,
+                amrex::ParticleReal qm, amrex::ParticleReal bchchg)
+             {
+                 std::vector<amrex::Gpu::DeviceVector<amrex::ParticleReal>> staging(6);
+                 auto const [x_ptr, np] = device_array(x_arr, "x", staging[0]);
+                 auto const [y_ptr, np_y] = device_array(y_arr, "y", staging[1]);
+                 auto const [t_ptr, np_t] = device_array(t_arr, "t", staging[2]);
+                 auto const [px_ptr, np_px] = device_array(px_arr, "px", staging[3]);
+                 auto const [py_ptr, np_py] = device_array(py_arr, "py", staging[4]);
+                 auto const [pt_ptr, np_pt] = device_array(pt_arr, "pt", staging[5]);
+                 if (np_y != np || np_t != np || np_px != np || np_py != np || np_pt != np) {
+                     throw std::runtime_error("add_n_particles_from_arrays: all arrays must have the same size");
+                 }
+
+                 pc.AddNParticles(lev, x_ptr, y_ptr, t_ptr, px_ptr, py_ptr, pt_ptr, np, qm, bchchg);
+             },
+             py::arg("lev"),
+             py::arg("x"), py::arg("y"), py::arg("t"),
+             py::arg("px"), py::arg("py"), py::arg("pt"),
+             py::arg("qm"), py::arg("bchchg"),
+             "Add new particles to the container for fixed s, from NumPy or CuPy arrays.\n\n"
+             "The arrays are read in place, without intermediate host copies. In GPU builds,\n"
+             "arrays with a CUDA array interface, e.g., CuPy, are read on the device and\n"
+             "arrays on the host, e.g., NumPy, are copied to the device first.\n\n"
+             ":param lev: mesh-refinement level\n"
+             ":param x: positions in x\n"
+             ":param y: positions in y\n"
+             ":param t: positions as time-of-flight in c*t\n"
+             ":param px: momentum in x\n"
+             ":param py: momentum in y\n"
+             ":param pt: momentum in t\n"
+             ":param qm: charge over mass in 1/eV\n"
+             ":param bchchg: total charge within a bunch in C"
+        )
         .def("ref_particle",
             py::overload_cast<>(&ImpactXParticleContainer::GetRefParticle),
             py::return_value_policy::reference_internal,
@@ -87,6 +184,16 @@ void init_impactxparticlecontainer(py::module& m)
              py::arg("refpart"),
              "Set reference particle attributes."
         )
+        .def_property_readonly("ensemble_size",
+             &ImpactXParticleContainer::EnsembleSize,
+             "Number of ensemble members, at least 1."
+        )
+        .def("ensemble_ref_particle",
+            py::overload_cast<int>(&ImpactXParticleContainer::GetEnsembleRefParticle),
+            py::arg("member"),
+            py::return_value_policy::reference_internal,
+            "Access the reference particle of an ensemble member. Member 0 is :py:meth:`ref_particle`."
+        )
         .def("min_and_max_positions",
              &ImpactXParticleContainer::MinAndMaxPositions,
              "Compute the min and max of the particle position in each dimension.\n\n"
@@ -99,10 +206,21 @@ void init_impactxparticlecontainer(py::module& m)
         )
         .def("reduced_beam_characteristics",
              [](ImpactXParticleContainer & pc) {
-                 return diagnostics::reduced_beam_characteristics(pc);
+                 return diagnostics::reduced_beam_characteristics(pc).to_map();
              },
              "Compute reduced beam characteristics like the position and momentum moments of the particle distribution, as well as emittance and Twiss parameters."
         )
+        .def("ensemble_reduced_beam_characteristics",
+             [](ImpactXParticleContainer & pc) {
+                 py::list members;
+                 for (auto const & rbc : diagnostics::ensemble_reduced_beam_characteristics(pc)) {
+                     members.append(rbc.to_map());
+                 }
+                 return members;
+             },
+             "Compute the reduced beam characteristics of each ensemble member, in one pass over all particles.\n\n"
+             ":return: a list with a dict per ensemble member, with the keys of :py:meth:`reduced_beam_characteristics`"
+        )
 
         .def("redistribute",
              &ImpactXParticleContainer::Redistribute,
@@ -117,16 +235,10 @@ void init_impactxparticlecontainer(py::module& m)
         )
         */
 
-        .def_property_readonly("RealAoS_names", &ImpactXParticleContainer::RealAoS_names,
-              "Get the name of each Real AoS component")
-
         .def_property_readonly("RealSoA_names", &ImpactXParticleContainer::RealSoA_names,
               "Get the name of each Real SoA component")
     ;
 
-    m.def("get_RealAoS_names", &get_RealAoS_names,
-          "Get the name of each Real AoS component");
-
     m.def("get_RealSoA_names", &get_RealSoA_names,
           py::arg("num_real_comps"),
           "Get the name of each Real SoA component\n\nnum_real_comps: pass number of compile-time + runtime arrays");
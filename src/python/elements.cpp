@@ -9,6 +9,8 @@
 #include <particles/elements/All.H>
 #include <AMReX.H>
 
+#include <map>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -92,8 +94,8 @@ void init_elements(py::module& m)
 
     py::class_<elements::Thick>(me, "Thick")
         .def(py::init<
-                 amrex::ParticleReal const,
-                 amrex::ParticleReal const
+                 amrex::Real const,
+                 amrex::Real const
              >(),
              py::arg("ds"), py::arg("nslice") = 1,
              "Mixin class for lattice elements with finite length."
@@ -126,8 +128,8 @@ void init_elements(py::module& m)
     py::class_<Aperture, elements::Thin> py_Aperture(me, "Aperture");
     py_Aperture
         .def(py::init([](
-                 amrex::ParticleReal xmax,
-                 amrex::ParticleReal ymax,
+                 amrex::Real xmax,
+                 amrex::Real ymax,
                  std::string shape)
              {
                  if (shape != "rectangular" && shape != "elliptical")
@@ -147,7 +149,7 @@ void init_elements(py::module& m)
     py::class_<ChrDrift, elements::Thick> py_ChrDrift(me, "ChrDrift");
     py_ChrDrift
         .def(py::init<
-                amrex::ParticleReal const,
+                amrex::Real const,
                 int const >(),
              py::arg("ds"), py::arg("nslice") = 1,
              "A Drift with chromatic effects included."
@@ -158,8 +160,8 @@ void init_elements(py::module& m)
     py::class_<ChrQuad, elements::Thick> py_ChrQuad(me, "ChrQuad");
     py_ChrQuad
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
                 int const,
         int const>(),
              py::arg("ds"), py::arg("k"), py::arg("units") = 0, py::arg("nslice") = 1,
@@ -171,9 +173,9 @@ void init_elements(py::module& m)
     py::class_<ChrAcc, elements::Thick> py_ChrAcc(me, "ChrAcc");
     py_ChrAcc
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("ez"), py::arg("bz"), py::arg("nslice") = 1,
              "A region of Uniform Acceleration, with chromatic effects included."
@@ -184,27 +186,27 @@ void init_elements(py::module& m)
     py::class_<ConstF, elements::Thick> py_ConstF(me, "ConstF");
     py_ConstF
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
                 int const >(),
              py::arg("ds"), py::arg("kx"), py::arg("ky"), py::arg("kt"), py::arg("nslice") = 1,
              "A linear Constant Focusing element."
         )
         .def_property("kx",
         [](ConstF & cf) { return cf.m_kx; },
-        [](ConstF & cf, amrex::ParticleReal kx) { cf.m_kx = kx; },
+        [](ConstF & cf, amrex::Real kx) { cf.m_kx = kx; },
             "focusing x strength in 1/m"
         )
         .def_property("ky",
               [](ConstF & cf) { return cf.m_ky; },
-              [](ConstF & cf, amrex::ParticleReal ky) { cf.m_ky = ky; },
+              [](ConstF & cf, amrex::Real ky) { cf.m_ky = ky; },
               "focusing y strength in 1/m"
         )
         .def_property("kt",
               [](ConstF & cf) { return cf.m_kt; },
-              [](ConstF & cf, amrex::ParticleReal kt) { cf.m_kt = kt; },
+              [](ConstF & cf, amrex::Real kt) { cf.m_kt = kt; },
               "focusing t strength in 1/m"
         )
     ;
@@ -213,10 +215,10 @@ void init_elements(py::module& m)
     py::class_<DipEdge, elements::Thin> py_DipEdge(me, "DipEdge");
     py_DipEdge
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("psi"), py::arg("rc"), py::arg("g"), py::arg("K2"),
              "Edge focusing associated with bend entry or exit."
         )
@@ -226,7 +228,7 @@ void init_elements(py::module& m)
     py::class_<Drift, elements::Thick> py_Drift(me, "Drift");
     py_Drift
         .def(py::init<
-                amrex::ParticleReal const,
+                amrex::Real const,
                 int const >(),
              py::arg("ds"), py::arg("nslice") = 1,
              "A drift."
@@ -237,7 +239,7 @@ void init_elements(py::module& m)
     py::class_<ExactDrift, elements::Thick> py_ExactDrift(me, "ExactDrift");
     py_ExactDrift
         .def(py::init<
-                amrex::ParticleReal const,
+                amrex::Real const,
                 int const >(),
              py::arg("ds"), py::arg("nslice") = 1,
              "A Drift using the exact nonlinear map."
@@ -248,9 +250,9 @@ void init_elements(py::module& m)
     py::class_<ExactSbend, elements::Thick> py_ExactSbend(me, "ExactSbend");
     py_ExactSbend
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("phi"), py::arg("B") = 0.0, py::arg("nslice") = 1,
              "An ideal sector bend using the exact nonlinear map.  When B = 0, the reference bending radius is defined by r0 = length / (angle in rad), corresponding to a magnetic field of B = rigidity / r0; otherwise the reference bending radius is defined by r0 = rigidity / B."
@@ -261,8 +263,8 @@ void init_elements(py::module& m)
     py::class_<Kicker, elements::Thin> py_Kicker(me, "Kicker");
     py_Kicker
         .def(py::init([](
-                amrex::ParticleReal xkick,
-                amrex::ParticleReal ykick,
+                amrex::Real xkick,
+                amrex::Real ykick,
                 std::string const & units)
              {
                  if (units != "dimensionless" && units != "T-m")
@@ -283,8 +285,8 @@ void init_elements(py::module& m)
     py_Multipole
         .def(py::init<
                 int const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("multiple"), py::arg("K_normal"), py::arg("K_skew"),
              "A general thin multipole element."
         )
@@ -302,17 +304,38 @@ void init_elements(py::module& m)
     py::class_<NonlinearLens, elements::Thin> py_NonlinearLens(me, "NonlinearLens");
     py_NonlinearLens
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("knll"), py::arg("cnll"),
              "Single short segment of the nonlinear magnetic insert element."
         )
     ;
     register_beamoptics_push(py_NonlinearLens);
 
+    py::class_<ParserMap, elements::Thin> py_ParserMap(me, "ParserMap");
+    py_ParserMap
+        .def(py::init<
+                std::string const &,
+                std::string const &,
+                std::string const &,
+                std::string const &,
+                std::string const &,
+                std::string const &,
+                std::map<std::string, amrex::Real> const &>(),
+             py::arg("x") = "x", py::arg("y") = "y", py::arg("t") = "t",
+             py::arg("px") = "px", py::arg("py") = "py", py::arg("pt") = "pt",
+             py::arg("parameters") = std::map<std::string, amrex::Real>{},
+             "A thin element that maps the particle coordinates with math expressions.\n\n"
+             "Each expression returns the new value of a coordinate, as a function of\n"
+             "x, y, t, px, py, pt, the position s of the reference particle and the parameters.\n"
+             "The expressions are compiled with amrex::Parser and evaluated on the device."
+        )
+    ;
+    register_beamoptics_push(py_ParserMap);
+
     py::class_<Programmable>(me, "Programmable", py::dynamic_attr())
         .def(py::init<
-                 amrex::ParticleReal,
+                 amrex::Real,
                  int>(),
              py::arg("ds") = 0.0, py::arg("nslice") = 1,
              "A programmable beam optics element."
@@ -323,7 +346,7 @@ void init_elements(py::module& m)
         )
         .def_property("ds",
               [](Programmable & p) { return p.ds(); },
-              [](Programmable & p, amrex::ParticleReal ds) { p.m_ds = ds; }
+              [](Programmable & p, amrex::Real ds) { p.m_ds = ds; }
         )
         .def_property("threadsafe",
             [](Programmable & p) { return p.m_threadsafe; },
@@ -356,8 +379,8 @@ void init_elements(py::module& m)
     py::class_<Quad, elements::Thick> py_Quad(me, "Quad");
     py_Quad
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("k"), py::arg("nslice") = 1,
              "A Quadrupole magnet."
@@ -368,12 +391,12 @@ void init_elements(py::module& m)
     py::class_<RFCavity, elements::Thick> py_RFCavity(me, "RFCavity");
     py_RFCavity
         .def(py::init<
-                amrex::ParticleReal,
-                amrex::ParticleReal,
-                amrex::ParticleReal,
-                amrex::ParticleReal,
-                std::vector<amrex::ParticleReal>,
-                std::vector<amrex::ParticleReal>,
+                amrex::Real,
+                amrex::Real,
+                amrex::Real,
+                amrex::Real,
+                std::vector<amrex::Real>,
+                std::vector<amrex::Real>,
                 int,
                 int
              >(),
@@ -388,8 +411,8 @@ void init_elements(py::module& m)
     py::class_<Sbend, elements::Thick> py_Sbend(me, "Sbend");
     py_Sbend
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("rc"), py::arg("nslice") = 1,
              "An ideal sector bend."
@@ -400,9 +423,9 @@ void init_elements(py::module& m)
     py::class_<CFbend, elements::Thick> py_CFbend(me, "CFbend");
     py_CFbend
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("rc"), py::arg("k"), py::arg("nslice") = 1,
              "An ideal combined function bend (sector bend with quadrupole component)."
@@ -413,8 +436,8 @@ void init_elements(py::module& m)
     py::class_<Buncher, elements::Thin> py_Buncher(me, "Buncher");
     py_Buncher
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("V"), py::arg("k"),
              "A short linear RF cavity element at zero-crossing for bunching."
         )
@@ -424,9 +447,9 @@ void init_elements(py::module& m)
     py::class_<ShortRF, elements::Thin> py_ShortRF(me, "ShortRF");
     py_ShortRF
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("V"), py::arg("freq"), py::arg("phase") = -90.0,
              "A short RF cavity element."
         )
@@ -436,10 +459,10 @@ void init_elements(py::module& m)
     py::class_<SoftSolenoid, elements::Thick> py_SoftSolenoid(me, "SoftSolenoid");
     py_SoftSolenoid
         .def(py::init<
-                 amrex::ParticleReal const,
-                 amrex::ParticleReal const,
-                 std::vector<amrex::ParticleReal>,
-                 std::vector<amrex::ParticleReal>,
+                 amrex::Real const,
+                 amrex::Real const,
+                 std::vector<amrex::Real>,
+                 std::vector<amrex::Real>,
          int const,
                  int const
              >(),
@@ -454,8 +477,8 @@ void init_elements(py::module& m)
     py::class_<Sol, elements::Thick> py_Sol(me, "Sol");
     py_Sol
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const,
+                amrex::Real const,
+                amrex::Real const,
                 int const>(),
              py::arg("ds"), py::arg("ks"), py::arg("nslice") = 1,
              "An ideal hard-edge Solenoid magnet."
@@ -466,8 +489,8 @@ void init_elements(py::module& m)
     py::class_<PRot, elements::Thin> py_PRot(me, "PRot");
     py_PRot
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("phi_in"), py::arg("phi_out"),
              "An exact pole-face rotation in the x-z plane. Both angles are in degrees."
         )
@@ -477,10 +500,10 @@ void init_elements(py::module& m)
     py::class_<SoftQuadrupole, elements::Thick> py_SoftQuadrupole(me, "SoftQuadrupole");
     py_SoftQuadrupole
         .def(py::init<
-                 amrex::ParticleReal,
-                 amrex::ParticleReal,
-                 std::vector<amrex::ParticleReal>,
-                 std::vector<amrex::ParticleReal>,
+                 amrex::Real,
+                 amrex::Real,
+                 std::vector<amrex::Real>,
+                 std::vector<amrex::Real>,
                  int,
                  int
              >(),
@@ -495,8 +518,8 @@ void init_elements(py::module& m)
     py::class_<ThinDipole, elements::Thin> py_ThinDipole(me, "ThinDipole");
     py_ThinDipole
         .def(py::init<
-                amrex::ParticleReal const,
-                amrex::ParticleReal const>(),
+                amrex::Real const,
+                amrex::Real const>(),
              py::arg("theta"), py::arg("rc"),
              "A thin kick model of a dipole bend."
         )
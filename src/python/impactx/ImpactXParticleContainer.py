@@ -36,19 +36,56 @@ def ix_pc_to_df(self, local=True, comm=None, root_rank=0):
         # todo: check if currently in fixed s or fixed t and pick name accordingly
 
         names = []
-        for n in self.RealAoS_names:
-            names.append(n)
-        names.append("cpuid")
         for n in self.RealSoA_names:
             names.append(n)
+        names.append("idcpu")
 
         df.columns.values[0 : len(names)] = names
 
     return df
 
 
+def ix_pc_iter_arrays(self, level=0):
+    """
+    View the particles of each tile as arrays, without copies
+
+    Parameters
+    ----------
+    self : ImpactXParticleContainer_*
+        The particle container class in ImpactX
+    level : int
+        mesh-refinement level
+
+    Yields
+    ------
+    A dict of NumPy (CPU) or CuPy (GPU) arrays per MPI-local particle tile,
+    with the RealSoA_names and "idcpu" as keys.
+
+    The arrays share memory with the particles: changing them changes the
+    particles. They are only valid until the particles are pushed through
+    an element or redistributed.
+    """
+    from . import Config, ImpactXParIter
+
+    if Config.have_gpu:
+        import cupy as xp
+    else:
+        import numpy as xp
+
+    names = self.RealSoA_names
+    for pti in ImpactXParIter(self, level):
+        soa = pti.soa()
+        arrays = {
+            name: xp.asarray(real_array)
+            for name, real_array in zip(names, soa.GetRealData())
+        }
+        arrays["idcpu"] = xp.asarray(soa.GetIdCPUData())
+        yield arrays
+
+
 def register_ImpactXParticleContainer_extension(ixpc):
     """ImpactXParticleContainer helper methods"""
 
     # register member functions for ImpactXParticleContainer
     ixpc.to_df = ix_pc_to_df
+    ixpc.iter_arrays = ix_pc_iter_arrays
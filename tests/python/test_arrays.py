@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 The ImpactX Community
+#
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# -*- coding: utf-8 -*-
+
+import numpy as np
+
+from impactx import Config, ImpactX, elements
+
+
+def test_arrays():
+    """
+    This tests adding particles from arrays and accessing them in place
+    """
+    sim = ImpactX()
+
+    sim.particle_shape = 2
+    sim.space_charge = False
+    sim.diagnostics = False
+    sim.init_grids()
+
+    # init particle beam
+    kin_energy_MeV = 2.0e3
+    bunch_charge_C = 1.0e-9
+    npart = 1000
+
+    #   reference particle
+    pc = sim.particle_container()
+    ref = pc.ref_particle()
+    ref.set_charge_qe(-1.0).set_mass_MeV(0.510998950).set_kin_energy_MeV(kin_energy_MeV)
+
+    #   particle bunch, on the device in GPU builds
+    if Config.have_gpu:
+        import cupy as xp
+    else:
+        xp = np
+    #   in the precision of amrex::ParticleReal of this build
+    dtype = np.float32 if Config.precision_particles == "SINGLE" else np.float64
+    rng = np.random.default_rng(seed=42)
+    x, y, t, px, py, pt = (
+        xp.asarray(rng.normal(scale=1.0e-4, size=npart), dtype=dtype)
+        for _ in range(6)
+    )
+    pc.add_n_particles_from_arrays(
+        0, x, y, t, px, py, pt, ref.qm_qeeV, bunch_charge_C
+    )
+    pc.redistribute()
+
+    assert pc.TotalNumberOfParticles() == npart
+
+    # simulate a drift
+    sim.lattice.append(elements.Drift(ds=0.25))
+    sim.evolve()
+
+    # modify the particles in place
+    num_local = 0
+    for arrays in pc.iter_arrays():
+        num_local += len(arrays["position_x"])
+        arrays["momentum_x"][:] = 0.0
+
+    df = pc.to_df(local=True)
+    if df is not None:
+        assert num_local == len(df)
+        assert np.all(df["momentum_x"] == 0.0)
+
+
+if __name__ == "__main__":
+    test_arrays()
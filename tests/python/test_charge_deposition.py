@@ -105,6 +105,35 @@ def test_charge_deposition(save_png=True):
             plt.show()
 
 
+def test_charge_deposition_mr():
+    """
+    Deposit charge with mesh-refinement: the coarsest level holds the charge
+    of the particles on all levels
+    """
+    sim = impactx.ImpactX()
+
+    sim.load_inputs_file(basepath + "/examples/expanding_beam/input_expanding_mr.in")
+    sim.slice_step_diagnostics = False
+    # particle shape 2 deposits to guard nodes of the refined patches
+    assert sim.particle_shape == 2
+
+    sim.init_grids()
+    sim.init_beam_distribution_from_inputs()
+    sim.lattice.extend([impactx.elements.Drift(ds=1.0, nslice=4)])
+
+    sim.evolve()
+    assert sim.finest_level >= 1
+
+    rho = sim.rho(lev=0)
+    rs = rho.sum_unique(comp=0, local=False)
+
+    gm = sim.Geom(lev=0)
+    dV = np.prod(gm.data().CellSize())
+
+    beam_charge = dV * rs  # in C
+    assert math.isclose(beam_charge, -1.0e-9, rel_tol=1.0e-8)
+
+
 # implement a direct script run mode, so we can run this directly too,
 # with interactive matplotlib windows, w/o pytest
 if __name__ == "__main__":
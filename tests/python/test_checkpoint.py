@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 The ImpactX Community
+#
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# -*- coding: utf-8 -*-
+
+import glob
+
+import numpy as np
+import pytest
+
+from impactx import Config, ImpactX, distribution, elements
+
+
+def fodo():
+    """The FODO cell of examples/fodo/, with fewer slices"""
+    ns = 5  # number of slices per ds in the element
+    return [
+        elements.Drift(ds=0.25, nslice=ns),
+        elements.Quad(ds=1.0, k=1.0, nslice=ns),
+        elements.Drift(ds=0.5, nslice=ns),
+        elements.Quad(ds=1.0, k=-1.0, nslice=ns),
+        elements.Drift(ds=0.25, nslice=ns),
+    ]
+
+
+def new_sim():
+    sim = ImpactX()
+
+    sim.particle_shape = 2
+    sim.space_charge = False
+    sim.diagnostics = False
+    sim.periods = 2
+
+    return sim
+
+
+def add_beam(sim, npart):
+    """Reference particle and 2 GeV electron beam of examples/fodo/"""
+    ref = sim.particle_container().ref_particle()
+    ref.set_charge_qe(-1.0).set_mass_MeV(0.510998950).set_kin_energy_MeV(2.0e3)
+    distr = distribution.Waterbag(
+        sigmaX=3.9984884770e-5,
+        sigmaY=3.9984884770e-5,
+        sigmaT=1.0e-3,
+        sigmaPx=2.6623538760e-5,
+        sigmaPy=2.6623538760e-5,
+        sigmaPt=2.0e-3,
+        muxpx=-0.846574929020762,
+        muypy=0.846574929020762,
+        mutpt=0.0,
+    )
+    sim.add_particles(1.0e-9, distr, npart)
+
+
+@pytest.mark.skipif(not Config.have_openpmd, reason="checkpoints require openPMD")
+def test_checkpoint_restart():
+    """
+    Track two FODO periods while writing checkpoints, then restart from a
+    checkpoint in the middle of an element of the second period and compare
+    the final beam
+    """
+    sim = new_sim()
+    sim.checkpoint_step_interval = 8
+    sim.init_grids()
+
+    npart = 10000
+    add_beam(sim, npart)
+    sim.lattice.extend(fodo())
+
+    sim.evolve()
+
+    expected = sim.particle_container().to_df(local=True).sort_values("idcpu")
+    expected_s = sim.particle_container().ref_particle().s
+    del sim
+
+    # 50 slice steps: step 32 is the second slice of the first quadrupole in the second period
+    checkpoints = glob.glob("checkpoints/chk000032.*")
+    assert len(checkpoints) == 1
+    assert len(glob.glob("checkpoints/chk*")) == 6
+
+    sim = new_sim()
+    sim.checkpoint_step_interval = 0
+    sim.checkpoint_restart = checkpoints[0]
+    sim.init_grids()
+    sim.restart()
+
+    pc = sim.particle_container()
+    assert pc.TotalNumberOfParticles() == npart
+    assert pc.ref_particle().s == pytest.approx(0.25 + 2.0 / 5 + 3.0)
+
+    sim.lattice.extend(fodo())
+    sim.evolve()
+
+    restarted = pc.to_df(local=True).sort_values("idcpu")
+    assert pc.ref_particle().s == pytest.approx(expected_s)
+    assert np.array_equal(restarted["idcpu"].values, expected["idcpu"].values)
+    for name in pc.RealSoA_names:
+        assert np.allclose(restarted[name].values, expected[name].values, rtol=1e-12, atol=0.0)
+
+    del sim
+
+
+@pytest.mark.skipif(not Config.have_openpmd, reason="checkpoints require openPMD")
+def test_checkpoint_restart_fuse_linear():
+    """
+    Write checkpoints with the FODO cell fused into one element, restart without
+    fusion, and restart with fusion from a checkpoint inside the fused elements
+    """
+    sim = new_sim()
+    sim.fuse_linear_elements = True
+    sim.checkpoint_step_interval = 1
+    sim.init_grids()
+    npart = 10000
+    add_beam(sim, npart)
+    sim.lattice.extend(fodo())
+
+    sim.evolve()
+
+    expected = sim.particle_container().to_df(local=True).sort_values("idcpu")
+    expected_s = sim.particle_container().ref_particle().s
+    del sim
+
+    # one fused element per period: step 1 is the end of the first period
+    checkpoints = glob.glob("checkpoints/chk000001.*")
+    assert len(checkpoints) == 1
+
+    # continues with the first element of the second period
+    sim = new_sim()
+    sim.fuse_linear_elements = False
+    sim.checkpoint_step_interval = 6
+    sim.checkpoint_restart = checkpoints[0]
+    sim.init_grids()
+    sim.restart()
+    assert sim.particle_container().ref_particle().s == pytest.approx(3.0)
+
+    sim.lattice.extend(fodo())
+    sim.evolve()
+
+    pc = sim.particle_container()
+    restarted = pc.to_df(local=True).sort_values("idcpu")
+    assert pc.ref_particle().s == pytest.approx(expected_s)
+    assert np.array_equal(restarted["idcpu"].values, expected["idcpu"].values)
+    for name in pc.RealSoA_names:
+        assert np.allclose(restarted[name].values, expected[name].values, rtol=1e-9, atol=1e-15)
+    del sim
+
+    # step 1 + 5 slice steps: the end of the first drift in the second period
+    checkpoints = glob.glob("checkpoints/chk000006.*")
+    assert len(checkpoints) == 1
+
+    sim = new_sim()
+    sim.fuse_linear_elements = True
+    sim.checkpoint_step_interval = 0
+    sim.checkpoint_restart = checkpoints[0]
+    sim.init_grids()
+    sim.restart()
+    sim.lattice.extend(fodo())
+    with pytest.raises(RuntimeError, match="algo.fuse_linear_elements"):
+        sim.evolve()
+    del sim
+
+
+if __name__ == "__main__":
+    test_checkpoint_restart()
+    test_checkpoint_restart_fuse_linear()
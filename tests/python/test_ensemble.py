@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 The ImpactX Community
+#
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# -*- coding: utf-8 -*-
+
+import numpy as np
+
+from impactx import ImpactX, RefPart, distribution, elements
+
+
+def fodo(k):
+    """A FODO cell with quadrupole strength k"""
+    ns = 25  # number of slices per ds in the element
+    return [
+        elements.Drift(ds=0.25, nslice=ns),
+        elements.Quad(ds=1.0, k=k, nslice=ns),
+        elements.Drift(ds=0.5, nslice=ns),
+        elements.Quad(ds=1.0, k=-k, nslice=ns),
+        elements.Drift(ds=0.25, nslice=ns),
+    ]
+
+
+def test_ensemble_fodo():
+    """
+    This tracks three independent FODO beams in one ensemble:
+    two with the lattice of examples/fodo/ and one with weaker quadrupoles
+    """
+    sim = ImpactX()
+
+    sim.particle_shape = 2
+    sim.space_charge = False
+    sim.diagnostics = False
+    sim.init_grids()
+
+    kin_energy_MeV = 2.0e3
+    npart = 10000
+
+    #   reference particle of member 0
+    ref = sim.particle_container().ref_particle()
+    ref.set_charge_qe(-1.0).set_mass_MeV(0.510998950).set_kin_energy_MeV(kin_energy_MeV)
+    sim.lattice.extend(fodo(1.0))
+
+    #   two more members
+    for k in [1.0, 0.5]:
+        member_ref = RefPart()
+        member_ref.set_charge_qe(-1.0).set_mass_MeV(0.510998950).set_kin_energy_MeV(
+            kin_energy_MeV
+        )
+        sim.add_ensemble_member(member_ref, elements.KnownElementsList(fodo(k)))
+
+    pc = sim.particle_container()
+    assert pc.ensemble_size == 3
+
+    #   same beam, different charge per member
+    distr = distribution.Waterbag(
+        sigmaX=3.9984884770e-5,
+        sigmaY=3.9984884770e-5,
+        sigmaT=1.0e-3,
+        sigmaPx=2.6623538760e-5,
+        sigmaPy=2.6623538760e-5,
+        sigmaPt=2.0e-3,
+        muxpx=-0.846574929020762,
+        muypy=0.846574929020762,
+        mutpt=0.0,
+    )
+    for member in range(3):
+        sim.add_particles((member + 1) * 1.0e-9, distr, npart, ensemble_member=member)
+
+    sim.evolve()
+
+    assert pc.TotalNumberOfParticles() == 3 * npart
+    rbc = pc.ensemble_reduced_beam_characteristics()
+    assert len(rbc) == 3
+
+    # the reference particles were pushed through their lattices
+    for member in range(3):
+        assert np.isclose(pc.ensemble_ref_particle(member).s, 3.0)
+        assert np.isclose(rbc[member]["charge_C"], -(member + 1) * 1.0e-9)
+
+    # see examples/fodo/analysis_fodo.py
+    atol = 0.0  # ignored
+    rtol = npart**-0.5  # from random sampling of a smooth distribution
+    for member in range(2):
+        assert np.allclose(
+            [
+                rbc[member]["sig_x"],
+                rbc[member]["sig_y"],
+                rbc[member]["sig_t"],
+                rbc[member]["emittance_x"],
+                rbc[member]["emittance_y"],
+                rbc[member]["emittance_t"],
+            ],
+            [
+                7.5451170454175073e-005,
+                7.5441588239210947e-005,
+                9.9775878164077539e-004,
+                1.9959540393751392e-009,
+                2.0175015289132990e-009,
+                2.0013820193294972e-006,
+            ],
+            rtol=rtol,
+            atol=atol,
+        )
+
+    # weaker focusing: the beam is not matched anymore
+    assert not np.isclose(rbc[2]["sig_x"], rbc[0]["sig_x"], rtol=10 * rtol)
@@ -65,6 +65,38 @@ def test_impactx_fodo_file():
     )
 
 
+def test_impactx_element_profile():
+    """
+    This tests the wall time per lattice element
+    """
+    sim = ImpactX()
+
+    sim.load_inputs_file(basepath + "/examples/fodo/input_fodo.in")
+    sim.diag_element_profile = True
+    sim.slice_step_diagnostics = False
+
+    sim.init_grids()
+    sim.init_beam_distribution_from_inputs()
+    sim.init_lattice_elements_from_inputs()
+
+    sim.evolve()
+
+    # one entry per element
+    profile = sim.element_profile
+    assert len(profile) == len(sim.lattice)
+    assert [row["index"] for row in profile] == list(range(len(sim.lattice)))
+    assert [row["name"] for row in profile[:2]] == ["BeamMonitor", "Drift"]
+
+    for row in profile:
+        # thin elements have one slice, the others lattice.nslice
+        assert row["slices"] in [1, 25]
+        assert row["particles"] == 10000 * row["slices"]
+        assert row["time_space_charge_solve"] == 0.0
+        assert row["total_time"] >= row["time_push"] >= 0.0
+
+    assert profile[1]["bytes_per_second"] > 0.0
+
+
 def test_impactx_nofile():
     """
     This tests using ImpactX without an inputs file
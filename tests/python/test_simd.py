@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022-2023 The ImpactX Community
+#
+# Authors: Axel Huebl
+# License: BSD-3-Clause-LBNL
+#
+# -*- coding: utf-8 -*-
+
+import numpy as np
+import pytest
+
+from impactx import Config, ImpactX, elements
+
+
+def particle_real():
+    """NumPy dtype of the particle attributes of this build"""
+    return np.float32 if Config.precision_particles == "SINGLE" else np.float64
+
+
+def lattice():
+    """One of each vectorized element"""
+    return [
+        elements.Drift(ds=0.25, nslice=3),
+        elements.Quad(ds=0.5, k=1.0, nslice=3),
+        elements.Sbend(ds=0.5, rc=10.0, nslice=3),
+        elements.ChrDrift(ds=0.25, nslice=3),
+        elements.ChrQuad(ds=0.5, k=-1.0, nslice=3),
+        elements.Multipole(multiple=3, K_normal=0.5, K_skew=0.1),
+        elements.RFCavity(
+            ds=0.5,
+            escale=10.0,
+            freq=1.3e9,
+            phase=-45.0,
+            cos_coefficients=[0.5, 0.3, -0.1],
+            sin_coefficients=[0.0, 0.0, 0.0],
+            mapsteps=10,
+            nslice=3,
+        ),
+    ]
+
+
+def track(simd):
+    """Track a beam through the lattice with or without SIMD vectors"""
+    sim = ImpactX()
+
+    sim.particle_shape = 2
+    sim.space_charge = False
+    sim.diagnostics = False
+    sim.simd = simd
+    sim.init_grids()
+
+    pc = sim.particle_container()
+    ref = pc.ref_particle()
+    ref.set_charge_qe(-1.0).set_mass_MeV(0.510998950).set_kin_energy_MeV(2.0e3)
+
+    # the same beam in each run
+    #   not a multiple of the SIMD width: the remainder is pushed one by one
+    npart = 10001
+    rng = np.random.default_rng(seed=42)
+    x, y, t, px, py, pt = (
+        rng.normal(scale=1.0e-4, size=npart).astype(particle_real())
+        for _ in range(6)
+    )
+    pc.add_n_particles_from_arrays(0, x, y, t, px, py, pt, ref.qm_qeeV, 1.0e-9)
+    pc.redistribute()
+    sim.lattice.extend(lattice())
+
+    sim.evolve()
+
+    df = pc.to_df(local=True).sort_values("idcpu")
+    names = pc.RealSoA_names
+    del sim
+    return df, names
+
+
+@pytest.mark.skipif(not Config.have_simd, reason="requires a build with ImpactX_SIMD")
+def test_simd_push():
+    """
+    Push through each vectorized element in SIMD vectors and one particle at
+    a time, with the same results up to rounding
+    """
+    scalar, names = track(simd=False)
+    vectorized, _ = track(simd=True)
+
+    # the pushes compute in double precision, but single precision attributes
+    # round the differences of both push orders up to their last digit
+    if particle_real() == np.float32:
+        rtol, atol = 1.0e-5, 1.0e-10
+    else:
+        rtol, atol = 1.0e-12, 1.0e-15
+
+    assert np.array_equal(vectorized["idcpu"].values, scalar["idcpu"].values)
+    for name in names:
+        assert np.allclose(
+            vectorized[name].values, scalar[name].values, rtol=rtol, atol=atol
+        )
+
+
+if __name__ == "__main__":
+    test_simd_push()